@@ -0,0 +1,111 @@
+#include "atomics.h"
+#include "jstring.h"
+#include <string.h>
+
+// Link-time description of an atomic intrinsic, generated from its table
+typedef struct {
+    uint16_t opcode;
+    const char* class_name;
+    const char* name;
+    const char* descriptor;
+    const char* pops;
+    const char* pushes;
+} AtomicIntrinsic;
+
+static const AtomicIntrinsic atomic_intrinsics[] = {
+#define ATOMIC_INFO(name, class_name, method, descriptor, pops, pushes, kind, type, op) \
+    { name, class_name, method, descriptor, pops, pushes },
+    ATOMIC_INTRINSICS(ATOMIC_INFO)
+#undef ATOMIC_INFO
+};
+
+#define ATOMIC_INTRINSICS_COUNT (sizeof(atomic_intrinsics) / sizeof(atomic_intrinsics[0]))
+
+// Type of the value of an atomic class, or 0 if it is not one
+char atomic_class_type(const char* class_name) {
+    if (strcmp(class_name, ATOMIC_INTEGER) == 0) {
+        return 'I';
+    }
+    if (strcmp(class_name, ATOMIC_LONG) == 0) {
+        return 'J';
+    }
+    if (strcmp(class_name, ATOMIC_REFERENCE) == 0) {
+        return 'L';
+    }
+    return 0;
+}
+
+// Allocate an atomic holding zero or null, as the no-argument constructor
+JAtomic* atomic_new(JVM* jvm, const char* class_name) {
+    JAtomic* atomic = (JAtomic*)jvm_alloc_object(jvm, class_name, sizeof(JAtomic));
+    if (!atomic) {
+        return NULL;
+    }
+    atomic->header.kind = OBJECT_ATOMIC;
+    atomic->type = atomic_class_type(class_name);
+    return atomic;
+}
+
+// Intrinsic opcode of an atomic class method, or 0 if it has none
+uint16_t atomic_method_opcode(const char* class_name, const char* method_name, const char* descriptor) {
+    if (!atomic_class_type(class_name)) {
+        return 0;
+    }
+    for (size_t i = 0; i < ATOMIC_INTRINSICS_COUNT; i++) {
+        const AtomicIntrinsic* intrinsic = &atomic_intrinsics[i];
+        if (strcmp(intrinsic->name, method_name) == 0 && strcmp(intrinsic->descriptor, descriptor) == 0 &&
+            strcmp(intrinsic->class_name, class_name) == 0) {
+            return intrinsic->opcode;
+        }
+    }
+    return 0;
+}
+
+// Operand stack values an atomic intrinsic consumes and produces
+bool atomic_stack_effect(uint16_t opcode, int* pops, int* pushes) {
+    for (size_t i = 0; i < ATOMIC_INTRINSICS_COUNT; i++) {
+        if (atomic_intrinsics[i].opcode == opcode) {
+            *pops = (int)strlen(atomic_intrinsics[i].pops);
+            *pushes = (int)strlen(atomic_intrinsics[i].pushes);
+            return true;
+        }
+    }
+    return false;
+}
+
+// AtomicInteger(int), AtomicLong(long) and AtomicReference(Object); the
+// atomic is not shared before its constructor returns
+static int native_atomic_init(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)jvm;
+    (void)frame;
+    (void)result;
+    ((JAtomic*)args[0].ref)->value = args[1];
+    return 0;
+}
+
+// The no-argument constructors; atomic_new already cleared the value
+static int native_atomic_init_default(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)jvm;
+    (void)frame;
+    (void)args;
+    (void)result;
+    return 0;
+}
+
+// toString(): the current value
+static int native_atomic_to_string(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)frame;
+    result->ref = object_to_string(jvm, (JObject*)args[0].ref);
+    return result->ref ? 0 : -1;
+}
+
+void register_atomic_native_methods(Runtime* runtime) {
+    static const char* const classes[] = {ATOMIC_INTEGER, ATOMIC_LONG, ATOMIC_REFERENCE};
+    static const char* const constructors[] = {"(I)V", "(J)V", "(Ljava/lang/Object;)V"};
+    for (size_t i = 0; i < sizeof(classes) / sizeof(classes[0]); i++) {
+        runtime_register_native_method(runtime, classes[i], "<init>", "()V", native_atomic_init_default);
+        runtime_register_native_method(runtime, classes[i], "<init>", constructors[i], native_atomic_init);
+        runtime_register_native_method(runtime, classes[i], "toString", "()Ljava/lang/String;",
+                                       native_atomic_to_string);
+    }
+}
@@ -0,0 +1,14 @@
+// atomics.h - java.util.concurrent.atomic classes bound to atomic intrinsics
+#ifndef ATOMICS_H
+#define ATOMICS_H
+
+#include "jvm.h"
+
+// Public API functions
+char atomic_class_type(const char* class_name);
+JAtomic* atomic_new(JVM* jvm, const char* class_name);
+uint16_t atomic_method_opcode(const char* class_name, const char* method_name, const char* descriptor);
+bool atomic_stack_effect(uint16_t opcode, int* pops, int* pushes);
+void register_atomic_native_methods(Runtime* runtime);
+
+#endif // ATOMICS_H
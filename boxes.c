@@ -0,0 +1,256 @@
+#include "boxes.h"
+#include "monitors.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BOX_CACHE_SIZE (BOX_CACHE_HIGH - BOX_CACHE_LOW + 1)
+
+// Wrapper classes by primitive type, with the name of their xxxValue
+// method and the number of boxes cached
+static const struct {
+    char type;
+    const char* class_name;
+    const char* value_method;
+    uint16_t cached;
+} box_classes[BOX_CLASSES_COUNT] = {
+    { 'I', "java/lang/Integer", "intValue", BOX_CACHE_SIZE },
+    { 'J', "java/lang/Long", "longValue", BOX_CACHE_SIZE },
+    { 'S', "java/lang/Short", "shortValue", BOX_CACHE_SIZE },
+    { 'B', "java/lang/Byte", "byteValue", BOX_CACHE_SIZE },
+    { 'C', "java/lang/Character", "charValue", BOX_CACHE_HIGH + 1 },
+    { 'Z', "java/lang/Boolean", "booleanValue", 2 },
+    { 'F', "java/lang/Float", "floatValue", 0 },
+    { 'D', "java/lang/Double", "doubleValue", 0 },
+};
+
+static int box_class_index(char type) {
+    for (size_t i = 0; i < BOX_CLASSES_COUNT; i++) {
+        if (box_classes[i].type == type) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static bool is_number_type(char type) {
+    return type != 'C' && type != 'Z';
+}
+
+// Preallocate the shared boxes of every wrapper class in one block, outside
+// the list of collectable objects
+int box_cache_init(JVM* jvm) {
+    size_t total = 0;
+    for (size_t i = 0; i < BOX_CLASSES_COUNT; i++) {
+        total += box_classes[i].cached;
+    }
+    jvm->box_cache = calloc(total, sizeof(JBox));
+    if (!jvm->box_cache) {
+        return -1;
+    }
+
+    JBox* box = jvm->box_cache;
+    for (size_t i = 0; i < BOX_CLASSES_COUNT; i++) {
+        jvm->box_caches[i] = box;
+        int32_t low = box_classes[i].cached == BOX_CACHE_SIZE ? BOX_CACHE_LOW : 0;
+        for (uint16_t j = 0; j < box_classes[i].cached; j++, box++) {
+            box->header.class_name = box_classes[i].class_name;
+            box->header.kind = OBJECT_BOX;
+            box->type = box_classes[i].type;
+            if (box->type == 'J') {
+                box->value.l = low + j;
+            } else {
+                box->value.i = low + j;
+            }
+        }
+    }
+    return 0;
+}
+
+// Free the shared boxes, with the monitors of any that were locked
+void box_cache_free(JVM* jvm) {
+    if (!jvm->box_cache) {
+        return;
+    }
+    size_t total = 0;
+    for (size_t i = 0; i < BOX_CLASSES_COUNT; i++) {
+        total += box_classes[i].cached;
+    }
+    for (size_t i = 0; i < total; i++) {
+        monitor_free(&jvm->box_cache[i].header);
+    }
+    free(jvm->box_cache);
+}
+
+// Primitive type wrapped by a class, or 0 if it is not a wrapper class
+char box_class_type(const char* class_name) {
+    for (size_t i = 0; i < BOX_CLASSES_COUNT; i++) {
+        if (strcmp(box_classes[i].class_name, class_name) == 0) {
+            return box_classes[i].type;
+        }
+    }
+    return 0;
+}
+
+// Primitive type boxed by a static valueOf(primitive) method, or 0
+char box_method_type(const char* class_name, const char* method_name, const char* descriptor) {
+    char type = box_class_type(class_name);
+    if (!type || strcmp(method_name, "valueOf") != 0 ||
+        descriptor[0] != '(' || descriptor[1] != type || descriptor[2] != ')' ||
+        descriptor[3] != 'L' || strncmp(descriptor + 4, class_name, strlen(class_name)) != 0) {
+        return 0;
+    }
+    return type;
+}
+
+// Result type of an xxxValue method of a wrapper class, or 0. Numeric
+// wrappers convert to any numeric type, as java.lang.Number does.
+char unbox_method_type(const char* class_name, const char* method_name, const char* descriptor) {
+    char type = box_class_type(class_name);
+    if (!type || descriptor[0] != '(' || descriptor[1] != ')' || descriptor[3] != '\0') {
+        return 0;
+    }
+    int index = box_class_index(descriptor[2]);
+    if (index < 0 || strcmp(box_classes[index].value_method, method_name) != 0 ||
+        (descriptor[2] != type && !(is_number_type(type) && is_number_type(descriptor[2])))) {
+        return 0;
+    }
+    return descriptor[2];
+}
+
+// Box a primitive value, returning the shared box for cached values
+JBox* box_value(JVM* jvm, char type, jvalue value) {
+    int index = box_class_index(type);
+    if (index < 0) {
+        return NULL;
+    }
+    int64_t key = type == 'J' ? value.l : (type == 'Z' ? value.i != 0 : value.i);
+    int64_t low = box_classes[index].cached == BOX_CACHE_SIZE ? BOX_CACHE_LOW : 0;
+    if (key >= low && key < low + box_classes[index].cached) {
+        return &jvm->box_caches[index][key - low];
+    }
+
+    JBox* box = (JBox*)jvm_alloc_object(jvm, box_classes[index].class_name, sizeof(JBox));
+    if (!box) {
+        return NULL;
+    }
+    box->header.kind = OBJECT_BOX;
+    box->type = type;
+    box->value = value;
+    return box;
+}
+
+// Value of a box converted to a primitive type, as by xxxValue
+jvalue unbox_value(const JBox* box, char type) {
+    jvalue result;
+    if (type == box->type) {
+        return box->value;
+    }
+    switch (box->type) {
+    case 'J':
+        switch (type) {
+        case 'F': result.f = CONVERT_J_TO_F(box->value.l); break;
+        case 'D': result.d = CONVERT_J_TO_D(box->value.l); break;
+        default: result.i = CONVERT_J_TO_I(box->value.l); break;
+        }
+        break;
+    case 'F':
+    case 'D': {
+        jdouble d = box->type == 'F' ? box->value.f : box->value.d;
+        switch (type) {
+        case 'J': result.l = CONVERT_D_TO_J(d); break;
+        case 'F': result.f = CONVERT_D_TO_F(d); break;
+        case 'D': result.d = d; break;
+        default: result.i = CONVERT_D_TO_I(d); break;
+        }
+        break;
+    }
+    default:
+        switch (type) {
+        case 'J': result.l = CONVERT_I_TO_J(box->value.i); break;
+        case 'F': result.f = CONVERT_I_TO_F(box->value.i); break;
+        case 'D': result.d = CONVERT_I_TO_D(box->value.i); break;
+        default: result.i = box->value.i; break;
+        }
+        break;
+    }
+    // Narrowing to short and byte keeps the low bits, as the casts do
+    if (type == 'S') {
+        result.i = INT_TO_SHORT(result.i);
+    } else if (type == 'B') {
+        result.i = INT_TO_BYTE(result.i);
+    }
+    return result;
+}
+
+// Format a box as its toString does, except for Character; returns the
+// length written
+int box_format(const JBox* box, char* buffer, size_t size) {
+    switch (box->type) {
+    case 'J':
+        return snprintf(buffer, size, "%lld", (long long)box->value.l);
+    case 'F':
+        format_float(buffer, size, box->value.f);
+        return (int)strlen(buffer);
+    case 'D':
+        format_double(buffer, size, box->value.d);
+        return (int)strlen(buffer);
+    case 'Z':
+        return snprintf(buffer, size, "%s", box->value.i ? "true" : "false");
+    default:
+        return snprintf(buffer, size, "%d", box->value.i);
+    }
+}
+
+// Bits of a floating-point box as floatToIntBits and doubleToLongBits
+// give them, with every NaN collapsed to the canonical one
+static int64_t box_bits(const JBox* box) {
+    if (box->type == 'F') {
+        int32_t bits;
+        jfloat f = box->value.f != box->value.f ? NAN : box->value.f;
+        memcpy(&bits, &f, sizeof(bits));
+        return bits;
+    }
+    int64_t bits;
+    jdouble d = box->value.d != box->value.d ? (jdouble)NAN : box->value.d;
+    memcpy(&bits, &d, sizeof(bits));
+    return bits;
+}
+
+// Box.hashCode: the value for int-sized types, the halves of the bits
+// folded for long and double
+jint box_hash_code(const JBox* box) {
+    switch (box->type) {
+    case 'J':
+        return (jint)(box->value.l ^ (jlong)((uint64_t)box->value.l >> 32));
+    case 'Z':
+        return box->value.i ? 1231 : 1237;
+    case 'F':
+        return (jint)box_bits(box);
+    case 'D': {
+        int64_t bits = box_bits(box);
+        return (jint)(bits ^ (int64_t)((uint64_t)bits >> 32));
+    }
+    default:
+        return box->value.i;
+    }
+}
+
+// Box.equals: another box of the same class holding the same value;
+// floating-point values compare by their bits, so NaN equals NaN
+bool box_equals(const JBox* box, const JObject* other) {
+    if (!other || other->kind != OBJECT_BOX || ((const JBox*)other)->type != box->type) {
+        return false;
+    }
+    const JBox* that = (const JBox*)other;
+    switch (box->type) {
+    case 'J':
+        return box->value.l == that->value.l;
+    case 'F':
+    case 'D':
+        return box_bits(box) == box_bits(that);
+    default:
+        return box->value.i == that->value.i;
+    }
+}
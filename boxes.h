@@ -0,0 +1,25 @@
+// boxes.h - Primitive wrapper objects and their value caches
+#ifndef BOXES_H
+#define BOXES_H
+
+#include "jvm.h"
+
+// Range of the values valueOf returns shared boxes for, as the Java
+// libraries require for Integer, Long, Short and Byte; Character caches
+// 0..BOX_CACHE_HIGH and Boolean both values
+#define BOX_CACHE_LOW (-128)
+#define BOX_CACHE_HIGH 127
+
+// Public API functions
+int box_cache_init(JVM* jvm);
+void box_cache_free(JVM* jvm);
+char box_class_type(const char* class_name);
+char box_method_type(const char* class_name, const char* method_name, const char* descriptor);
+char unbox_method_type(const char* class_name, const char* method_name, const char* descriptor);
+JBox* box_value(JVM* jvm, char type, jvalue value);
+jvalue unbox_value(const JBox* box, char type);
+int box_format(const JBox* box, char* buffer, size_t size);
+jint box_hash_code(const JBox* box);
+bool box_equals(const JBox* box, const JObject* other);
+
+#endif // BOXES_H
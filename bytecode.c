@@ -0,0 +1,582 @@
+#include "bytecode.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Code attribute reading functions
+static uint8_t read_u1(const uint8_t* code, uint32_t pos) {
+    return code[pos];
+}
+
+static uint16_t read_u2(const uint8_t* code, uint32_t pos) {
+    return (uint16_t)((code[pos] << 8) | code[pos + 1]);
+}
+
+static int32_t read_s4(const uint8_t* code, uint32_t pos) {
+    return (int32_t)(((uint32_t)code[pos] << 24) | ((uint32_t)code[pos + 1] << 16) |
+                     ((uint32_t)code[pos + 2] << 8) | (uint32_t)code[pos + 3]);
+}
+
+// Static opcode descriptions, generated from the opcode table
+const OpcodeInfo opcode_info[256] = {
+#define OPCODE_INFO(name, code, format, pops, pushes, kind, type, op) \
+    [code] = { #name, format, pops, pushes },
+    JVM_OPCODES(OPCODE_INFO)
+#undef OPCODE_INFO
+};
+
+static int is_branch_format(uint8_t format) {
+    return format == FMT_BRANCH || format == FMT_BRANCH_W;
+}
+
+// Length in bytes of the instruction at pos, or 0 if it is malformed
+static uint32_t instruction_length(const uint8_t* code, uint32_t pos, uint32_t code_length) {
+    uint8_t opcode = code[pos];
+    if (!opcode_info[opcode].name) {
+        return 0;
+    }
+
+    switch (opcode_info[opcode].format) {
+        case FMT_NONE:
+            return 1;
+        case FMT_BYTE:
+        case FMT_LOCAL:
+        case FMT_CP1:
+            return 2;
+        case FMT_SHORT:
+        case FMT_CP2:
+        case FMT_IINC:
+        case FMT_BRANCH:
+            return 3;
+        case FMT_MULTIANEWARRAY:
+            return 4;
+        case FMT_BRANCH_W:
+        case FMT_INVOKEINTERFACE:
+        case FMT_INVOKEDYNAMIC:
+            return 5;
+
+        case FMT_SWITCH: {
+            uint32_t base = (pos + 4) & ~3u;
+            if (opcode == TABLESWITCH) {
+                if (base + 12 > code_length) {
+                    return 0;
+                }
+                int32_t low = read_s4(code, base + 4);
+                int32_t high = read_s4(code, base + 8);
+                if (high < low || (int64_t)high - low >= code_length / 4) {
+                    return 0;
+                }
+                return base - pos + 12 + 4 * (uint32_t)((int64_t)high - low + 1);
+            }
+            if (base + 8 > code_length) {
+                return 0;
+            }
+            int32_t npairs = read_s4(code, base + 4);
+            if (npairs < 0 || (uint32_t)npairs > code_length / 8) {
+                return 0;
+            }
+            return base - pos + 8 + 8 * (uint32_t)npairs;
+        }
+
+        case FMT_WIDE:
+            // Only local variable instructions can be widened
+            if (pos + 1 >= code_length) {
+                return 0;
+            }
+            switch (opcode_info[code[pos + 1]].format) {
+                case FMT_IINC: return 6;
+                case FMT_LOCAL: return 4;
+                default: return 0;
+            }
+
+        default:
+            return 0;
+    }
+}
+
+// Fill in opcode and operands of a single instruction
+static void decode_instruction(const uint8_t* code, uint32_t pos, Instruction* insn) {
+    uint8_t opcode = code[pos];
+    insn->opcode = opcode;
+
+    switch (opcode) {
+        // Integer constants all become a single push of operand a
+        case ICONST_M1: case ICONST_0: case ICONST_1: case ICONST_2:
+        case ICONST_3: case ICONST_4: case ICONST_5:
+            insn->opcode = ICONST;
+            insn->a = (int32_t)opcode - ICONST_0;
+            return;
+        case BIPUSH:
+            insn->opcode = ICONST;
+            insn->a = (int8_t)read_u1(code, pos + 1);
+            return;
+        case SIPUSH:
+            insn->opcode = ICONST;
+            insn->a = (int16_t)read_u2(code, pos + 1);
+            return;
+
+        // Wide local accesses become the plain instruction with a 16-bit index
+        case WIDE:
+            insn->opcode = code[pos + 1];
+            insn->a = read_u2(code, pos + 2);
+            if (insn->opcode == IINC) {
+                insn->b = (int16_t)read_u2(code, pos + 4);
+            }
+            return;
+
+        // Branch targets are resolved by the caller; the wide forms behave
+        // the same once the target is an instruction index
+        case GOTO_W:
+            insn->opcode = GOTO;
+            return;
+        case JSR_W:
+            insn->opcode = JSR;
+            return;
+
+        default:
+            break;
+    }
+
+    // Short-form local accesses xload_<n> and xstore_<n> take the local
+    // index as operand a, in groups of four per type
+    if (opcode >= ILOAD_0 && opcode <= ALOAD_3) {
+        insn->opcode = ILOAD + (opcode - ILOAD_0) / 4;
+        insn->a = (opcode - ILOAD_0) % 4;
+        return;
+    }
+    if (opcode >= ISTORE_0 && opcode <= ASTORE_3) {
+        insn->opcode = ISTORE + (opcode - ISTORE_0) / 4;
+        insn->a = (opcode - ISTORE_0) % 4;
+        return;
+    }
+
+    switch (opcode_info[opcode].format) {
+        case FMT_BYTE:
+        case FMT_LOCAL:
+        case FMT_CP1:
+            insn->a = read_u1(code, pos + 1);
+            break;
+        case FMT_CP2:
+        case FMT_INVOKEDYNAMIC:
+            insn->a = read_u2(code, pos + 1);
+            break;
+        case FMT_IINC:
+            insn->a = read_u1(code, pos + 1);
+            insn->b = (int8_t)read_u1(code, pos + 2);
+            break;
+        case FMT_INVOKEINTERFACE:
+        case FMT_MULTIANEWARRAY:
+            insn->a = read_u2(code, pos + 1);
+            insn->b = read_u1(code, pos + 3);
+            break;
+        default:
+            break;
+    }
+}
+
+// Return the operand holding the branch target, or NULL if not a branch
+int32_t* instruction_branch_target(Instruction* insn) {
+    if (insn->opcode >= ILOAD_ICONST_IF_ICMPEQ && insn->opcode <= ILOAD_ICONST_IF_ICMPLE) {
+        return &insn->c;
+    }
+    if (insn->opcode <= 0xff && is_branch_format(opcode_info[insn->opcode].format)) {
+        return &insn->a;
+    }
+    return NULL;
+}
+
+// Resolve the switch branch offset stored at entry to an instruction index,
+// or -1 if it does not land on an instruction
+static int32_t switch_branch(const uint8_t* code, uint32_t pos, uint32_t entry,
+                             uint32_t code_length, const int32_t* index_of) {
+    int64_t target = (int64_t)pos + read_s4(code, entry);
+    if (target < 0 || target >= code_length) {
+        return -1;
+    }
+    return index_of[target];
+}
+
+// Try to place the sorted keys in a power-of-two table where a single
+// multiply and shift gives each key its own slot
+static int build_switch_hash(SwitchTable* table, const int32_t* keys,
+                             const int32_t* targets, uint32_t count) {
+    uint32_t bits = 1;
+    while ((1u << bits) < count * 2) {
+        bits++;
+    }
+
+    for (uint32_t extra = 0; extra < SWITCH_HASH_MAX_GROWTH; extra++, bits++) {
+        uint32_t size = 1u << bits;
+        uint8_t* used = malloc(size);
+        if (!used) {
+            return -1;
+        }
+
+        uint32_t multiplier = 0x9E3779B1u;
+        for (uint32_t attempt = 0; attempt < SWITCH_HASH_ATTEMPTS; attempt++) {
+            memset(used, 0, size);
+            uint32_t i = 0;
+            for (; i < count; i++) {
+                uint32_t slot = ((uint32_t)keys[i] * multiplier) >> (32 - bits);
+                if (used[slot]) {
+                    break;
+                }
+                used[slot] = 1;
+            }
+
+            if (i == count) {
+                int32_t* slot_keys = calloc(size, sizeof(int32_t));
+                int32_t* slot_targets = malloc(size * sizeof(int32_t));
+                if (!slot_keys || !slot_targets) {
+                    free(slot_keys);
+                    free(slot_targets);
+                    free(used);
+                    return -1;
+                }
+                // Empty slots jump to the default whatever key lands there
+                for (uint32_t s = 0; s < size; s++) {
+                    slot_targets[s] = table->default_target;
+                }
+                for (i = 0; i < count; i++) {
+                    uint32_t slot = ((uint32_t)keys[i] * multiplier) >> (32 - bits);
+                    slot_keys[slot] = keys[i];
+                    slot_targets[slot] = targets[i];
+                }
+                free(used);
+                table->keys = slot_keys;
+                table->targets = slot_targets;
+                table->count = size;
+                table->hash_multiplier = multiplier;
+                table->hash_shift = (uint8_t)(32 - bits);
+                return 0;
+            }
+
+            // Next odd multiplier from a xorshift sequence
+            multiplier ^= multiplier << 13;
+            multiplier ^= multiplier >> 17;
+            multiplier ^= multiplier << 5;
+            multiplier |= 1;
+        }
+        free(used);
+    }
+    return -1;
+}
+
+// Decode a tableswitch or lookupswitch into a switch table. Dense key sets
+// become jump arrays indexed by key - low and are executed as tableswitch;
+// sparse ones keep their sorted keys for binary search, or a perfect hash
+// when there are many keys
+static int decode_switch(const uint8_t* code, uint32_t pos, uint32_t code_length,
+                         const int32_t* index_of, Instruction* insn, SwitchTable* table) {
+    uint32_t base = (pos + 4) & ~3u;
+    memset(table, 0, sizeof(SwitchTable));
+    table->default_target = switch_branch(code, pos, base, code_length, index_of);
+    if (table->default_target < 0) {
+        return -1;
+    }
+
+    if (code[pos] == TABLESWITCH) {
+        table->low = read_s4(code, base + 4);
+        table->count = (uint32_t)((int64_t)read_s4(code, base + 8) - table->low + 1);
+        table->targets = malloc(table->count * sizeof(int32_t));
+        if (!table->targets) {
+            return -1;
+        }
+        for (uint32_t i = 0; i < table->count; i++) {
+            table->targets[i] = switch_branch(code, pos, base + 12 + 4 * i, code_length, index_of);
+            if (table->targets[i] < 0) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    uint32_t count = (uint32_t)read_s4(code, base + 4);
+    int32_t* keys = malloc((count + 1) * sizeof(int32_t));
+    int32_t* targets = malloc((count + 1) * sizeof(int32_t));
+    if (!keys || !targets) {
+        free(keys);
+        free(targets);
+        return -1;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        keys[i] = read_s4(code, base + 8 + 8 * i);
+        targets[i] = switch_branch(code, pos, base + 12 + 8 * i, code_length, index_of);
+        // Keys must be strictly increasing
+        if (targets[i] < 0 || (i > 0 && keys[i] <= keys[i - 1])) {
+            free(keys);
+            free(targets);
+            return -1;
+        }
+    }
+
+    int64_t span = count ? (int64_t)keys[count - 1] - keys[0] + 1 : 0;
+    if (span <= (int64_t)count * SWITCH_DENSE_FACTOR) {
+        insn->opcode = TABLESWITCH;
+        table->low = count ? keys[0] : 0;
+        table->count = (uint32_t)span;
+        table->targets = malloc((table->count + 1) * sizeof(int32_t));
+        if (!table->targets) {
+            free(keys);
+            free(targets);
+            return -1;
+        }
+        for (uint32_t i = 0; i < table->count; i++) {
+            table->targets[i] = table->default_target;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            table->targets[(uint32_t)keys[i] - (uint32_t)table->low] = targets[i];
+        }
+        free(keys);
+        free(targets);
+        return 0;
+    }
+
+    if (count >= SWITCH_HASH_MIN_KEYS && build_switch_hash(table, keys, targets, count) == 0) {
+        free(keys);
+        free(targets);
+        return 0;
+    }
+
+    table->keys = keys;
+    table->targets = targets;
+    table->count = count;
+    return 0;
+}
+
+static void free_switch_tables(SwitchTable* tables, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        free(tables[i].keys);
+        free(tables[i].targets);
+    }
+    free(tables);
+}
+
+// Decode method bytecode, resolving branch offsets to instruction indices
+int decode_method(MethodInfo* method) {
+    if (!method || !method->code || method->code_length == 0) {
+        return 0;
+    }
+
+    const uint8_t* code = method->code;
+    uint32_t code_length = method->code_length;
+
+    int32_t* index_of = malloc(code_length * sizeof(int32_t));
+    if (!index_of) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < code_length; i++) {
+        index_of[i] = -1;
+    }
+
+    // First pass: find instruction boundaries
+    uint32_t count = 0;
+    for (uint32_t pos = 0; pos < code_length; ) {
+        uint32_t length = instruction_length(code, pos, code_length);
+        if (length == 0 || pos + length > code_length) {
+            free(index_of);
+            return -1;
+        }
+        index_of[pos] = (int32_t)count++;
+        pos += length;
+    }
+
+    Instruction* instructions = calloc(count, sizeof(Instruction));
+    if (!instructions) {
+        free(index_of);
+        return -1;
+    }
+    SwitchTable* tables = NULL;
+    uint32_t tables_count = 0;
+
+    // Second pass: decode operands and resolve branches
+    uint32_t pos = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        Instruction* insn = &instructions[i];
+        uint32_t length = instruction_length(code, pos, code_length);
+        insn->offset = pos;
+        insn->length = (uint16_t)length;
+        decode_instruction(code, pos, insn);
+
+        uint8_t format = opcode_info[code[pos]].format;
+        if (is_branch_format(format)) {
+            int32_t branch = format == FMT_BRANCH ? (int16_t)read_u2(code, pos + 1)
+                                                  : read_s4(code, pos + 1);
+            int64_t target = (int64_t)pos + branch;
+            if (target < 0 || target >= code_length || index_of[target] < 0) {
+                free_switch_tables(tables, tables_count);
+                free(instructions);
+                free(index_of);
+                return -1;
+            }
+            insn->a = index_of[target];
+        } else if (format == FMT_SWITCH) {
+            SwitchTable* grown = realloc(tables, (tables_count + 1) * sizeof(SwitchTable));
+            if (!grown) {
+                free_switch_tables(tables, tables_count);
+                free(instructions);
+                free(index_of);
+                return -1;
+            }
+            tables = grown;
+            insn->a = (int32_t)tables_count;
+            if (decode_switch(code, pos, code_length, index_of, insn, &tables[tables_count++]) != 0) {
+                free_switch_tables(tables, tables_count);
+                free(instructions);
+                free(index_of);
+                return -1;
+            }
+        }
+        pos += length;
+    }
+
+    // Exception handlers: ranges may end at the end of the code
+    ExceptionHandler* handlers = NULL;
+    if (method->exception_table_length > 0) {
+        handlers = malloc(method->exception_table_length * sizeof(ExceptionHandler));
+        if (!handlers) {
+            free_switch_tables(tables, tables_count);
+            free(instructions);
+            free(index_of);
+            return -1;
+        }
+    }
+    for (uint16_t i = 0; i < method->exception_table_length; i++) {
+        const ExceptionTableEntry* entry = &method->exception_table[i];
+        if (entry->start_pc >= entry->end_pc || entry->end_pc > code_length ||
+            entry->handler_pc >= code_length || index_of[entry->start_pc] < 0 ||
+            (entry->end_pc < code_length && index_of[entry->end_pc] < 0) ||
+            index_of[entry->handler_pc] < 0) {
+            free(handlers);
+            free_switch_tables(tables, tables_count);
+            free(instructions);
+            free(index_of);
+            return -1;
+        }
+        handlers[i].start = index_of[entry->start_pc];
+        handlers[i].end = entry->end_pc < code_length ? index_of[entry->end_pc] : (int32_t)count;
+        handlers[i].handler = index_of[entry->handler_pc];
+        handlers[i].catch_type = entry->catch_type;
+    }
+
+    free(index_of);
+    free_method_instructions(method);
+    method->instructions = instructions;
+    method->instructions_count = count;
+    method->switch_tables = tables;
+    method->switch_tables_count = tables_count;
+    method->exception_handlers = handlers;
+    method->exception_handlers_count = method->exception_table_length;
+    return 0;
+}
+
+static int compare_int32(const void* a, const void* b) {
+    int32_t x = *(const int32_t*)a;
+    int32_t y = *(const int32_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Split the handler ranges of the final code into disjoint ranges sorted by
+// start, each listing the handlers that cover it in exception table order,
+// so a throw finds its candidates with one binary search
+int build_exception_ranges(MethodInfo* method) {
+    free(method->exception_ranges);
+    free(method->exception_range_handlers);
+    method->exception_ranges = NULL;
+    method->exception_range_handlers = NULL;
+    method->exception_ranges_count = 0;
+
+    uint32_t handlers_count = method->exception_handlers_count;
+    if (handlers_count == 0) {
+        return 0;
+    }
+
+    // Range boundaries are the starts and ends of all handlers
+    int32_t* bounds = malloc(handlers_count * 2 * sizeof(int32_t));
+    if (!bounds) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < handlers_count; i++) {
+        bounds[2 * i] = method->exception_handlers[i].start;
+        bounds[2 * i + 1] = method->exception_handlers[i].end;
+    }
+    qsort(bounds, handlers_count * 2, sizeof(int32_t), compare_int32);
+    uint32_t bounds_count = 0;
+    for (uint32_t i = 0; i < handlers_count * 2; i++) {
+        if (bounds_count == 0 || bounds[bounds_count - 1] != bounds[i]) {
+            bounds[bounds_count++] = bounds[i];
+        }
+    }
+
+    ExceptionRange* ranges = calloc(bounds_count, sizeof(ExceptionRange));
+    if (!ranges) {
+        free(bounds);
+        return -1;
+    }
+    uint32_t listed = 0;
+    for (uint32_t r = 0; r < bounds_count; r++) {
+        ranges[r].start = bounds[r];
+        ranges[r].first = listed;
+        for (uint32_t i = 0; i < handlers_count; i++) {
+            const ExceptionHandler* handler = &method->exception_handlers[i];
+            if (handler->start <= bounds[r] && bounds[r] < handler->end) {
+                ranges[r].count++;
+            }
+        }
+        listed += ranges[r].count;
+    }
+
+    uint16_t* range_handlers = malloc((listed + 1) * sizeof(uint16_t));
+    if (!range_handlers) {
+        free(ranges);
+        free(bounds);
+        return -1;
+    }
+    listed = 0;
+    for (uint32_t r = 0; r < bounds_count; r++) {
+        for (uint32_t i = 0; i < handlers_count; i++) {
+            const ExceptionHandler* handler = &method->exception_handlers[i];
+            if (handler->start <= bounds[r] && bounds[r] < handler->end) {
+                range_handlers[listed++] = (uint16_t)i;
+            }
+        }
+    }
+
+    free(bounds);
+    method->exception_ranges = ranges;
+    method->exception_ranges_count = bounds_count;
+    method->exception_range_handlers = range_handlers;
+    return 0;
+}
+
+void free_method_instructions(MethodInfo* method) {
+    if (!method) {
+        return;
+    }
+
+    if (method->instructions) {
+        free(method->instructions);
+    }
+    method->instructions = NULL;
+    method->instructions_count = 0;
+    free_switch_tables(method->switch_tables, method->switch_tables_count);
+    method->switch_tables = NULL;
+    method->switch_tables_count = 0;
+    for (uint16_t i = 0; i < method->call_sites_count; i++) {
+        free(method->call_sites[i].parts);
+        if (method->call_sites[i].lambda) {
+            free(method->call_sites[i].lambda->interface_name);
+            free(method->call_sites[i].lambda);
+        }
+    }
+    free(method->call_sites);
+    method->call_sites = NULL;
+    method->call_sites_count = 0;
+    free(method->exception_handlers);
+    free(method->exception_ranges);
+    free(method->exception_range_handlers);
+    method->exception_handlers = NULL;
+    method->exception_handlers_count = 0;
+    method->exception_ranges = NULL;
+    method->exception_ranges_count = 0;
+    method->exception_range_handlers = NULL;
+}
@@ -0,0 +1,25 @@
+// bytecode.h - Decoding of method bytecode into pre-decoded instructions
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include "jvm.h"
+#include <stdint.h>
+
+// Switch table shapes: a lookupswitch whose keys span at most this many
+// times their count becomes a jump array; one with at least SWITCH_HASH_MIN_KEYS
+// sparse keys is tried as a perfect hash before falling back to binary search
+#define SWITCH_DENSE_FACTOR 3
+#define SWITCH_HASH_MIN_KEYS 16
+#define SWITCH_HASH_MAX_GROWTH 4
+#define SWITCH_HASH_ATTEMPTS 256
+
+// Opcode descriptions from the opcode table, indexed by opcode
+extern const OpcodeInfo opcode_info[256];
+
+// Public API functions
+int decode_method(MethodInfo* method);
+int32_t* instruction_branch_target(Instruction* insn);
+int build_exception_ranges(MethodInfo* method);
+void free_method_instructions(MethodInfo* method);
+
+#endif // BYTECODE_H
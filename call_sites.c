@@ -0,0 +1,467 @@
+#include "call_sites.h"
+#include "class_loader.h"
+#include "jstring.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool is_wide_type(char type) {
+    return type == 'J' || type == 'D';
+}
+
+// Append a loadable constant the way string concatenation formats it;
+// returns 1 for constants concatenation does not accept
+static int append_constant(JStringBuilder* text, const ClassInfo* class_info, uint16_t index) {
+    if (index == 0 || index >= class_info->constant_pool_count) {
+        return 1;
+    }
+
+    char buffer[40];
+    const jvalue* value = &class_info->constants[index];
+    switch (class_info->constant_pool[index].tag) {
+        case CONST_STRING:
+            return builder_append_string(text, (const JString*)value->ref);
+        case CONST_INTEGER:
+            snprintf(buffer, sizeof(buffer), "%d", value->i);
+            break;
+        case CONST_LONG:
+            snprintf(buffer, sizeof(buffer), "%lld", (long long)value->l);
+            break;
+        case CONST_FLOAT:
+            format_float(buffer, sizeof(buffer), value->f);
+            break;
+        case CONST_DOUBLE:
+            format_double(buffer, sizeof(buffer), value->d);
+            break;
+        default:
+            return 1;
+    }
+    return builder_append_latin1(text, buffer, (uint32_t)strlen(buffer));
+}
+
+// End the current run of constant text, interning it as the next part
+static int flush_constant_text(JVM* jvm, CallSite* site, JStringBuilder* text) {
+    if (text->length == 0) {
+        return 0;
+    }
+    JString* str = builder_to_string(jvm, text);
+    free(text->value);
+    memset(text, 0, sizeof(JStringBuilder));
+    if (!str || !(str = jvm_intern_string(jvm, str))) {
+        return -1;
+    }
+    site->parts[site->parts_count++].constant = str;
+    return 0;
+}
+
+// Link a StringConcatFactory site: split the recipe into arguments and runs
+// of constant text, folding the bootstrap constants into the text. Without
+// a recipe (makeConcat) every argument is concatenated in order.
+static int link_concat(JVM* jvm, const ClassInfo* class_info, CallSite* site,
+                       const BootstrapMethod* bootstrap, const char* types, int count,
+                       bool has_recipe) {
+    const JString* recipe = NULL;
+    if (has_recipe) {
+        uint16_t index = bootstrap->arguments_count > 0 ? bootstrap->arguments[0] : 0;
+        if (index == 0 || index >= class_info->constant_pool_count ||
+            class_info->constant_pool[index].tag != CONST_STRING) {
+            site->error = "bad string concatenation recipe";
+            return 0;
+        }
+        recipe = (const JString*)class_info->constants[index].ref;
+    }
+
+    uint32_t length = recipe ? recipe->length : (uint32_t)count;
+    site->parts = calloc(length + 1, sizeof(ConcatPart));
+    if (!site->parts) {
+        return -1;
+    }
+
+    JStringBuilder text;
+    memset(&text, 0, sizeof(text));
+    int argument = 0;
+    uint16_t slot = 0;
+    uint16_t constant = 1;
+    int status = 0;
+    for (uint32_t i = 0; i < length && status == 0 && !site->error; i++) {
+        uint16_t c = recipe ? string_char_at(recipe, i) : RECIPE_ARGUMENT;
+        if (c == RECIPE_ARGUMENT) {
+            if (argument == count) {
+                site->error = "string concatenation recipe has too many arguments";
+                break;
+            }
+            status = flush_constant_text(jvm, site, &text);
+            ConcatPart* part = &site->parts[site->parts_count++];
+            part->type = types[argument];
+            part->slot = slot;
+            slot += is_wide_type(types[argument++]) ? 2 : 1;
+        } else if (c == RECIPE_CONSTANT) {
+            status = constant < bootstrap->arguments_count
+                         ? append_constant(&text, class_info, bootstrap->arguments[constant++])
+                         : 1;
+            if (status == 1) {
+                site->error = "bad string concatenation constant";
+                status = 0;
+            }
+        } else {
+            status = builder_append_char(&text, c);
+        }
+    }
+    if (status == 0 && !site->error) {
+        status = flush_constant_text(jvm, site, &text);
+        if (argument != count) {
+            site->error = "string concatenation recipe has too few arguments";
+        }
+    }
+    free(text.value);
+
+    if (status != 0 || site->error) {
+        free(site->parts);
+        site->parts = NULL;
+        site->parts_count = 0;
+        return status;
+    }
+    site->kind = CALL_SITE_CONCAT;
+    return 0;
+}
+
+static bool is_reference_type(char type) {
+    return type == 'L' || type == '[';
+}
+
+// Method descriptor of a MethodType constant
+static const char* method_type_descriptor(const ClassInfo* class_info, uint16_t index) {
+    if (index == 0 || index >= class_info->constant_pool_count ||
+        class_info->constant_pool[index].tag != CONST_METHOD_TYPE) {
+        return NULL;
+    }
+    return constant_pool_utf8(class_info, class_info->constant_pool[index].class_info.string_index);
+}
+
+// Whether a value of one type is passed on unchanged as the other: the same
+// primitive type, or references of any class
+static bool is_same_kind(char type, char other) {
+    return type == other || (is_reference_type(type) && is_reference_type(other));
+}
+
+static MethodInfo* find_class_method(ClassInfo* class_info, const char* name, const char* descriptor) {
+    for (uint16_t i = 0; i < class_info->methods_count; i++) {
+        MethodInfo* method = &class_info->methods[i];
+        if (strcmp(method->name, name) == 0 && strcmp(method->descriptor, descriptor) == 0) {
+            return method->instructions ? method : NULL;
+        }
+    }
+    return NULL;
+}
+
+// Link a LambdaMetafactory site. Its arguments are the values captured;
+// the target method takes them followed by the interface method's own
+// arguments. Targets needing boxing or widening are not adapted, so those
+// sites stay unlinked.
+static int link_lambda(JVM* jvm, ClassInfo* class_info, CallSite* site,
+                       const BootstrapMethod* bootstrap, const char* name,
+                       const char* descriptor, const char* types, int count) {
+    const char* interface_descriptor = NULL;
+    const char* instantiated = NULL;
+    uint16_t handle = 0;
+    if (bootstrap->arguments_count >= 3) {
+        interface_descriptor = method_type_descriptor(class_info, bootstrap->arguments[0]);
+        handle = bootstrap->arguments[1];
+        instantiated = method_type_descriptor(class_info, bootstrap->arguments[2]);
+    }
+    const char* target_class;
+    const char* target_name;
+    const char* target_descriptor;
+    if (!interface_descriptor || !instantiated ||
+        handle == 0 || handle >= class_info->constant_pool_count ||
+        class_info->constant_pool[handle].tag != CONST_METHOD_HANDLE ||
+        constant_pool_member_ref(class_info, class_info->constant_pool[handle].method_handle_info.reference_index,
+                                 &target_class, &target_name, &target_descriptor) != 0) {
+        site->error = "bad lambda bootstrap arguments";
+        return 0;
+    }
+    uint8_t kind = class_info->constant_pool[handle].method_handle_info.reference_kind;
+    if (kind != REF_INVOKE_VIRTUAL && kind != REF_INVOKE_STATIC &&
+        kind != REF_INVOKE_SPECIAL && kind != REF_INVOKE_INTERFACE) {
+        site->error = "unsupported method reference kind";
+        return 0;
+    }
+
+    // The target's parameters, the receiver first for instance methods, must
+    // line up with the captured values and then the interface arguments
+    char expected[2 * MAX_CALL_SITE_ARGUMENTS + 1];
+    char parameters[MAX_CALL_SITE_ARGUMENTS + 1];
+    memcpy(expected, types, (size_t)count);
+    int interface_count = parse_method_descriptor(instantiated, expected + count, MAX_CALL_SITE_ARGUMENTS);
+    int offset = kind == REF_INVOKE_STATIC ? 0 : 1;
+    int parameters_count = parse_method_descriptor(target_descriptor, parameters + offset,
+                                                   MAX_CALL_SITE_ARGUMENTS);
+    if (interface_count < 0 || parameters_count < 0) {
+        return -1;
+    }
+    if (offset) {
+        parameters[0] = 'L';
+        parameters_count++;
+    }
+    bool compatible = parameters_count == count + interface_count;
+    for (int i = 0; compatible && i < parameters_count; i++) {
+        compatible = is_same_kind(parameters[i], expected[i]);
+    }
+    char interface_result = descriptor_return_type(instantiated);
+    char result = descriptor_return_type(target_descriptor);
+    if (!compatible || (interface_result != 'V' && !is_same_kind(interface_result, result))) {
+        site->error = "lambda target needs boxing or widening";
+        return 0;
+    }
+
+    // The functional interface is the class named by the call site's result
+    const char* interface_name = strchr(descriptor, ')') + 1;
+    size_t interface_length = strlen(interface_name);
+    if (interface_name[0] != 'L' || interface_length < 3) {
+        site->error = "lambda call site does not return an interface";
+        return 0;
+    }
+
+    LambdaVTable* vtable = calloc(1, sizeof(LambdaVTable));
+    if (!vtable) {
+        return -1;
+    }
+    site->lambda = vtable;
+    vtable->interface_name = malloc(interface_length - 1);
+    if (!vtable->interface_name) {
+        return -1;
+    }
+    memcpy(vtable->interface_name, interface_name + 1, interface_length - 2);
+    vtable->interface_name[interface_length - 2] = '\0';
+    vtable->name = name;
+    vtable->descriptor = interface_descriptor;
+    vtable->class_info = class_info;
+    if (strcmp(target_class, class_info->name) == 0) {
+        vtable->method = find_class_method(class_info, target_name, target_descriptor);
+    }
+    vtable->method_ref = class_info->constant_pool[handle].method_handle_info.reference_index;
+    vtable->reference_kind = kind;
+    if (interface_result == 'V' && result != 'V') {
+        vtable->discarded_slots = is_wide_type(result) ? 2 : 1;
+    }
+    vtable->captured_slots = site->argument_slots;
+
+    // Lambdas capturing nothing are all the same object
+    if (count == 0 && !(site->instance = (JObject*)lambda_new(jvm, vtable, NULL))) {
+        return -1;
+    }
+    site->kind = CALL_SITE_LAMBDA;
+    return 0;
+}
+
+// Link one call site from its InvokeDynamic constant, which the verifier
+// has checked. Sites with bootstraps that are not understood stay unlinked
+// and throw when executed, as a failed bootstrap would.
+static int link_call_site(JVM* jvm, ClassInfo* class_info, uint16_t index, CallSite* site) {
+    memset(site, 0, sizeof(CallSite));
+    site->kind = CALL_SITE_UNLINKED;
+    site->constant_index = index;
+
+    const ConstantPoolEntry* entry = &class_info->constant_pool[index];
+    const char* name;
+    const char* descriptor;
+    char types[MAX_CALL_SITE_ARGUMENTS];
+    if (constant_pool_name_and_type(class_info, entry->dynamic_info.name_and_type_index,
+                                    &name, &descriptor) != 0) {
+        return -1;
+    }
+    int count = parse_method_descriptor(descriptor, types, MAX_CALL_SITE_ARGUMENTS);
+    if (count < 0) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        site->argument_slots += is_wide_type(types[i]) ? 2 : 1;
+    }
+
+    uint16_t bootstrap_index = entry->dynamic_info.bootstrap_method_index;
+    if (bootstrap_index >= class_info->bootstrap_methods_count) {
+        site->error = "missing bootstrap method";
+        return 0;
+    }
+    const BootstrapMethod* bootstrap = &class_info->bootstrap_methods[bootstrap_index];
+    uint16_t handle = bootstrap->method_handle;
+    const char* bootstrap_class;
+    const char* bootstrap_name;
+    const char* bootstrap_descriptor;
+    if (handle == 0 || handle >= class_info->constant_pool_count ||
+        class_info->constant_pool[handle].tag != CONST_METHOD_HANDLE ||
+        constant_pool_member_ref(class_info,
+                                 class_info->constant_pool[handle].method_handle_info.reference_index,
+                                 &bootstrap_class, &bootstrap_name, &bootstrap_descriptor) != 0) {
+        site->error = "bad bootstrap method handle";
+        return 0;
+    }
+
+    const char* result = strchr(descriptor, ')') + 1;
+    if (strcmp(bootstrap_class, "java/lang/invoke/StringConcatFactory") == 0 &&
+        strcmp(result, "Ljava/lang/String;") == 0) {
+        if (strcmp(bootstrap_name, "makeConcatWithConstants") == 0) {
+            return link_concat(jvm, class_info, site, bootstrap, types, count, true);
+        }
+        if (strcmp(bootstrap_name, "makeConcat") == 0) {
+            return link_concat(jvm, class_info, site, bootstrap, types, count, false);
+        }
+    }
+    if (strcmp(bootstrap_class, "java/lang/invoke/LambdaMetafactory") == 0 &&
+        (strcmp(bootstrap_name, "metafactory") == 0 || strcmp(bootstrap_name, "altMetafactory") == 0)) {
+        return link_lambda(jvm, class_info, site, bootstrap, name, descriptor, types, count);
+    }
+    site->error = "unsupported bootstrap method";
+    return 0;
+}
+
+// Link every invokedynamic of the class. Each instruction's operand becomes
+// the index of its call site in the method; instructions sharing a constant
+// share the linked site.
+int link_call_sites(JVM* jvm, ClassInfo* class_info) {
+    for (uint16_t m = 0; m < class_info->methods_count; m++) {
+        MethodInfo* method = &class_info->methods[m];
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < method->instructions_count; i++) {
+            count += method->instructions[i].opcode == INVOKEDYNAMIC;
+        }
+        if (count == 0) {
+            continue;
+        }
+        method->call_sites = calloc(count, sizeof(CallSite));
+        if (!method->call_sites) {
+            return -1;
+        }
+
+        for (uint32_t i = 0; i < method->instructions_count; i++) {
+            Instruction* insn = &method->instructions[i];
+            if (insn->opcode != INVOKEDYNAMIC) {
+                continue;
+            }
+            uint16_t site = 0;
+            while (site < method->call_sites_count &&
+                   method->call_sites[site].constant_index != insn->a) {
+                site++;
+            }
+            if (site == method->call_sites_count) {
+                if (link_call_site(jvm, class_info, (uint16_t)insn->a, &method->call_sites[site]) != 0) {
+                    return -1;
+                }
+                method->call_sites_count++;
+            }
+            insn->a = site;
+        }
+    }
+    return 0;
+}
+
+// Format a numeric or boolean argument; chars and references are appended
+// directly
+static const char* format_argument(char type, const jvalue* value, char* buffer, size_t size) {
+    switch (type) {
+        case 'J':
+            snprintf(buffer, size, "%lld", (long long)value->l);
+            return buffer;
+        case 'F':
+            format_float(buffer, size, value->f);
+            return buffer;
+        case 'D':
+            format_double(buffer, size, value->d);
+            return buffer;
+        case 'Z':
+            return value->i ? "true" : "false";
+        default:
+            snprintf(buffer, size, "%d", value->i);
+            return buffer;
+    }
+}
+
+static int append_part(JStringBuilder* builder, const ConcatPart* part, const jvalue* args) {
+    char buffer[40];
+    const jvalue* value = &args[part->slot];
+    if (part->constant) {
+        return builder_append_string(builder, part->constant);
+    }
+    if (part->type == 'C') {
+        return builder_append_char(builder, (uint16_t)value->i);
+    }
+    if (part->type == 'L') {
+        return builder_append_object(builder, (const JObject*)value->ref);
+    }
+    const char* text = format_argument(part->type, value, buffer, sizeof(buffer));
+    return builder_append_latin1(builder, text, (uint32_t)strlen(text));
+}
+
+// Execute a concatenation site: size the result exactly from the argument
+// values, then format every part straight into the one string allocated
+JString* concat_call_site(JVM* jvm, const CallSite* site, const jvalue* args) {
+    uint64_t length = 0;
+    uint8_t coder = STRING_LATIN1;
+    for (uint16_t i = 0; i < site->parts_count; i++) {
+        const ConcatPart* part = &site->parts[i];
+        const jvalue* value = &args[part->slot];
+        const JObject* object = part->type == 'L' ? (const JObject*)value->ref : NULL;
+        if (part->constant || (object && object->kind == OBJECT_STRING)) {
+            const JString* str = part->constant ? part->constant : (const JString*)object;
+            length += str->length;
+            coder |= str->coder;
+        } else if (object && object->kind == OBJECT_STRING_BUILDER) {
+            length += ((const JStringBuilder*)object)->length;
+            coder |= ((const JStringBuilder*)object)->coder;
+        } else if (part->type == 'C') {
+            length++;
+            coder |= (uint16_t)value->i > 0xFF ? STRING_UTF16 : STRING_LATIN1;
+        } else if (part->type == 'L') {
+            // Other objects are formatted twice rather than kept around
+            JStringBuilder formatted;
+            memset(&formatted, 0, sizeof(formatted));
+            if (append_part(&formatted, part, args) != 0) {
+                free(formatted.value);
+                return NULL;
+            }
+            length += formatted.length;
+            coder |= formatted.coder;
+            free(formatted.value);
+        } else {
+            char buffer[40];
+            length += strlen(format_argument(part->type, value, buffer, sizeof(buffer)));
+        }
+    }
+    if (length > INT32_MAX) {
+        return NULL;
+    }
+
+    JString* str = string_new(jvm, (uint32_t)length, coder);
+    if (!str) {
+        return NULL;
+    }
+    // Write through a builder over the string's own storage; it has exactly
+    // the capacity needed, so nothing is reallocated
+    JStringBuilder writer;
+    memset(&writer, 0, sizeof(writer));
+    writer.value = str->value;
+    writer.capacity = (uint32_t)length;
+    writer.coder = coder;
+    for (uint16_t i = 0; i < site->parts_count; i++) {
+        if (append_part(&writer, &site->parts[i], args) != 0) {
+            return NULL;
+        }
+    }
+    return str;
+}
+
+// Create a functional object of a lambda call site around the values it
+// captures
+JLambda* lambda_new(JVM* jvm, const LambdaVTable* vtable, const jvalue* captured) {
+    size_t size = sizeof(JLambda) + vtable->captured_slots * sizeof(jvalue);
+    JLambda* lambda = (JLambda*)jvm_alloc_object(jvm, vtable->interface_name, size);
+    if (!lambda) {
+        return NULL;
+    }
+    lambda->header.kind = OBJECT_LAMBDA;
+    lambda->vtable = vtable;
+    if (vtable->captured_slots > 0) {
+        memcpy(lambda->captured, captured, vtable->captured_slots * sizeof(jvalue));
+    }
+    return lambda;
+}
@@ -0,0 +1,19 @@
+// call_sites.h - Load-time linkage of invokedynamic call sites
+#ifndef CALL_SITES_H
+#define CALL_SITES_H
+
+#include "jvm.h"
+
+// Most arguments a call site descriptor can have: 255 slots, all one wide
+#define MAX_CALL_SITE_ARGUMENTS 255
+
+// Recipe tags of StringConcatFactory.makeConcatWithConstants
+#define RECIPE_ARGUMENT 1
+#define RECIPE_CONSTANT 2
+
+// Public API functions
+int link_call_sites(JVM* jvm, ClassInfo* class_info);
+JString* concat_call_site(JVM* jvm, const CallSite* site, const jvalue* args);
+JLambda* lambda_new(JVM* jvm, const LambdaVTable* vtable, const jvalue* captured);
+
+#endif // CALL_SITES_H
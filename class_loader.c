@@ -1,6 +1,7 @@
 #define _POSIX_C_SOURCE 200809L
 
 #include "class_loader.h"
+#include "bytecode.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -61,6 +62,112 @@ char* read_utf8_string(const ClassInfo* class_info, uint16_t index) {
     return str;
 }
 
+// Borrow a UTF-8 string from the constant pool without copying it
+const char* constant_pool_utf8(const ClassInfo* class_info, uint16_t index) {
+    if (index == 0 || index >= class_info->constant_pool_count) {
+        return NULL;
+    }
+
+    ConstantPoolEntry* entry = &class_info->constant_pool[index];
+    if (entry->tag != CONST_UTF8) {
+        return NULL;
+    }
+    return entry->utf8_info.bytes;
+}
+
+// Name of the class referenced by a class constant
+const char* constant_pool_class_name(const ClassInfo* class_info, uint16_t index) {
+    if (index == 0 || index >= class_info->constant_pool_count ||
+        class_info->constant_pool[index].tag != CONST_CLASS) {
+        return NULL;
+    }
+    return constant_pool_utf8(class_info, class_info->constant_pool[index].class_info.string_index);
+}
+
+// Resolve the names of a field, method or interface method reference
+int constant_pool_member_ref(const ClassInfo* class_info, uint16_t index,
+                             const char** class_name, const char** name,
+                             const char** descriptor) {
+    if (index == 0 || index >= class_info->constant_pool_count) {
+        return -1;
+    }
+
+    ConstantPoolEntry* ref = &class_info->constant_pool[index];
+    if (ref->tag != CONST_FIELDREF && ref->tag != CONST_METHODREF &&
+        ref->tag != CONST_INTERFACE_METHODREF) {
+        return -1;
+    }
+    if (ref->ref_info.class_index >= class_info->constant_pool_count) {
+        return -1;
+    }
+
+    ConstantPoolEntry* class_entry = &class_info->constant_pool[ref->ref_info.class_index];
+    if (class_entry->tag != CONST_CLASS) {
+        return -1;
+    }
+
+    *class_name = constant_pool_utf8(class_info, class_entry->class_info.string_index);
+    if (!*class_name) {
+        return -1;
+    }
+    return constant_pool_name_and_type(class_info, ref->ref_info.name_and_type_index,
+                                       name, descriptor);
+}
+
+// Name and descriptor of a NameAndType constant
+int constant_pool_name_and_type(const ClassInfo* class_info, uint16_t index,
+                                const char** name, const char** descriptor) {
+    if (index == 0 || index >= class_info->constant_pool_count ||
+        class_info->constant_pool[index].tag != CONST_NAME_AND_TYPE) {
+        return -1;
+    }
+
+    const ConstantPoolEntry* name_and_type = &class_info->constant_pool[index];
+    *name = constant_pool_utf8(class_info, name_and_type->ref_info.class_index);
+    *descriptor = constant_pool_utf8(class_info, name_and_type->ref_info.name_and_type_index);
+    return (*name && *descriptor) ? 0 : -1;
+}
+
+// Split a method descriptor into one type character per argument, with
+// object and array types reported as 'L'; returns the argument count
+int parse_method_descriptor(const char* descriptor, char* arg_types, int max_args) {
+    if (!descriptor || *descriptor != '(') {
+        return -1;
+    }
+
+    int count = 0;
+    const char* p = descriptor + 1;
+    while (*p && *p != ')') {
+        if (count >= max_args) {
+            return -1;
+        }
+        char type = *p;
+        while (*p == '[') {
+            p++;
+        }
+        if (*p == 'L') {
+            p = strchr(p, ';');
+            if (!p) {
+                return -1;
+            }
+        } else if (!strchr("BCDFIJSZ", *p) || *p == '\0') {
+            return -1;
+        }
+        arg_types[count++] = type == '[' ? 'L' : type;
+        p++;
+    }
+    return *p == ')' ? count : -1;
+}
+
+// Return type character of a method descriptor, 'L' for objects and arrays
+char descriptor_return_type(const char* descriptor) {
+    const char* p = descriptor ? strchr(descriptor, ')') : NULL;
+    if (!p || p[1] == '\0') {
+        return '\0';
+    }
+    return p[1] == '[' ? 'L' : p[1];
+}
+
 // Parse constant pool entries
 static int parse_constant_pool(ClassReader* reader, LoadedClass* loaded_class) {
     loaded_class->constant_pool_count = read_u2(reader);
@@ -97,21 +204,22 @@ static int parse_constant_pool(ClassReader* reader, LoadedClass* loaded_class) {
                 break;
             case CONST_FLOAT: {
                 uint32_t bits = read_u4(reader);
-                entry->float_info.value = *(jfloat*)&bits;
+                memcpy(&entry->float_info.value, &bits, sizeof(jfloat));
                 break;
             }
             case CONST_LONG:
-                // Long occupies 2 slots in constant pool
-                entry->utf8_info.length = read_u4(reader);
-                entry->utf8_info.bytes = (char*)(uintptr_t)read_u4(reader);
-                i++; // Skip next slot
-                break;
-            case CONST_DOUBLE:
-                // Double occupies 2 slots in constant pool
-                entry->utf8_info.length = read_u4(reader);
-                entry->utf8_info.bytes = (char*)(uintptr_t)read_u4(reader);
+            case CONST_DOUBLE: {
+                // Long and double occupy 2 slots in constant pool
+                uint64_t high = read_u4(reader);
+                uint64_t bits = (high << 32) | read_u4(reader);
+                if (entry->tag == CONST_LONG) {
+                    entry->long_info.value = (jlong)bits;
+                } else {
+                    memcpy(&entry->double_info.value, &bits, sizeof(jdouble));
+                }
                 i++; // Skip next slot
                 break;
+            }
             case CONST_CLASS:
                 entry->class_info.string_index = read_u2(reader);
                 break;
@@ -123,13 +231,26 @@ static int parse_constant_pool(ClassReader* reader, LoadedClass* loaded_class) {
                 entry->ref_info.name_and_type_index = read_u2(reader);
                 break;
             case CONST_METHODREF:
+            case CONST_INTERFACE_METHODREF:
                 entry->ref_info.class_index = read_u2(reader);
                 entry->ref_info.name_and_type_index = read_u2(reader);
                 break;
-            case 12: // CONST_NAME_AND_TYPE
+            case CONST_NAME_AND_TYPE:
                 entry->ref_info.class_index = read_u2(reader);
                 entry->ref_info.name_and_type_index = read_u2(reader);
                 break;
+            case CONST_METHOD_HANDLE:
+                entry->method_handle_info.reference_kind = read_u1(reader);
+                entry->method_handle_info.reference_index = read_u2(reader);
+                break;
+            case CONST_METHOD_TYPE:
+                entry->class_info.string_index = read_u2(reader);
+                break;
+            case CONST_DYNAMIC:
+            case CONST_INVOKE_DYNAMIC:
+                entry->dynamic_info.bootstrap_method_index = read_u2(reader);
+                entry->dynamic_info.name_and_type_index = read_u2(reader);
+                break;
             default:
                 // Skip unknown types
                 read_u2(reader);
@@ -221,6 +342,68 @@ static int parse_methods(ClassReader* reader, LoadedClass* loaded_class) {
                         read_bytes(&code_reader, method->code, method->code_length);
                     }
                 }
+                
+                // Exception table, resolved to instructions by the decoder
+                uint16_t exception_table_length = read_u2(&code_reader);
+                if (code_reader.pos + (size_t)exception_table_length * 8 > code_reader.size) {
+                    free(attr_name);
+                    return -1;
+                }
+                if (exception_table_length > 0) {
+                    method->exception_table = calloc(exception_table_length, sizeof(ExceptionTableEntry));
+                    if (!method->exception_table) {
+                        free(attr_name);
+                        return -1;
+                    }
+                    method->exception_table_length = exception_table_length;
+                    for (uint16_t k = 0; k < exception_table_length; k++) {
+                        ExceptionTableEntry* entry = &method->exception_table[k];
+                        entry->start_pc = read_u2(&code_reader);
+                        entry->end_pc = read_u2(&code_reader);
+                        entry->handler_pc = read_u2(&code_reader);
+                        entry->catch_type = read_u2(&code_reader);
+                    }
+                }
+                
+                // Code attributes: keep the StackMapTable for the verifier
+                // and the LineNumberTable for stack traces
+                uint16_t code_attributes_count = read_u2(&code_reader);
+                for (uint16_t k = 0; k < code_attributes_count; k++) {
+                    uint16_t name_index = read_u2(&code_reader);
+                    uint32_t length = read_u4(&code_reader);
+                    if (code_reader.pos + length > code_reader.size) {
+                        break;
+                    }
+                    const char* name = constant_pool_utf8(&temp_class_info, name_index);
+                    if (name && strcmp(name, ATTR_STACK_MAP_TABLE) == 0 && length > 0) {
+                        method->stack_map_table = malloc(length);
+                        if (method->stack_map_table) {
+                            read_bytes(&code_reader, method->stack_map_table, length);
+                            method->stack_map_table_length = length;
+                        }
+                    } else if (name && strcmp(name, ATTR_LINE_NUMBER_TABLE) == 0 && length >= 2) {
+                        uint16_t lines_count = read_u2(&code_reader);
+                        LineNumberEntry* lines = NULL;
+                        if ((uint32_t)lines_count * 4 + 2 <= length) {
+                            lines = realloc(method->line_numbers,
+                                            (method->line_numbers_count + lines_count) * sizeof(LineNumberEntry) + 1);
+                        }
+                        if (lines) {
+                            for (uint16_t l = 0; l < lines_count; l++) {
+                                LineNumberEntry* entry = &lines[method->line_numbers_count + l];
+                                entry->start_pc = read_u2(&code_reader);
+                                entry->line_number = read_u2(&code_reader);
+                            }
+                            method->line_numbers = lines;
+                            method->line_numbers_count += lines_count;
+                            code_reader.pos += length - 2 - (uint32_t)lines_count * 4;
+                        } else {
+                            code_reader.pos += length - 2;
+                        }
+                    } else {
+                        code_reader.pos += length;
+                    }
+                }
             }
             if (attr_name) {
                 free(attr_name);
@@ -332,6 +515,46 @@ int load_class_file(const char* filename, LoadedClass* loaded_class) {
     return 0;
 }
 
+// Parse the BootstrapMethods attribute of invokedynamic call sites
+static int parse_bootstrap_methods(const AttributeInfo* attr, ClassInfo* class_info) {
+    ClassReader reader = {
+        .data = attr->info,
+        .size = attr->length,
+        .pos = 0
+    };
+    if (attr->length < 2) {
+        return -1;
+    }
+
+    uint16_t count = read_u2(&reader);
+    BootstrapMethod* methods = calloc(count ? count : 1, sizeof(BootstrapMethod));
+    if (!methods) {
+        return -1;
+    }
+    class_info->bootstrap_methods = methods;
+    class_info->bootstrap_methods_count = count;
+    for (uint16_t i = 0; i < count; i++) {
+        if (reader.pos + 4 > reader.size) {
+            return -1;
+        }
+        methods[i].method_handle = read_u2(&reader);
+        methods[i].arguments_count = read_u2(&reader);
+        if (reader.pos + (size_t)methods[i].arguments_count * 2 > reader.size) {
+            return -1;
+        }
+        if (methods[i].arguments_count > 0) {
+            methods[i].arguments = malloc(methods[i].arguments_count * sizeof(uint16_t));
+            if (!methods[i].arguments) {
+                return -1;
+            }
+        }
+        for (uint16_t j = 0; j < methods[i].arguments_count; j++) {
+            methods[i].arguments[j] = read_u2(&reader);
+        }
+    }
+    return 0;
+}
+
 // Convert loaded class to JVM format
 int convert_to_jvm_class(const LoadedClass* loaded_class, ClassInfo* class_info) {
     if (!loaded_class || !class_info) {
@@ -356,6 +579,7 @@ int convert_to_jvm_class(const LoadedClass* loaded_class, ClassInfo* class_info)
     if (!class_info->name) {
         class_info->name = strdup("UnknownClass");
     }
+    class_info->major_version = loaded_class->major_version;
 
     // Copy constant pool
     class_info->constant_pool_count = loaded_class->constant_pool_count;
@@ -364,6 +588,37 @@ int convert_to_jvm_class(const LoadedClass* loaded_class, ClassInfo* class_info)
                                          sizeof(ConstantPoolEntry));
         memcpy(class_info->constant_pool, loaded_class->constant_pool,
                loaded_class->constant_pool_count * sizeof(ConstantPoolEntry));
+
+        // Flat table of unboxed numeric constants for ldc, ldc_w and ldc2_w
+        class_info->constants = calloc(loaded_class->constant_pool_count, sizeof(jvalue));
+        if (!class_info->constants) {
+            return -1;
+        }
+
+        // Native methods the member refs resolve to, filled in at link time
+        class_info->native_bindings = calloc(loaded_class->constant_pool_count, sizeof(NativeBinding));
+        if (!class_info->native_bindings) {
+            return -1;
+        }
+        for (uint16_t i = 1; i < loaded_class->constant_pool_count; i++) {
+            const ConstantPoolEntry* entry = &loaded_class->constant_pool[i];
+            switch (entry->tag) {
+                case CONST_INTEGER:
+                    class_info->constants[i].i = entry->integer_info.value;
+                    break;
+                case CONST_FLOAT:
+                    class_info->constants[i].f = entry->float_info.value;
+                    break;
+                case CONST_LONG:
+                    class_info->constants[i].l = entry->long_info.value;
+                    break;
+                case CONST_DOUBLE:
+                    class_info->constants[i].d = entry->double_info.value;
+                    break;
+                default:
+                    break;
+            }
+        }
     }
 
     // Convert methods
@@ -389,6 +644,45 @@ int convert_to_jvm_class(const LoadedClass* loaded_class, ClassInfo* class_info)
                 dst->code = malloc(src->code_length);
                 memcpy(dst->code, src->code, src->code_length);
             }
+            if (src->stack_map_table_length > 0 && src->stack_map_table) {
+                dst->stack_map_table = malloc(src->stack_map_table_length);
+                memcpy(dst->stack_map_table, src->stack_map_table, src->stack_map_table_length);
+                dst->stack_map_table_length = src->stack_map_table_length;
+            }
+            if (src->exception_table_length > 0) {
+                size_t size = src->exception_table_length * sizeof(ExceptionTableEntry);
+                dst->exception_table = malloc(size);
+                if (!dst->exception_table) {
+                    return -1;
+                }
+                memcpy(dst->exception_table, src->exception_table, size);
+                dst->exception_table_length = src->exception_table_length;
+            }
+            if (src->line_numbers_count > 0) {
+                size_t size = src->line_numbers_count * sizeof(LineNumberEntry);
+                dst->line_numbers = malloc(size);
+                if (!dst->line_numbers) {
+                    return -1;
+                }
+                memcpy(dst->line_numbers, src->line_numbers, size);
+                dst->line_numbers_count = src->line_numbers_count;
+            }
+        }
+    }
+
+    // Superclass and source file, for exception matching and stack traces,
+    // and the bootstrap methods of invokedynamic
+    class_info->super_name = constant_pool_class_name(class_info, loaded_class->super_class);
+    for (uint16_t i = 0; i < loaded_class->attributes_count; i++) {
+        const AttributeInfo* attr = &loaded_class->attributes[i];
+        const char* name = constant_pool_utf8(class_info, attr->name_index);
+        if (name && strcmp(name, ATTR_SOURCE_FILE) == 0 && attr->length == 2) {
+            class_info->source_file = constant_pool_utf8(class_info,
+                                                         (uint16_t)((attr->info[0] << 8) | attr->info[1]));
+        } else if (name && strcmp(name, ATTR_BOOTSTRAP_METHODS) == 0 &&
+                   !class_info->bootstrap_methods &&
+                   parse_bootstrap_methods(attr, class_info) != 0) {
+            return -1;
         }
     }
     return 0;
@@ -418,6 +712,11 @@ void free_loaded_class(LoadedClass* loaded_class) {
             if (method->code) {
                 free(method->code);
             }
+            if (method->stack_map_table) {
+                free(method->stack_map_table);
+            }
+            free(method->exception_table);
+            free(method->line_numbers);
             if (method->attributes) {
                 for (uint16_t j = 0; j < method->attributes_count; j++) {
                     if (method->attributes[j].info) {
@@ -476,6 +775,14 @@ void free_jvm_class(ClassInfo* class_info) {
         free(class_info->constant_pool);
     }
 
+    if (class_info->constants) {
+        free(class_info->constants);
+    }
+
+    if (class_info->native_bindings) {
+        free(class_info->native_bindings);
+    }
+
     if (class_info->methods) {
         for (uint16_t i = 0; i < class_info->methods_count; i++) {
             MethodInfo* method = &class_info->methods[i];
@@ -488,9 +795,20 @@ void free_jvm_class(ClassInfo* class_info) {
             if (method->code) {
                 free(method->code);
             }
+            if (method->stack_map_table) {
+                free(method->stack_map_table);
+            }
+            free(method->exception_table);
+            free(method->line_numbers);
+            free_method_instructions(method);
         }
         free(class_info->methods);
     }
 
+    for (uint16_t i = 0; i < class_info->bootstrap_methods_count; i++) {
+        free(class_info->bootstrap_methods[i].arguments);
+    }
+    free(class_info->bootstrap_methods);
+
     memset(class_info, 0, sizeof(ClassInfo));
 }
\ No newline at end of file
@@ -12,6 +12,9 @@
 #define ATTR_CODE "Code"
 #define ATTR_CONSTANT_VALUE "ConstantValue"
 #define ATTR_SOURCE_FILE "SourceFile"
+#define ATTR_STACK_MAP_TABLE "StackMapTable"
+#define ATTR_LINE_NUMBER_TABLE "LineNumberTable"
+#define ATTR_BOOTSTRAP_METHODS "BootstrapMethods"
 
 // Structure for reading .class file data
 typedef struct {
@@ -49,6 +52,12 @@ typedef struct {
     uint16_t max_locals;
     uint32_t code_length;
     uint8_t* code;
+    uint32_t stack_map_table_length;
+    uint8_t* stack_map_table;
+    uint16_t exception_table_length;
+    ExceptionTableEntry* exception_table;
+    uint16_t line_numbers_count;
+    LineNumberEntry* line_numbers;
 } LoadedMethodInfo;
 
 // Loaded class structure
@@ -77,5 +86,14 @@ int convert_to_jvm_class(const LoadedClass* loaded_class, ClassInfo* class_info)
 void free_loaded_class(LoadedClass* loaded_class);
 void free_jvm_class(ClassInfo* class_info);
 char* read_utf8_string(const ClassInfo* class_info, uint16_t index);
+const char* constant_pool_utf8(const ClassInfo* class_info, uint16_t index);
+const char* constant_pool_class_name(const ClassInfo* class_info, uint16_t index);
+int constant_pool_member_ref(const ClassInfo* class_info, uint16_t index,
+                             const char** class_name, const char** name,
+                             const char** descriptor);
+int constant_pool_name_and_type(const ClassInfo* class_info, uint16_t index,
+                                const char** name, const char** descriptor);
+int parse_method_descriptor(const char* descriptor, char* arg_types, int max_args);
+char descriptor_return_type(const char* descriptor);
 
 #endif // CLASS_LOADER_H
\ No newline at end of file
@@ -0,0 +1,702 @@
+#include "collections.h"
+#include "jstring.h"
+#include "boxes.h"
+#include "exceptions.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Control bytes of map slots that hold no key; full slots hold a 7-bit tag
+#define CONTROL_EMPTY 0x80
+#define CONTROL_DELETED 0xFE
+
+// Object.hashCode of the objects the VM models: strings and boxes by
+// value, everything else by identity
+jint object_hash_code(JObject* object) {
+    if (!object) {
+        return 0;
+    }
+    switch (object->kind) {
+    case OBJECT_STRING:
+        return string_hash_code((JString*)object);
+    case OBJECT_BOX:
+        return box_hash_code((const JBox*)object);
+    default:
+        return (jint)((uintptr_t)object >> 4);
+    }
+}
+
+// Object.equals, with the same split as object_hash_code
+bool object_equals(const JObject* a, const JObject* b) {
+    if (a == b) {
+        return true;
+    }
+    if (!a || !b || a->kind != b->kind) {
+        return false;
+    }
+    switch (a->kind) {
+    case OBJECT_STRING:
+        return string_equals((const JString*)a, (const JString*)b);
+    case OBJECT_BOX:
+        return box_equals((const JBox*)a, b);
+    default:
+        return false;
+    }
+}
+
+// ArrayList
+
+// Create a list; the element array is allocated by the first insertion
+JArrayList* list_new(JVM* jvm, uint32_t capacity) {
+    JArrayList* list = (JArrayList*)jvm_alloc_object(jvm, "java/util/ArrayList", sizeof(JArrayList));
+    if (!list) {
+        return NULL;
+    }
+    list->header.kind = OBJECT_ARRAY_LIST;
+    if (capacity > 0 && list_reserve(list, capacity) != 0) {
+        return NULL;
+    }
+    return list;
+}
+
+// Make room for capacity elements, growing by half as ArrayList does
+int list_reserve(JArrayList* list, uint32_t capacity) {
+    if (capacity <= list->capacity) {
+        return 0;
+    }
+    uint64_t grown = (uint64_t)list->capacity + list->capacity / 2;
+    if (grown < capacity) {
+        grown = capacity;
+    }
+    if (grown < LIST_MIN_CAPACITY) {
+        grown = LIST_MIN_CAPACITY;
+    }
+    if (grown > INT32_MAX) {
+        return -1;
+    }
+    JObject** elements = realloc(list->elements, (size_t)grown * sizeof(JObject*));
+    if (!elements) {
+        return -1;
+    }
+    list->elements = elements;
+    list->capacity = (uint32_t)grown;
+    return 0;
+}
+
+// Insert an element at index, which the caller has checked is at most size
+int list_insert(JArrayList* list, uint32_t index, JObject* element) {
+    if (list->size == list->capacity && list_reserve(list, list->size + 1) != 0) {
+        return -1;
+    }
+    memmove(&list->elements[index + 1], &list->elements[index],
+            (list->size - index) * sizeof(JObject*));
+    list->elements[index] = element;
+    list->size++;
+    list->mod_count++;
+    return 0;
+}
+
+// Remove the element at index, which the caller has checked is in range
+JObject* list_remove_at(JArrayList* list, uint32_t index) {
+    JObject* element = list->elements[index];
+    list->size--;
+    memmove(&list->elements[index], &list->elements[index + 1],
+            (list->size - index) * sizeof(JObject*));
+    list->mod_count++;
+    return element;
+}
+
+// Index of the first element equal to the given one, or -1
+int32_t list_index_of(const JArrayList* list, const JObject* element) {
+    for (uint32_t i = 0; i < list->size; i++) {
+        if (object_equals(element, list->elements[i])) {
+            return (int32_t)i;
+        }
+    }
+    return -1;
+}
+
+// Remove all elements, keeping the array for reuse
+void list_clear(JArrayList* list) {
+    list->size = 0;
+    list->mod_count++;
+}
+
+JListIterator* list_iterator(JVM* jvm, JArrayList* list) {
+    JListIterator* iterator = (JListIterator*)jvm_alloc_object(jvm, "java/util/ArrayList$Itr",
+                                                               sizeof(JListIterator));
+    if (!iterator) {
+        return NULL;
+    }
+    iterator->header.kind = OBJECT_LIST_ITERATOR;
+    iterator->list = list;
+    iterator->expected_mod_count = list->mod_count;
+    return iterator;
+}
+
+// HashMap
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+// Bit i set when control byte i of the group equals the byte
+static inline uint32_t group_match(const uint8_t* group, uint8_t byte) {
+    __m128i control = _mm_loadu_si128((const __m128i*)group);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(control, _mm_set1_epi8((char)byte)));
+}
+#else
+static inline uint32_t group_match(const uint8_t* group, uint8_t byte) {
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < MAP_GROUP_SIZE; i++) {
+        mask |= (uint32_t)(group[i] == byte) << i;
+    }
+    return mask;
+}
+#endif
+
+// Scramble a hashCode: bits 32 and up pick the first group to probe and
+// the top 7 bits are the control byte tag
+static inline uint64_t map_hash(int32_t hash) {
+    return (uint64_t)(uint32_t)hash * 0x9E3779B97F4A7C15ull;
+}
+
+static inline uint8_t map_tag(uint64_t hash) {
+    return (uint8_t)(hash >> 57);
+}
+
+// Groups are probed in triangular steps, which visit every group of a
+// power-of-two table before repeating
+static inline uint32_t map_first_group(const JHashMap* map, uint64_t hash) {
+    return (uint32_t)(hash >> 32) & (map->capacity / MAP_GROUP_SIZE - 1);
+}
+
+static inline uint32_t map_next_group(const JHashMap* map, uint32_t group, uint32_t step) {
+    return (group + step) & (map->capacity / MAP_GROUP_SIZE - 1);
+}
+
+static uint32_t map_max_load(uint32_t capacity) {
+    return (uint32_t)((uint64_t)capacity * MAP_MAX_LOAD_NUMERATOR / MAP_MAX_LOAD_DENOMINATOR);
+}
+
+JHashMap* map_new(JVM* jvm) {
+    JHashMap* map = (JHashMap*)jvm_alloc_object(jvm, "java/util/HashMap", sizeof(JHashMap));
+    if (!map) {
+        return NULL;
+    }
+    map->header.kind = OBJECT_HASH_MAP;
+    return map;
+}
+
+// Slot holding a key equal to the given one, or NULL
+MapSlot* map_find(JHashMap* map, JObject* key) {
+    if (map->size == 0) {
+        return NULL;
+    }
+    int32_t code = object_hash_code(key);
+    uint64_t hash = map_hash(code);
+    uint8_t tag = map_tag(hash);
+    uint32_t groups = map->capacity / MAP_GROUP_SIZE;
+    uint32_t group = map_first_group(map, hash);
+    for (uint32_t step = 1; step <= groups; step++) {
+        const uint8_t* control = &map->control[group * MAP_GROUP_SIZE];
+        for (uint32_t match = group_match(control, tag); match; match &= match - 1) {
+            MapSlot* slot = &map->slots[group * MAP_GROUP_SIZE + (uint32_t)__builtin_ctz(match)];
+            if (slot->hash == code && object_equals(slot->key, key)) {
+                return slot;
+            }
+        }
+        // A key is never placed past a group that still has an empty slot
+        if (group_match(control, CONTROL_EMPTY)) {
+            return NULL;
+        }
+        group = map_next_group(map, group, step);
+    }
+    return NULL;
+}
+
+// First empty or deleted slot on the probe sequence of a hash; the load
+// limit keeps at least one slot free
+static uint32_t map_free_slot(const JHashMap* map, uint64_t hash) {
+    uint32_t group = map_first_group(map, hash);
+    for (uint32_t step = 1;; step++) {
+        const uint8_t* control = &map->control[group * MAP_GROUP_SIZE];
+        uint32_t free_slots = group_match(control, CONTROL_EMPTY) | group_match(control, CONTROL_DELETED);
+        if (free_slots) {
+            return group * MAP_GROUP_SIZE + (uint32_t)__builtin_ctz(free_slots);
+        }
+        group = map_next_group(map, group, step);
+    }
+}
+
+// Rehash into a table twice as large, or of the same size when deleted
+// slots rather than keys used up the room to grow
+static int map_resize(JHashMap* map) {
+    uint32_t capacity = map->capacity == 0 ? MAP_GROUP_SIZE : map->capacity;
+    if (map->capacity > 0 && map->size >= map_max_load(capacity) / 2) {
+        capacity *= 2;
+    }
+    if (capacity > (1u << 30)) {
+        return -1;
+    }
+    uint8_t* control = malloc(capacity);
+    MapSlot* slots = malloc(capacity * sizeof(MapSlot));
+    if (!control || !slots) {
+        free(control);
+        free(slots);
+        return -1;
+    }
+    memset(control, CONTROL_EMPTY, capacity);
+
+    uint8_t* old_control = map->control;
+    MapSlot* old_slots = map->slots;
+    uint32_t old_capacity = map->capacity;
+    map->control = control;
+    map->slots = slots;
+    map->capacity = capacity;
+    for (uint32_t i = 0; i < old_capacity; i++) {
+        // Empty and deleted slots have the high bit of their control byte set
+        if (old_control[i] & CONTROL_EMPTY) {
+            continue;
+        }
+        uint64_t hash = map_hash(old_slots[i].hash);
+        uint32_t index = map_free_slot(map, hash);
+        control[index] = map_tag(hash);
+        slots[index] = old_slots[i];
+    }
+    map->growth_left = map_max_load(capacity) - map->size;
+    free(old_control);
+    free(old_slots);
+    return 0;
+}
+
+// Map a key to a value; previous receives the value replaced, or NULL
+int map_put(JHashMap* map, JObject* key, JObject* value, JObject** previous) {
+    MapSlot* slot = map_find(map, key);
+    if (slot) {
+        *previous = slot->value;
+        slot->value = value;
+        return 0;
+    }
+    *previous = NULL;
+
+    int32_t code = object_hash_code(key);
+    uint64_t hash = map_hash(code);
+    if (map->growth_left == 0 && map_resize(map) != 0) {
+        return -1;
+    }
+    uint32_t index = map_free_slot(map, hash);
+    if (map->control[index] == CONTROL_EMPTY) {
+        map->growth_left--;
+    }
+    map->control[index] = map_tag(hash);
+    map->slots[index].key = key;
+    map->slots[index].value = value;
+    map->slots[index].hash = code;
+    map->size++;
+    return 0;
+}
+
+// Remove a key; previous receives its value. A slot whose group still has
+// an empty slot becomes empty again, since no probe continues past it.
+bool map_remove(JHashMap* map, JObject* key, JObject** previous) {
+    MapSlot* slot = map_find(map, key);
+    if (!slot) {
+        *previous = NULL;
+        return false;
+    }
+    *previous = slot->value;
+    uint32_t index = (uint32_t)(slot - map->slots);
+    if (group_match(&map->control[index & ~(MAP_GROUP_SIZE - 1u)], CONTROL_EMPTY)) {
+        map->control[index] = CONTROL_EMPTY;
+        map->growth_left++;
+    } else {
+        map->control[index] = CONTROL_DELETED;
+    }
+    map->size--;
+    return true;
+}
+
+void map_clear(JHashMap* map) {
+    if (map->capacity > 0) {
+        memset(map->control, CONTROL_EMPTY, map->capacity);
+    }
+    map->size = 0;
+    map->growth_left = map_max_load(map->capacity);
+}
+
+// Natives. The receiver, args[0], is never null: invoke_native checks it.
+// Calls through List, Collection and Map reach the same functions, since
+// ArrayList and HashMap are the only classes the VM models behind them.
+
+// Throw IndexOutOfBoundsException with the message of the collections
+static int throw_index_out_of_bounds(JVM* jvm, Frame* frame, jint index, uint32_t length) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "Index %d out of bounds for length %u", index, length);
+    JString* message = jvm_create_string(jvm, buffer);
+    JThrowable* exception = message ? jvm_new_throwable(jvm, "java/lang/IndexOutOfBoundsException", message)
+                                    : NULL;
+    if (!exception) {
+        return -1;
+    }
+    return jvm_throw(jvm, frame, exception);
+}
+
+// toString of a list or map
+static int native_collection_to_string(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)frame;
+    result->ref = object_to_string(jvm, (const JObject*)args[0].ref);
+    return result->ref ? 0 : -1;
+}
+
+// ArrayList(), ArrayList(int) and ArrayList(Collection)
+static int native_list_init(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)jvm;
+    (void)frame;
+    (void)args;
+    (void)result;
+    return 0;
+}
+
+static int native_list_init_capacity(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)result;
+    if (args[1].i < 0) {
+        return jvm_throw_new(jvm, frame, "java/lang/IllegalArgumentException", "Illegal Capacity");
+    }
+    return list_reserve((JArrayList*)args[0].ref, (uint32_t)args[1].i);
+}
+
+static int native_list_init_copy(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)result;
+    JArrayList* list = (JArrayList*)args[0].ref;
+    JArrayList* source = (JArrayList*)args[1].ref;
+    if (!source) {
+        return jvm_throw_new(jvm, frame, "java/lang/NullPointerException", NULL);
+    }
+    if (source->header.kind != OBJECT_ARRAY_LIST) {
+        return jvm_throw_new(jvm, frame, "java/lang/UnsupportedOperationException", NULL);
+    }
+    if (list_reserve(list, source->size) != 0) {
+        return -1;
+    }
+    memcpy(list->elements, source->elements, source->size * sizeof(JObject*));
+    list->size = source->size;
+    return 0;
+}
+
+static int native_list_size(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)jvm;
+    (void)frame;
+    result->i = (jint)((JArrayList*)args[0].ref)->size;
+    return 0;
+}
+
+static int native_list_is_empty(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)jvm;
+    (void)frame;
+    result->i = ((JArrayList*)args[0].ref)->size == 0;
+    return 0;
+}
+
+static int native_list_clear(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)jvm;
+    (void)frame;
+    (void)result;
+    list_clear((JArrayList*)args[0].ref);
+    return 0;
+}
+
+// add(Object)
+static int native_list_add(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)jvm;
+    (void)frame;
+    JArrayList* list = (JArrayList*)args[0].ref;
+    if (list_insert(list, list->size, (JObject*)args[1].ref) != 0) {
+        return -1;
+    }
+    result->i = 1;
+    return 0;
+}
+
+// add(int, Object)
+static int native_list_add_at(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)result;
+    JArrayList* list = (JArrayList*)args[0].ref;
+    jint index = args[1].i;
+    if (index < 0 || (uint32_t)index > list->size) {
+        return throw_index_out_of_bounds(jvm, frame, index, list->size);
+    }
+    return list_insert(list, (uint32_t)index, (JObject*)args[2].ref);
+}
+
+static int native_list_get(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    JArrayList* list = (JArrayList*)args[0].ref;
+    jint index = args[1].i;
+    if (index < 0 || (uint32_t)index >= list->size) {
+        return throw_index_out_of_bounds(jvm, frame, index, list->size);
+    }
+    result->ref = list->elements[index];
+    return 0;
+}
+
+static int native_list_set(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    JArrayList* list = (JArrayList*)args[0].ref;
+    jint index = args[1].i;
+    if (index < 0 || (uint32_t)index >= list->size) {
+        return throw_index_out_of_bounds(jvm, frame, index, list->size);
+    }
+    result->ref = list->elements[index];
+    list->elements[index] = (JObject*)args[2].ref;
+    return 0;
+}
+
+// remove(int)
+static int native_list_remove_at(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    JArrayList* list = (JArrayList*)args[0].ref;
+    jint index = args[1].i;
+    if (index < 0 || (uint32_t)index >= list->size) {
+        return throw_index_out_of_bounds(jvm, frame, index, list->size);
+    }
+    result->ref = list_remove_at(list, (uint32_t)index);
+    return 0;
+}
+
+// remove(Object)
+static int native_list_remove(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)jvm;
+    (void)frame;
+    JArrayList* list = (JArrayList*)args[0].ref;
+    int32_t index = list_index_of(list, (const JObject*)args[1].ref);
+    if (index >= 0) {
+        list_remove_at(list, (uint32_t)index);
+    }
+    result->i = index >= 0;
+    return 0;
+}
+
+static int native_list_contains(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)jvm;
+    (void)frame;
+    result->i = list_index_of((JArrayList*)args[0].ref, (const JObject*)args[1].ref) >= 0;
+    return 0;
+}
+
+static int native_list_index_of(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)jvm;
+    (void)frame;
+    result->i = list_index_of((JArrayList*)args[0].ref, (const JObject*)args[1].ref);
+    return 0;
+}
+
+static int native_list_add_all(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    JArrayList* list = (JArrayList*)args[0].ref;
+    JArrayList* other = (JArrayList*)args[1].ref;
+    if (!other) {
+        return jvm_throw_new(jvm, frame, "java/lang/NullPointerException", NULL);
+    }
+    if (other->header.kind != OBJECT_ARRAY_LIST) {
+        return jvm_throw_new(jvm, frame, "java/lang/UnsupportedOperationException", NULL);
+    }
+    uint32_t count = other->size;
+    if (list_reserve(list, list->size + count) != 0) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        list_insert(list, list->size, other->elements[i]);
+    }
+    result->i = count > 0;
+    return 0;
+}
+
+static int native_list_iterator(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)frame;
+    result->ref = list_iterator(jvm, (JArrayList*)args[0].ref);
+    return result->ref ? 0 : -1;
+}
+
+// Iterator of an ArrayList, which fails fast when the list changes
+// structurally under it
+static int native_iterator_has_next(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)jvm;
+    (void)frame;
+    const JListIterator* iterator = (const JListIterator*)args[0].ref;
+    result->i = iterator->cursor < iterator->list->size;
+    return 0;
+}
+
+static int native_iterator_next(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    JListIterator* iterator = (JListIterator*)args[0].ref;
+    if (iterator->expected_mod_count != iterator->list->mod_count) {
+        return jvm_throw_new(jvm, frame, "java/util/ConcurrentModificationException", NULL);
+    }
+    if (iterator->cursor >= iterator->list->size) {
+        return jvm_throw_new(jvm, frame, "java/util/NoSuchElementException", NULL);
+    }
+    result->ref = iterator->list->elements[iterator->cursor++];
+    return 0;
+}
+
+// HashMap(), HashMap(int) and HashMap(int, float): the map grows by itself,
+// so capacity hints are only checked
+static int native_map_init(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)jvm;
+    (void)frame;
+    (void)args;
+    (void)result;
+    return 0;
+}
+
+static int native_map_init_capacity(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)result;
+    if (args[1].i < 0) {
+        return jvm_throw_new(jvm, frame, "java/lang/IllegalArgumentException", "Illegal Capacity");
+    }
+    return 0;
+}
+
+static int native_map_size(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)jvm;
+    (void)frame;
+    result->i = (jint)((JHashMap*)args[0].ref)->size;
+    return 0;
+}
+
+static int native_map_is_empty(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)jvm;
+    (void)frame;
+    result->i = ((JHashMap*)args[0].ref)->size == 0;
+    return 0;
+}
+
+static int native_map_clear(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)jvm;
+    (void)frame;
+    (void)result;
+    map_clear((JHashMap*)args[0].ref);
+    return 0;
+}
+
+static int native_map_put(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)jvm;
+    (void)frame;
+    JObject* previous;
+    if (map_put((JHashMap*)args[0].ref, (JObject*)args[1].ref, (JObject*)args[2].ref, &previous) != 0) {
+        return -1;
+    }
+    result->ref = previous;
+    return 0;
+}
+
+static int native_map_get(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)jvm;
+    (void)frame;
+    MapSlot* slot = map_find((JHashMap*)args[0].ref, (JObject*)args[1].ref);
+    result->ref = slot ? slot->value : NULL;
+    return 0;
+}
+
+static int native_map_get_or_default(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)jvm;
+    (void)frame;
+    MapSlot* slot = map_find((JHashMap*)args[0].ref, (JObject*)args[1].ref);
+    result->ref = slot ? slot->value : args[2].ref;
+    return 0;
+}
+
+static int native_map_remove(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)jvm;
+    (void)frame;
+    JObject* previous;
+    map_remove((JHashMap*)args[0].ref, (JObject*)args[1].ref, &previous);
+    result->ref = previous;
+    return 0;
+}
+
+static int native_map_contains_key(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)jvm;
+    (void)frame;
+    result->i = map_find((JHashMap*)args[0].ref, (JObject*)args[1].ref) != NULL;
+    return 0;
+}
+
+typedef struct {
+    const char* name;
+    const char* descriptor;
+    NativeMethod function;
+} CollectionNative;
+
+// Methods of Collection, which List and ArrayList inherit
+static const CollectionNative collection_natives[] = {
+    {"size", "()I", native_list_size},
+    {"isEmpty", "()Z", native_list_is_empty},
+    {"clear", "()V", native_list_clear},
+    {"add", "(Ljava/lang/Object;)Z", native_list_add},
+    {"remove", "(Ljava/lang/Object;)Z", native_list_remove},
+    {"contains", "(Ljava/lang/Object;)Z", native_list_contains},
+    {"addAll", "(Ljava/util/Collection;)Z", native_list_add_all},
+    {"iterator", "()Ljava/util/Iterator;", native_list_iterator},
+    {"toString", "()Ljava/lang/String;", native_collection_to_string},
+};
+
+// Methods List adds
+static const CollectionNative list_natives[] = {
+    {"add", "(ILjava/lang/Object;)V", native_list_add_at},
+    {"get", "(I)Ljava/lang/Object;", native_list_get},
+    {"set", "(ILjava/lang/Object;)Ljava/lang/Object;", native_list_set},
+    {"remove", "(I)Ljava/lang/Object;", native_list_remove_at},
+    {"indexOf", "(Ljava/lang/Object;)I", native_list_index_of},
+};
+
+static const CollectionNative array_list_constructors[] = {
+    {"<init>", "()V", native_list_init},
+    {"<init>", "(I)V", native_list_init_capacity},
+    {"<init>", "(Ljava/util/Collection;)V", native_list_init_copy},
+};
+
+static const CollectionNative map_natives[] = {
+    {"size", "()I", native_map_size},
+    {"isEmpty", "()Z", native_map_is_empty},
+    {"clear", "()V", native_map_clear},
+    {"put", "(Ljava/lang/Object;Ljava/lang/Object;)Ljava/lang/Object;", native_map_put},
+    {"get", "(Ljava/lang/Object;)Ljava/lang/Object;", native_map_get},
+    {"getOrDefault", "(Ljava/lang/Object;Ljava/lang/Object;)Ljava/lang/Object;", native_map_get_or_default},
+    {"remove", "(Ljava/lang/Object;)Ljava/lang/Object;", native_map_remove},
+    {"containsKey", "(Ljava/lang/Object;)Z", native_map_contains_key},
+    {"toString", "()Ljava/lang/String;", native_collection_to_string},
+};
+
+static const CollectionNative hash_map_constructors[] = {
+    {"<init>", "()V", native_map_init},
+    {"<init>", "(I)V", native_map_init_capacity},
+    {"<init>", "(IF)V", native_map_init_capacity},
+};
+
+static const CollectionNative iterator_natives[] = {
+    {"hasNext", "()Z", native_iterator_has_next},
+    {"next", "()Ljava/lang/Object;", native_iterator_next},
+};
+
+static void register_natives(Runtime* runtime, const char* class_name, const CollectionNative* natives,
+                             size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        runtime_register_native_method(runtime, class_name, natives[i].name, natives[i].descriptor,
+                                       natives[i].function);
+    }
+}
+
+#define REGISTER_NATIVES(runtime, class_name, natives) \
+    register_natives(runtime, class_name, natives, sizeof(natives) / sizeof(natives[0]))
+
+// Register the collection methods under each class and interface that
+// declares them
+void register_collection_native_methods(Runtime* runtime) {
+    REGISTER_NATIVES(runtime, "java/util/Collection", collection_natives);
+    REGISTER_NATIVES(runtime, "java/util/List", collection_natives);
+    REGISTER_NATIVES(runtime, "java/util/List", list_natives);
+    REGISTER_NATIVES(runtime, "java/util/ArrayList", collection_natives);
+    REGISTER_NATIVES(runtime, "java/util/ArrayList", list_natives);
+    REGISTER_NATIVES(runtime, "java/util/ArrayList", array_list_constructors);
+    REGISTER_NATIVES(runtime, "java/util/Map", map_natives);
+    REGISTER_NATIVES(runtime, "java/util/HashMap", map_natives);
+    REGISTER_NATIVES(runtime, "java/util/HashMap", hash_map_constructors);
+    REGISTER_NATIVES(runtime, "java/util/Iterator", iterator_natives);
+}
@@ -0,0 +1,31 @@
+// collections.h - java.util.ArrayList and HashMap implemented in C
+#ifndef COLLECTIONS_H
+#define COLLECTIONS_H
+
+#include "jvm.h"
+
+// Smallest capacity of a list with elements
+#define LIST_MIN_CAPACITY 10
+
+// Maximum load of a map, as a fraction of its capacity
+#define MAP_MAX_LOAD_NUMERATOR 7
+#define MAP_MAX_LOAD_DENOMINATOR 8
+
+// Public API functions
+jint object_hash_code(JObject* object);
+bool object_equals(const JObject* a, const JObject* b);
+JArrayList* list_new(JVM* jvm, uint32_t capacity);
+int list_reserve(JArrayList* list, uint32_t capacity);
+int list_insert(JArrayList* list, uint32_t index, JObject* element);
+JObject* list_remove_at(JArrayList* list, uint32_t index);
+int32_t list_index_of(const JArrayList* list, const JObject* element);
+void list_clear(JArrayList* list);
+JListIterator* list_iterator(JVM* jvm, JArrayList* list);
+JHashMap* map_new(JVM* jvm);
+MapSlot* map_find(JHashMap* map, JObject* key);
+int map_put(JHashMap* map, JObject* key, JObject* value, JObject** previous);
+bool map_remove(JHashMap* map, JObject* key, JObject** previous);
+void map_clear(JHashMap* map);
+void register_collection_native_methods(Runtime* runtime);
+
+#endif // COLLECTIONS_H
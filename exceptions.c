@@ -0,0 +1,230 @@
+#include "exceptions.h"
+#include "class_loader.h"
+#include "jstring.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Throwable classes of the class library, with their superclasses
+static const struct {
+    const char* name;
+    const char* super_name;
+} builtin_throwables[] = {
+    { "java/lang/Throwable", "java/lang/Object" },
+    { "java/lang/Exception", "java/lang/Throwable" },
+    { "java/lang/Error", "java/lang/Throwable" },
+    { "java/lang/RuntimeException", "java/lang/Exception" },
+    { "java/lang/ArithmeticException", "java/lang/RuntimeException" },
+    { "java/lang/ArrayStoreException", "java/lang/RuntimeException" },
+    { "java/lang/ClassCastException", "java/lang/RuntimeException" },
+    { "java/lang/IllegalArgumentException", "java/lang/RuntimeException" },
+    { "java/lang/NumberFormatException", "java/lang/IllegalArgumentException" },
+    { "java/lang/IllegalThreadStateException", "java/lang/IllegalArgumentException" },
+    { "java/lang/IllegalStateException", "java/lang/RuntimeException" },
+    { "java/lang/IllegalMonitorStateException", "java/lang/RuntimeException" },
+    { "java/lang/IndexOutOfBoundsException", "java/lang/RuntimeException" },
+    { "java/lang/ArrayIndexOutOfBoundsException", "java/lang/IndexOutOfBoundsException" },
+    { "java/lang/StringIndexOutOfBoundsException", "java/lang/IndexOutOfBoundsException" },
+    { "java/lang/NegativeArraySizeException", "java/lang/RuntimeException" },
+    { "java/lang/NullPointerException", "java/lang/RuntimeException" },
+    { "java/lang/UnsupportedOperationException", "java/lang/RuntimeException" },
+    { "java/util/NoSuchElementException", "java/lang/RuntimeException" },
+    { "java/util/InputMismatchException", "java/util/NoSuchElementException" },
+    { "java/util/ConcurrentModificationException", "java/lang/RuntimeException" },
+    { "java/lang/CloneNotSupportedException", "java/lang/Exception" },
+    { "java/lang/InterruptedException", "java/lang/Exception" },
+    { "java/io/IOException", "java/lang/Exception" },
+    { "java/lang/AssertionError", "java/lang/Error" },
+    { "java/lang/LinkageError", "java/lang/Error" },
+    { "java/lang/BootstrapMethodError", "java/lang/LinkageError" },
+    { "java/lang/UnsatisfiedLinkError", "java/lang/LinkageError" },
+    { "java/lang/VirtualMachineError", "java/lang/Error" },
+    { "java/lang/OutOfMemoryError", "java/lang/VirtualMachineError" },
+    { "java/lang/StackOverflowError", "java/lang/VirtualMachineError" },
+};
+
+static bool ends_with(const char* str, const char* suffix) {
+    size_t length = strlen(str);
+    size_t suffix_length = strlen(suffix);
+    return length >= suffix_length && strcmp(str + length - suffix_length, suffix) == 0;
+}
+
+// Superclass of a class: loaded classes know theirs; classes that are not
+// loaded are placed by the naming convention for exceptions and errors
+static const char* super_class_name(JVM* jvm, const char* class_name) {
+    for (size_t i = 0; i < sizeof(builtin_throwables) / sizeof(builtin_throwables[0]); i++) {
+        if (strcmp(builtin_throwables[i].name, class_name) == 0) {
+            return builtin_throwables[i].super_name;
+        }
+    }
+    const Runtime* runtime = jvm->runtime;
+    for (uint16_t i = 0; i < runtime->classes_count; i++) {
+        if (strcmp(runtime->classes[i].name, class_name) == 0) {
+            return runtime->classes[i].super_name;
+        }
+    }
+    if (ends_with(class_name, "Exception")) {
+        return "java/lang/Exception";
+    }
+    if (ends_with(class_name, "Error")) {
+        return "java/lang/Error";
+    }
+    return NULL;
+}
+
+// Whether class_name is super_name or one of its subclasses
+bool is_subclass_of(JVM* jvm, const char* class_name, const char* super_name) {
+    while (class_name) {
+        if (strcmp(class_name, super_name) == 0) {
+            return true;
+        }
+        if (strcmp(class_name, "java/lang/Object") == 0) {
+            return false;
+        }
+        class_name = super_class_name(jvm, class_name);
+    }
+    return false;
+}
+
+bool is_throwable_class(JVM* jvm, const char* class_name) {
+    return is_subclass_of(jvm, class_name, "java/lang/Throwable");
+}
+
+// Allocate an exception object; the backtrace is recorded when it is thrown
+JThrowable* jvm_new_throwable(JVM* jvm, const char* class_name, JString* message) {
+    JThrowable* throwable = (JThrowable*)jvm_alloc_object(jvm, class_name, sizeof(JThrowable));
+    if (!throwable) {
+        return NULL;
+    }
+    throwable->header.kind = OBJECT_THROWABLE;
+    throwable->message = message;
+    return throwable;
+}
+
+// Record the frames the exception passes through, innermost first. Only
+// methods and bytecode offsets are kept; lines are resolved when printed.
+static int fill_backtrace(JThrowable* exception, const Frame* frame) {
+    uint16_t depth = 0;
+    for (const Frame* f = frame; f && depth < MAX_BACKTRACE_DEPTH; f = f->caller) {
+        depth++;
+    }
+
+    exception->backtrace = malloc(depth * sizeof(BacktraceEntry));
+    if (!exception->backtrace) {
+        return -1;
+    }
+    depth = 0;
+    for (const Frame* f = frame; f && depth < MAX_BACKTRACE_DEPTH; f = f->caller) {
+        BacktraceEntry* entry = &exception->backtrace[depth++];
+        const Instruction* insn = f->pc > f->method->instructions ? f->pc - 1 : f->pc;
+        entry->class_info = f->class_info;
+        entry->method = f->method;
+        entry->offset = insn->offset;
+    }
+    exception->backtrace_depth = depth;
+    return 0;
+}
+
+// Start unwinding with the exception pending. The backtrace is taken on the
+// first throw, so rethrowing keeps the original trace.
+int jvm_throw(JVM* jvm, Frame* frame, JThrowable* exception) {
+    if (!exception) {
+        return jvm_throw_new(jvm, frame, "java/lang/NullPointerException", NULL);
+    }
+    if (!exception->backtrace && fill_backtrace(exception, frame) != 0) {
+        return -1;
+    }
+    jvm->exception = exception;
+    return JVM_EXCEPTION_PENDING;
+}
+
+// Throw an exception raised by the VM itself
+int jvm_throw_new(JVM* jvm, Frame* frame, const char* class_name, const char* message) {
+    JThrowable* exception = jvm_new_throwable(jvm, class_name, NULL);
+    if (!exception) {
+        return -1;
+    }
+    exception->detail = message;
+    return jvm_throw(jvm, frame, exception);
+}
+
+// Handler in the frame's method for an exception thrown by the instruction
+// before frame->pc: binary search for the range holding the instruction,
+// then the first of its handlers whose catch type matches
+const ExceptionHandler* find_exception_handler(JVM* jvm, const Frame* frame,
+                                               const JThrowable* exception) {
+    const MethodInfo* method = frame->method;
+    int32_t index = (int32_t)(frame->pc - method->instructions) - 1;
+    const ExceptionRange* range = method->exception_ranges;
+    uint32_t n = method->exception_ranges_count;
+    if (n == 0 || index < range->start) {
+        return NULL;
+    }
+    while (n > 1) {
+        uint32_t half = n / 2;
+        range = range[half].start <= index ? range + half : range;
+        n -= half;
+    }
+
+    for (uint16_t i = 0; i < range->count; i++) {
+        const ExceptionHandler* handler =
+            &method->exception_handlers[method->exception_range_handlers[range->first + i]];
+        if (handler->catch_type == 0) {
+            return handler;
+        }
+        const char* catch_name = constant_pool_class_name(frame->class_info, handler->catch_type);
+        if (catch_name && is_subclass_of(jvm, exception->header.class_name, catch_name)) {
+            return handler;
+        }
+    }
+    return NULL;
+}
+
+// Source line of a bytecode offset, or 0 if the method has no line numbers
+static int line_number(const MethodInfo* method, uint32_t offset) {
+    int line = 0;
+    uint32_t best = 0;
+    for (uint16_t i = 0; i < method->line_numbers_count; i++) {
+        const LineNumberEntry* entry = &method->line_numbers[i];
+        if (entry->start_pc <= offset && (line == 0 || entry->start_pc >= best)) {
+            best = entry->start_pc;
+            line = entry->line_number;
+        }
+    }
+    return line;
+}
+
+static void print_class_name(FILE* stream, const char* class_name) {
+    for (const char* p = class_name; *p; p++) {
+        fputc(*p == '/' ? '.' : *p, stream);
+    }
+}
+
+// Print the exception and its backtrace like Throwable.printStackTrace
+void jvm_print_stack_trace(JVM* jvm, const JThrowable* exception) {
+    print_class_name(jvm->err, exception->header.class_name);
+    if (exception->message) {
+        fputs(": ", jvm->err);
+        string_write_utf8(exception->message, jvm->err);
+    } else if (exception->detail) {
+        fprintf(jvm->err, ": %s", exception->detail);
+    }
+    fputc('\n', jvm->err);
+
+    for (uint16_t i = 0; i < exception->backtrace_depth; i++) {
+        const BacktraceEntry* entry = &exception->backtrace[i];
+        fputs("\tat ", jvm->err);
+        print_class_name(jvm->err, entry->class_info->name);
+        fprintf(jvm->err, ".%s(", entry->method->name);
+        int line = line_number(entry->method, entry->offset);
+        if (!entry->class_info->source_file) {
+            fputs("Unknown Source", jvm->err);
+        } else if (line > 0) {
+            fprintf(jvm->err, "%s:%d", entry->class_info->source_file, line);
+        } else {
+            fputs(entry->class_info->source_file, jvm->err);
+        }
+        fputs(")\n", jvm->err);
+    }
+    fflush(jvm->err);
+}
@@ -0,0 +1,20 @@
+// exceptions.h - Exception objects, handler lookup and stack traces
+#ifndef EXCEPTIONS_H
+#define EXCEPTIONS_H
+
+#include "jvm.h"
+
+// Deepest backtrace recorded for a thrown exception
+#define MAX_BACKTRACE_DEPTH 1024
+
+// Public API functions
+bool is_subclass_of(JVM* jvm, const char* class_name, const char* super_name);
+bool is_throwable_class(JVM* jvm, const char* class_name);
+JThrowable* jvm_new_throwable(JVM* jvm, const char* class_name, JString* message);
+int jvm_throw(JVM* jvm, Frame* frame, JThrowable* exception);
+int jvm_throw_new(JVM* jvm, Frame* frame, const char* class_name, const char* message);
+const ExceptionHandler* find_exception_handler(JVM* jvm, const Frame* frame,
+                                               const JThrowable* exception);
+void jvm_print_stack_trace(JVM* jvm, const JThrowable* exception);
+
+#endif // EXCEPTIONS_H
@@ -0,0 +1,77 @@
+#include "heap.h"
+#include <stdlib.h>
+
+// Block of heap memory; its space starts after the header, aligned
+struct HeapChunk {
+    struct HeapChunk* next;
+};
+
+#define CHUNK_HEADER_SIZE HEAP_ALIGN(sizeof(HeapChunk))
+
+void heap_init(Heap* heap) {
+    pthread_mutex_init(&heap->lock, NULL);
+    heap->chunks = NULL;
+    heap->top = NULL;
+    heap->end = NULL;
+}
+
+// Free every chunk, and with them every object of the instance
+void heap_destroy(Heap* heap) {
+    while (heap->chunks) {
+        HeapChunk* chunk = heap->chunks;
+        heap->chunks = chunk->next;
+        free(chunk);
+    }
+    pthread_mutex_destroy(&heap->lock);
+}
+
+// Zeroed chunk space for size bytes, taken under the heap lock. Space too
+// large for a chunk gets a chunk of its own, leaving the current one to
+// the buffers.
+static void* heap_alloc_shared(Heap* heap, size_t size) {
+    pthread_mutex_lock(&heap->lock);
+    void* memory = NULL;
+    if ((size_t)(heap->end - heap->top) >= size) {
+        memory = heap->top;
+        heap->top += size;
+    } else if (size > HEAP_CHUNK_SIZE / 4) {
+        HeapChunk* chunk = calloc(1, CHUNK_HEADER_SIZE + size);
+        if (chunk) {
+            chunk->next = heap->chunks;
+            heap->chunks = chunk;
+            memory = (uint8_t*)chunk + CHUNK_HEADER_SIZE;
+        }
+    } else {
+        HeapChunk* chunk = calloc(1, CHUNK_HEADER_SIZE + HEAP_CHUNK_SIZE);
+        if (chunk) {
+            chunk->next = heap->chunks;
+            heap->chunks = chunk;
+            memory = (uint8_t*)chunk + CHUNK_HEADER_SIZE;
+            heap->top = (uint8_t*)memory + size;
+            heap->end = (uint8_t*)memory + HEAP_CHUNK_SIZE;
+        }
+    }
+    pthread_mutex_unlock(&heap->lock);
+    return memory;
+}
+
+// Allocate an object that does not fit the thread's buffer, from the heap
+// of the instance's main thread: from a new buffer when the current one
+// is nearly full and the object small, otherwise directly
+void* heap_alloc_slow(JVM* jvm, size_t size) {
+    Heap* heap = &jvm->main->heap;
+    size_t buffer_size = jvm->tlab_size > TLAB_MIN_SIZE ? jvm->tlab_size : TLAB_MIN_SIZE;
+    size_t left = (size_t)(jvm->tlab_end - jvm->tlab_top);
+    if (size > buffer_size / 4 || left > buffer_size / TLAB_WASTE_FRACTION) {
+        return heap_alloc_shared(heap, size);
+    }
+
+    uint8_t* buffer = heap_alloc_shared(heap, buffer_size);
+    if (!buffer) {
+        return NULL;
+    }
+    jvm->tlab_top = buffer + size;
+    jvm->tlab_end = buffer + buffer_size;
+    jvm->tlab_size = buffer_size < TLAB_MAX_SIZE ? buffer_size * 2 : TLAB_MAX_SIZE;
+    return buffer;
+}
@@ -0,0 +1,42 @@
+// heap.h - Object heap with thread-local allocation buffers
+#ifndef HEAP_H
+#define HEAP_H
+
+#include "jvm.h"
+
+// Alignment of every object, enough for any field
+#define HEAP_ALIGNMENT 16
+
+// Chunk of the heap that allocation buffers are carved from
+#define HEAP_CHUNK_SIZE (1024 * 1024)
+
+// Allocation buffer sizes: a thread starts with the smallest, and each
+// refill doubles it, so threads that allocate fast refill rarely
+#define TLAB_MIN_SIZE (4 * 1024)
+#define TLAB_MAX_SIZE (256 * 1024)
+
+// A buffer is only retired with at most 1/TLAB_WASTE_FRACTION of it
+// unused; an object that does not fit a fuller buffer is allocated from
+// the chunk instead
+#define TLAB_WASTE_FRACTION 64
+
+#define HEAP_ALIGN(size) (((size) + HEAP_ALIGNMENT - 1) & ~(size_t)(HEAP_ALIGNMENT - 1))
+
+// Public API functions
+void heap_init(Heap* heap);
+void heap_destroy(Heap* heap);
+void* heap_alloc_slow(JVM* jvm, size_t size);
+
+// Allocate zeroed memory for an object: a pointer bump in the thread's
+// buffer, without locking
+static inline void* heap_alloc(JVM* jvm, size_t size) {
+    size = HEAP_ALIGN(size);
+    if ((size_t)(jvm->tlab_end - jvm->tlab_top) >= size) {
+        void* memory = jvm->tlab_top;
+        jvm->tlab_top += size;
+        return memory;
+    }
+    return heap_alloc_slow(jvm, size);
+}
+
+#endif // HEAP_H
@@ -0,0 +1,778 @@
+#include "jstring.h"
+#include "string_kernels.h"
+#include "boxes.h"
+#include "exceptions.h"
+#include <stdlib.h>
+#include <string.h>
+
+// UTF-16 code units are stored unaligned after the header
+static inline uint16_t utf16_at(const JString* str, uint32_t index) {
+    uint16_t c;
+    memcpy(&c, &str->value[2 * (size_t)index], sizeof(c));
+    return c;
+}
+
+static inline void set_utf16(JString* str, uint32_t index, uint16_t c) {
+    memcpy(&str->value[2 * (size_t)index], &c, sizeof(c));
+}
+
+// Whether the eight bytes at p are all ASCII
+static inline bool ascii_word(const uint8_t* p) {
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    return (word & 0x8080808080808080ull) == 0;
+}
+
+static inline bool is_continuation(const uint8_t* bytes, size_t size, size_t pos) {
+    return pos < size && (bytes[pos] & 0xC0) == 0x80;
+}
+
+// Decode the non-ASCII character at bytes[*pos]: the two and three byte
+// forms of modified UTF-8, plus four byte standard UTF-8 from host text.
+// Malformed input decodes to U+FFFD one byte at a time.
+static uint32_t decode_utf8_char(const uint8_t* bytes, size_t size, size_t* pos) {
+    size_t p = *pos;
+    uint8_t c = bytes[p];
+    if ((c & 0xE0) == 0xC0 && is_continuation(bytes, size, p + 1)) {
+        *pos = p + 2;
+        return ((uint32_t)(c & 0x1F) << 6) | (bytes[p + 1] & 0x3F);
+    }
+    if ((c & 0xF0) == 0xE0 && is_continuation(bytes, size, p + 1) &&
+        is_continuation(bytes, size, p + 2)) {
+        *pos = p + 3;
+        return ((uint32_t)(c & 0x0F) << 12) | ((uint32_t)(bytes[p + 1] & 0x3F) << 6) |
+               (bytes[p + 2] & 0x3F);
+    }
+    if ((c & 0xF8) == 0xF0 && is_continuation(bytes, size, p + 1) &&
+        is_continuation(bytes, size, p + 2) && is_continuation(bytes, size, p + 3)) {
+        *pos = p + 4;
+        return ((uint32_t)(c & 0x07) << 18) | ((uint32_t)(bytes[p + 1] & 0x3F) << 12) |
+               ((uint32_t)(bytes[p + 2] & 0x3F) << 6) | (bytes[p + 3] & 0x3F);
+    }
+    *pos = p + 1;
+    return 0xFFFD;
+}
+
+// Allocate a string of length characters with uninitialized contents
+JString* string_new(JVM* jvm, uint32_t length, uint8_t coder) {
+    size_t size = coder == STRING_LATIN1 ? length : 2 * (size_t)length;
+    JString* str = (JString*)jvm_alloc_object(jvm, "java/lang/String", sizeof(JString) + size);
+    if (!str) {
+        return NULL;
+    }
+    str->header.kind = OBJECT_STRING;
+    str->length = length;
+    str->coder = coder;
+    return str;
+}
+
+// Decode (modified) UTF-8 into a Latin-1 string when every character fits,
+// otherwise UTF-16. ASCII, the common case, is scanned and copied eight
+// bytes at a time.
+JString* string_from_utf8(JVM* jvm, const char* text, size_t size) {
+    const uint8_t* bytes = (const uint8_t*)text;
+
+    // First pass: length in UTF-16 code units and the narrowest coder
+    uint32_t length = 0;
+    bool latin1 = true;
+    for (size_t pos = 0; pos < size; ) {
+        while (pos + 8 <= size && ascii_word(bytes + pos)) {
+            pos += 8;
+            length += 8;
+        }
+        if (pos >= size) {
+            break;
+        }
+        if (bytes[pos] < 0x80) {
+            pos++;
+            length++;
+            continue;
+        }
+        uint32_t c = decode_utf8_char(bytes, size, &pos);
+        length += c > 0xFFFF ? 2 : 1;
+        latin1 = latin1 && c <= 0xFF;
+    }
+
+    JString* str = string_new(jvm, length, latin1 ? STRING_LATIN1 : STRING_UTF16);
+    if (!str) {
+        return NULL;
+    }
+
+    // Second pass: store the characters
+    uint32_t index = 0;
+    for (size_t pos = 0; pos < size; ) {
+        while (pos + 8 <= size && ascii_word(bytes + pos)) {
+            if (latin1) {
+                memcpy(&str->value[index], bytes + pos, 8);
+            } else {
+                for (int i = 0; i < 8; i++) {
+                    set_utf16(str, index + (uint32_t)i, bytes[pos + (size_t)i]);
+                }
+            }
+            pos += 8;
+            index += 8;
+        }
+        if (pos >= size) {
+            break;
+        }
+        uint32_t c = bytes[pos] < 0x80 ? bytes[pos++] : decode_utf8_char(bytes, size, &pos);
+        if (latin1) {
+            str->value[index++] = (uint8_t)c;
+        } else if (c > 0xFFFF) {
+            c -= 0x10000;
+            set_utf16(str, index++, (uint16_t)(0xD800 | (c >> 10)));
+            set_utf16(str, index++, (uint16_t)(0xDC00 | (c & 0x3FF)));
+        } else {
+            set_utf16(str, index++, (uint16_t)c);
+        }
+    }
+    return str;
+}
+
+// Create a string from NUL-terminated UTF-8 text
+JString* jvm_create_string(JVM* jvm, const char* str) {
+    if (!jvm || !str) {
+        return NULL;
+    }
+    return string_from_utf8(jvm, str, strlen(str));
+}
+
+uint16_t string_char_at(const JString* str, uint32_t index) {
+    return str->coder == STRING_LATIN1 ? str->value[index] : utf16_at(str, index);
+}
+
+static inline size_t string_size(const JString* str) {
+    return str->coder == STRING_LATIN1 ? str->length : 2 * (size_t)str->length;
+}
+
+// String.hashCode, computed once and cached in the string
+int32_t string_hash_code(JString* str) {
+    if (str->hash == 0 && str->length > 0) {
+        str->hash = (int32_t)(str->coder == STRING_LATIN1
+                                  ? string_kernels->hash_latin1(str->value, str->length)
+                                  : string_kernels->hash_utf16(str->value, str->length));
+    }
+    return str->hash;
+}
+
+// Strings use UTF-16 only when some character needs it, so equal strings
+// have the same coder and bytes
+bool string_equals(const JString* a, const JString* b) {
+    if (a == b) {
+        return true;
+    }
+    if (a->length != b->length || a->coder != b->coder) {
+        return false;
+    }
+    size_t size = string_size(a);
+    return string_kernels->mismatch(a->value, b->value, size) == size;
+}
+
+// String.compareTo: the difference of the first differing characters, or
+// of the lengths when one string is a prefix of the other
+int32_t string_compare(const JString* a, const JString* b) {
+    uint32_t length = a->length < b->length ? a->length : b->length;
+    uint32_t index = 0;
+    if (a->coder == b->coder) {
+        size_t width = a->coder == STRING_LATIN1 ? 1 : 2;
+        index = (uint32_t)(string_kernels->mismatch(a->value, b->value, width * length) / width);
+    } else {
+        while (index < length && string_char_at(a, index) == string_char_at(b, index)) {
+            index++;
+        }
+    }
+    if (index < length) {
+        return (int32_t)string_char_at(a, index) - (int32_t)string_char_at(b, index);
+    }
+    return (int32_t)a->length - (int32_t)b->length;
+}
+
+// Whether other occurs in str at offset
+bool string_region_matches(const JString* str, uint32_t offset, const JString* other) {
+    if (offset > str->length || other->length > str->length - offset) {
+        return false;
+    }
+    if (str->coder == other->coder) {
+        size_t width = str->coder == STRING_LATIN1 ? 1 : 2;
+        size_t size = string_size(other);
+        return string_kernels->mismatch(str->value + width * offset, other->value, size) == size;
+    }
+    for (uint32_t i = 0; i < other->length; i++) {
+        if (string_char_at(str, offset + i) != string_char_at(other, i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Index of the first UTF-16 code unit c at or after from, or -1
+static int32_t find_char(const JString* str, uint16_t c, uint32_t from) {
+    if (from >= str->length) {
+        return -1;
+    }
+    size_t index;
+    if (str->coder == STRING_LATIN1) {
+        if (c > 0xFF) {
+            return -1;
+        }
+        index = string_kernels->find_latin1(str->value + from, str->length - from, (uint8_t)c);
+    } else {
+        index = string_kernels->find_utf16(str->value + 2 * (size_t)from, str->length - from, c);
+    }
+    return index < str->length - from ? (int32_t)(from + index) : -1;
+}
+
+// String.indexOf(int): supplementary characters are found as their
+// surrogate pair
+int32_t string_index_of_char(const JString* str, int32_t ch, uint32_t from) {
+    if (ch < 0 || ch > 0x10FFFF) {
+        return -1;
+    }
+    if (ch <= 0xFFFF) {
+        return find_char(str, (uint16_t)ch, from);
+    }
+    uint16_t high = (uint16_t)(0xD800 | ((ch - 0x10000) >> 10));
+    uint16_t low = (uint16_t)(0xDC00 | ((ch - 0x10000) & 0x3FF));
+    for (int32_t i = find_char(str, high, from); i >= 0; i = find_char(str, high, (uint32_t)i + 1)) {
+        if ((uint32_t)i + 1 < str->length && string_char_at(str, (uint32_t)i + 1) == low) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// String.indexOf(String): candidates are found by their first character,
+// then compared whole
+int32_t string_index_of(const JString* str, const JString* target) {
+    if (target->length == 0) {
+        return 0;
+    }
+    uint16_t first = string_char_at(target, 0);
+    for (int32_t i = find_char(str, first, 0); i >= 0; i = find_char(str, first, (uint32_t)i + 1)) {
+        if (target->length > str->length - (uint32_t)i) {
+            return -1;
+        }
+        if (string_region_matches(str, (uint32_t)i, target)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+JString* string_concat(JVM* jvm, const JString* a, const JString* b) {
+    uint8_t coder = (a->coder == STRING_LATIN1 && b->coder == STRING_LATIN1) ? STRING_LATIN1
+                                                                              : STRING_UTF16;
+    JString* str = string_new(jvm, a->length + b->length, coder);
+    if (!str) {
+        return NULL;
+    }
+    if (coder == STRING_LATIN1) {
+        memcpy(str->value, a->value, a->length);
+        memcpy(str->value + a->length, b->value, b->length);
+        return str;
+    }
+    for (uint32_t i = 0; i < a->length; i++) {
+        set_utf16(str, i, string_char_at(a, i));
+    }
+    for (uint32_t i = 0; i < b->length; i++) {
+        set_utf16(str, a->length + i, string_char_at(b, i));
+    }
+    return str;
+}
+
+// Write the string as UTF-8, passing ASCII runs through unchanged
+void string_write_utf8(const JString* str, FILE* out) {
+    uint32_t i = 0;
+    while (i < str->length) {
+        if (str->coder == STRING_LATIN1) {
+            uint32_t run = i;
+            while (run < str->length && str->value[run] < 0x80) {
+                run++;
+            }
+            fwrite(&str->value[i], 1, run - i, out);
+            i = run;
+            if (i == str->length) {
+                break;
+            }
+        }
+
+        uint32_t c = string_char_at(str, i++);
+        if (c >= 0xD800 && c < 0xDC00 && i < str->length) {
+            uint16_t low = string_char_at(str, i);
+            if (low >= 0xDC00 && low < 0xE000) {
+                c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                i++;
+            }
+        }
+        if (c < 0x80) {
+            fputc((int)c, out);
+        } else if (c < 0x800) {
+            fputc((int)(0xC0 | (c >> 6)), out);
+            fputc((int)(0x80 | (c & 0x3F)), out);
+        } else if (c < 0x10000) {
+            fputc((int)(0xE0 | (c >> 12)), out);
+            fputc((int)(0x80 | ((c >> 6) & 0x3F)), out);
+            fputc((int)(0x80 | (c & 0x3F)), out);
+        } else {
+            fputc((int)(0xF0 | (c >> 18)), out);
+            fputc((int)(0x80 | ((c >> 12) & 0x3F)), out);
+            fputc((int)(0x80 | ((c >> 6) & 0x3F)), out);
+            fputc((int)(0x80 | (c & 0x3F)), out);
+        }
+    }
+}
+
+// Print string to output
+void jvm_print_string(JVM* jvm, JString* str) {
+    if (!jvm || !str) {
+        return;
+    }
+
+    string_write_utf8(str, jvm->out);
+    fflush(jvm->out);
+}
+
+// Double the intern table, or create it, rehashing the stored strings
+static int grow_intern_table(InternTable* table) {
+    size_t capacity = table->capacity ? table->capacity * 2 : INTERN_TABLE_INITIAL_CAPACITY;
+    InternEntry* entries = calloc(capacity, sizeof(InternEntry));
+    if (!entries) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < table->capacity; i++) {
+        InternEntry* entry = &table->entries[i];
+        if (!entry->string) {
+            continue;
+        }
+        size_t slot = (uint32_t)entry->hash & (capacity - 1);
+        while (entries[slot].string) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        entries[slot] = *entry;
+    }
+    free(table->entries);
+    table->entries = entries;
+    table->capacity = capacity;
+    return 0;
+}
+
+// Interned string equal to str, or NULL
+static JString* intern_table_find(const InternTable* table, const JString* str, int32_t hash) {
+    if (table->count == 0) {
+        return NULL;
+    }
+    size_t slot = (uint32_t)hash & (table->capacity - 1);
+    while (table->entries[slot].string) {
+        const InternEntry* entry = &table->entries[slot];
+        if (entry->hash == hash && string_equals(entry->string, str)) {
+            return entry->string;
+        }
+        slot = (slot + 1) & (table->capacity - 1);
+    }
+    return NULL;
+}
+
+// String.intern: the canonical string equal to str, which becomes the
+// canonical one if there is none yet. The string constants of the
+// runtime's classes come first; the runtime's table is only read here, so
+// instances on other threads can intern at the same time. The threads of
+// an instance share its table under the main thread's lock.
+JString* jvm_intern_string(JVM* jvm, JString* str) {
+    if (!jvm || !str) {
+        return NULL;
+    }
+
+    int32_t hash = string_hash_code(str);
+    const InternTable* constants = &jvm->runtime->loader.intern_table;
+    JString* canonical = intern_table_find(constants, str, hash);
+    if (canonical) {
+        return canonical;
+    }
+
+    JVM* main = jvm->main;
+    InternTable* table = &main->intern_table;
+    pthread_mutex_lock(&main->lock);
+    canonical = table != constants ? intern_table_find(table, str, hash) : NULL;
+    if (!canonical && ((table->count + 1) * 2 <= table->capacity || grow_intern_table(table) == 0)) {
+        size_t slot = (uint32_t)hash & (table->capacity - 1);
+        while (table->entries[slot].string) {
+            slot = (slot + 1) & (table->capacity - 1);
+        }
+        table->entries[slot].hash = hash;
+        table->entries[slot].string = str;
+        table->count++;
+        canonical = str;
+    }
+    pthread_mutex_unlock(&main->lock);
+    return canonical;
+}
+
+// Smallest buffer a StringBuilder allocates, in characters
+#define BUILDER_INITIAL_CAPACITY 16
+
+JStringBuilder* builder_new(JVM* jvm) {
+    JStringBuilder* builder =
+        (JStringBuilder*)jvm_alloc_object(jvm, "java/lang/StringBuilder", sizeof(JStringBuilder));
+    if (!builder) {
+        return NULL;
+    }
+    builder->header.kind = OBJECT_STRING_BUILDER;
+    builder->coder = STRING_LATIN1;
+    return builder;
+}
+
+// Make room for extra more characters in the given coder, doubling the
+// buffer so appends are amortized constant time. A Latin-1 buffer is
+// widened to UTF-16 the first time a character outside Latin-1 arrives.
+static int builder_reserve(JStringBuilder* builder, uint32_t extra, uint8_t coder) {
+    if (extra > INT32_MAX - builder->length) {
+        return -1;
+    }
+    uint32_t needed = builder->length + extra;
+    bool widen = coder == STRING_UTF16 && builder->coder == STRING_LATIN1;
+    if (needed <= builder->capacity && !widen) {
+        return 0;
+    }
+
+    uint32_t capacity = builder->capacity;
+    if (needed > capacity) {
+        capacity = capacity > needed / 2 ? 2 * capacity : needed;
+        if (capacity < BUILDER_INITIAL_CAPACITY) {
+            capacity = BUILDER_INITIAL_CAPACITY;
+        }
+    }
+    if (!widen) {
+        size_t width = builder->coder == STRING_LATIN1 ? 1 : 2;
+        uint8_t* value = realloc(builder->value, width * capacity);
+        if (!value) {
+            return -1;
+        }
+        builder->value = value;
+        builder->capacity = capacity;
+        return 0;
+    }
+
+    uint8_t* value = malloc(2 * (size_t)capacity);
+    if (!value) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < builder->length; i++) {
+        uint16_t c = builder->value[i];
+        memcpy(&value[2 * (size_t)i], &c, sizeof(c));
+    }
+    free(builder->value);
+    builder->value = value;
+    builder->capacity = capacity;
+    builder->coder = STRING_UTF16;
+    return 0;
+}
+
+// Append Latin-1 characters, such as formatted numbers
+int builder_append_latin1(JStringBuilder* builder, const char* chars, uint32_t count) {
+    if (count == 0) {
+        return 0;
+    }
+    if (builder_reserve(builder, count, STRING_LATIN1) != 0) {
+        return -1;
+    }
+    if (builder->coder == STRING_LATIN1) {
+        memcpy(builder->value + builder->length, chars, count);
+    } else {
+        for (uint32_t i = 0; i < count; i++) {
+            uint16_t c = (uint8_t)chars[i];
+            memcpy(&builder->value[2 * ((size_t)builder->length + i)], &c, sizeof(c));
+        }
+    }
+    builder->length += count;
+    return 0;
+}
+
+int builder_append_char(JStringBuilder* builder, uint16_t c) {
+    if (builder_reserve(builder, 1, c > 0xFF ? STRING_UTF16 : STRING_LATIN1) != 0) {
+        return -1;
+    }
+    if (builder->coder == STRING_LATIN1) {
+        builder->value[builder->length] = (uint8_t)c;
+    } else {
+        memcpy(&builder->value[2 * (size_t)builder->length], &c, sizeof(c));
+    }
+    builder->length++;
+    return 0;
+}
+
+// Append characters stored with the given coder; value must not point
+// into the builder's own buffer, which may move
+static int builder_append_chars(JStringBuilder* builder, const uint8_t* value, uint32_t length,
+                                uint8_t coder) {
+    if (coder == STRING_LATIN1) {
+        return builder_append_latin1(builder, (const char*)value, length);
+    }
+    if (builder_reserve(builder, length, STRING_UTF16) != 0) {
+        return -1;
+    }
+    memcpy(&builder->value[2 * (size_t)builder->length], value, 2 * (size_t)length);
+    builder->length += length;
+    return 0;
+}
+
+int builder_append_string(JStringBuilder* builder, const JString* str) {
+    return builder_append_chars(builder, str->value, str->length, str->coder);
+}
+
+static int builder_append_class_name(JStringBuilder* builder, const char* class_name) {
+    for (const char* p = class_name; *p; p++) {
+        if (builder_append_char(builder, *p == '/' ? '.' : (uint8_t)*p) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Append an object as String.valueOf(Object) formats it
+int builder_append_object(JStringBuilder* builder, const JObject* object) {
+    if (!object) {
+        return builder_append_latin1(builder, "null", 4);
+    }
+    switch (object->kind) {
+    case OBJECT_STRING:
+        return builder_append_string(builder, (const JString*)object);
+    case OBJECT_STRING_BUILDER: {
+        const JStringBuilder* source = (const JStringBuilder*)object;
+        if (source != builder) {
+            return builder_append_chars(builder, source->value, source->length, source->coder);
+        }
+        uint32_t length = builder->length;
+        if (builder_reserve(builder, length, builder->coder) != 0) {
+            return -1;
+        }
+        size_t size = (builder->coder == STRING_LATIN1 ? 1 : 2) * (size_t)length;
+        memcpy(builder->value + size, builder->value, size);
+        builder->length += length;
+        return 0;
+    }
+    case OBJECT_THROWABLE: {
+        // Throwable.toString: the class name and the message, if any
+        const JThrowable* throwable = (const JThrowable*)object;
+        if (builder_append_class_name(builder, object->class_name) != 0) {
+            return -1;
+        }
+        if (!throwable->message && !throwable->detail) {
+            return 0;
+        }
+        if (builder_append_latin1(builder, ": ", 2) != 0) {
+            return -1;
+        }
+        if (throwable->message) {
+            return builder_append_string(builder, throwable->message);
+        }
+        return builder_append_latin1(builder, throwable->detail, (uint32_t)strlen(throwable->detail));
+    }
+    case OBJECT_BOX: {
+        const JBox* box = (const JBox*)object;
+        if (box->type == 'C') {
+            return builder_append_char(builder, (uint16_t)box->value.i);
+        }
+        char buffer[40];
+        int length = box_format(box, buffer, sizeof(buffer));
+        return builder_append_latin1(builder, buffer, (uint32_t)length);
+    }
+    case OBJECT_ARRAY_LIST: {
+        // AbstractCollection.toString: [a, b, c]
+        const JArrayList* list = (const JArrayList*)object;
+        if (builder_append_char(builder, '[') != 0) {
+            return -1;
+        }
+        for (uint32_t i = 0; i < list->size; i++) {
+            const JObject* element = list->elements[i];
+            if ((i > 0 && builder_append_latin1(builder, ", ", 2) != 0) ||
+                (element == object ? builder_append_latin1(builder, "(this Collection)", 17)
+                                   : builder_append_object(builder, element)) != 0) {
+                return -1;
+            }
+        }
+        return builder_append_char(builder, ']');
+    }
+    case OBJECT_HASH_MAP: {
+        // AbstractMap.toString: {k=v, ...}, in table order
+        const JHashMap* map = (const JHashMap*)object;
+        bool first = true;
+        if (builder_append_char(builder, '{') != 0) {
+            return -1;
+        }
+        for (uint32_t i = 0; i < map->capacity; i++) {
+            // Control bytes of full slots are below 0x80
+            if (map->control[i] & 0x80) {
+                continue;
+            }
+            const MapSlot* slot = &map->slots[i];
+            if ((!first && builder_append_latin1(builder, ", ", 2) != 0) ||
+                builder_append_object(builder, slot->key) != 0 ||
+                builder_append_char(builder, '=') != 0 ||
+                builder_append_object(builder, slot->value) != 0) {
+                return -1;
+            }
+            first = false;
+        }
+        return builder_append_char(builder, '}');
+    }
+    case OBJECT_ATOMIC: {
+        // The current value, as get() reads it
+        const JAtomic* atomic = (const JAtomic*)object;
+        if (atomic->type == 'L') {
+            return builder_append_object(builder, __atomic_load_n(&atomic->value.ref, __ATOMIC_SEQ_CST));
+        }
+        char buffer[24];
+        int length = atomic->type == 'J'
+            ? snprintf(buffer, sizeof(buffer), "%lld",
+                       (long long)__atomic_load_n(&atomic->value.l, __ATOMIC_SEQ_CST))
+            : snprintf(buffer, sizeof(buffer), "%d", (int)__atomic_load_n(&atomic->value.i, __ATOMIC_SEQ_CST));
+        return builder_append_latin1(builder, buffer, (uint32_t)length);
+    }
+    default: {
+        // Object.toString: the class name and an identity hash
+        char buffer[16];
+        int length = snprintf(buffer, sizeof(buffer), "@%x", (unsigned)((uintptr_t)object >> 4));
+        if (builder_append_class_name(builder, object->class_name) != 0) {
+            return -1;
+        }
+        return builder_append_latin1(builder, buffer, (uint32_t)length);
+    }
+    }
+}
+
+// StringBuilder.toString: a single copy of the buffer. Characters are only
+// ever appended, so a UTF-16 buffer always holds one outside Latin-1 and
+// the copy keeps the coder.
+JString* builder_to_string(JVM* jvm, const JStringBuilder* builder) {
+    JString* str = string_new(jvm, builder->length, builder->coder);
+    if (!str) {
+        return NULL;
+    }
+    if (builder->length > 0) {
+        memcpy(str->value, builder->value, string_size(str));
+    }
+    return str;
+}
+
+// Object.toString of a builtin object, formatted as string concatenation
+// formats it
+JString* object_to_string(JVM* jvm, const JObject* object) {
+    JStringBuilder text;
+    memset(&text, 0, sizeof(text));
+    JString* str = builder_append_object(&text, object) == 0 ? builder_to_string(jvm, &text) : NULL;
+    free(text.value);
+    return str;
+}
+
+// String natives; searching, comparison and hashing run on the string
+// kernels selected for the CPU
+
+static int native_string_length(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)jvm;
+    (void)frame;
+    result->i = (jint)((JString*)args[0].ref)->length;
+    return 0;
+}
+
+static int native_string_char_at(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    JString* str = (JString*)args[0].ref;
+    jint index = args[1].i;
+    if (index < 0 || (uint32_t)index >= str->length) {
+        return jvm_throw_new(jvm, frame, "java/lang/StringIndexOutOfBoundsException", NULL);
+    }
+    result->i = string_char_at(str, (uint32_t)index);
+    return 0;
+}
+
+static int native_string_hash_code(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)jvm;
+    (void)frame;
+    result->i = string_hash_code((JString*)args[0].ref);
+    return 0;
+}
+
+static int native_string_equals(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)jvm;
+    (void)frame;
+    const JString* other = (const JString*)args[1].ref;
+    // Only strings are modelled, so any other object is unequal
+    bool is_string = other && strcmp(other->header.class_name, "java/lang/String") == 0;
+    result->i = is_string && string_equals((const JString*)args[0].ref, other);
+    return 0;
+}
+
+static int native_string_compare_to(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    const JString* other = (const JString*)args[1].ref;
+    if (!other) {
+        return jvm_throw_new(jvm, frame, "java/lang/NullPointerException", NULL);
+    }
+    result->i = string_compare((const JString*)args[0].ref, other);
+    return 0;
+}
+
+static int native_string_starts_with(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    const JString* prefix = (const JString*)args[1].ref;
+    if (!prefix) {
+        return jvm_throw_new(jvm, frame, "java/lang/NullPointerException", NULL);
+    }
+    result->i = string_region_matches((const JString*)args[0].ref, 0, prefix);
+    return 0;
+}
+
+static int native_string_index_of_char(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)jvm;
+    (void)frame;
+    result->i = string_index_of_char((const JString*)args[0].ref, args[1].i, 0);
+    return 0;
+}
+
+static int native_string_index_of(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    const JString* target = (const JString*)args[1].ref;
+    if (!target) {
+        return jvm_throw_new(jvm, frame, "java/lang/NullPointerException", NULL);
+    }
+    result->i = string_index_of((const JString*)args[0].ref, target);
+    return 0;
+}
+
+// contains takes any CharSequence; a StringBuilder searches its contents
+static int native_string_contains(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    const JObject* other = (const JObject*)args[1].ref;
+    if (!other) {
+        return jvm_throw_new(jvm, frame, "java/lang/NullPointerException", NULL);
+    }
+    const JString* target = (const JString*)other;
+    if (other->kind == OBJECT_STRING_BUILDER &&
+        !(target = builder_to_string(jvm, (const JStringBuilder*)other))) {
+        return -1;
+    }
+    result->i = string_index_of((const JString*)args[0].ref, target) >= 0;
+    return 0;
+}
+
+static int native_string_intern(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)frame;
+    result->ref = jvm_intern_string(jvm, (JString*)args[0].ref);
+    return result->ref ? 0 : -1;
+}
+
+void register_string_native_methods(Runtime* runtime) {
+    runtime_register_native_method(runtime, "java/lang/String", "length", "()I", native_string_length);
+    runtime_register_native_method(runtime, "java/lang/String", "charAt", "(I)C", native_string_char_at);
+    runtime_register_native_method(runtime, "java/lang/String", "hashCode", "()I", native_string_hash_code);
+    runtime_register_native_method(runtime, "java/lang/String", "equals", "(Ljava/lang/Object;)Z",
+                                   native_string_equals);
+    runtime_register_native_method(runtime, "java/lang/String", "compareTo", "(Ljava/lang/String;)I",
+                                   native_string_compare_to);
+    runtime_register_native_method(runtime, "java/lang/String", "startsWith", "(Ljava/lang/String;)Z",
+                                   native_string_starts_with);
+    runtime_register_native_method(runtime, "java/lang/String", "indexOf", "(I)I",
+                                   native_string_index_of_char);
+    runtime_register_native_method(runtime, "java/lang/String", "indexOf", "(Ljava/lang/String;)I",
+                                   native_string_index_of);
+    runtime_register_native_method(runtime, "java/lang/String", "contains", "(Ljava/lang/CharSequence;)Z",
+                                   native_string_contains);
+    runtime_register_native_method(runtime, "java/lang/String", "intern", "()Ljava/lang/String;",
+                                   native_string_intern);
+}
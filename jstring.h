@@ -0,0 +1,29 @@
+// jstring.h - java.lang.String objects and the intern table
+#ifndef JSTRING_H
+#define JSTRING_H
+
+#include "jvm.h"
+#include <stdio.h>
+
+// Public API functions
+JString* string_new(JVM* jvm, uint32_t length, uint8_t coder);
+JString* string_from_utf8(JVM* jvm, const char* bytes, size_t size);
+uint16_t string_char_at(const JString* str, uint32_t index);
+int32_t string_hash_code(JString* str);
+bool string_equals(const JString* a, const JString* b);
+int32_t string_compare(const JString* a, const JString* b);
+bool string_region_matches(const JString* str, uint32_t offset, const JString* other);
+int32_t string_index_of_char(const JString* str, int32_t ch, uint32_t from);
+int32_t string_index_of(const JString* str, const JString* target);
+JString* string_concat(JVM* jvm, const JString* a, const JString* b);
+void string_write_utf8(const JString* str, FILE* out);
+JStringBuilder* builder_new(JVM* jvm);
+int builder_append_latin1(JStringBuilder* builder, const char* chars, uint32_t count);
+int builder_append_char(JStringBuilder* builder, uint16_t c);
+int builder_append_string(JStringBuilder* builder, const JString* str);
+int builder_append_object(JStringBuilder* builder, const JObject* object);
+JString* builder_to_string(JVM* jvm, const JStringBuilder* builder);
+JString* object_to_string(JVM* jvm, const JObject* object);
+void register_string_native_methods(Runtime* runtime);
+
+#endif // JSTRING_H
@@ -1,19 +1,59 @@
 #include "jvm.h"
 #include "class_loader.h"
+#include "bytecode.h"
+#include "optimizer.h"
+#include "verifier.h"
+#include "exceptions.h"
+#include "jstring.h"
+#include "string_kernels.h"
+#include "call_sites.h"
+#include "boxes.h"
+#include "collections.h"
+#include "native_libraries.h"
+#include "threads.h"
+#include "monitors.h"
+#include "atomics.h"
+#include "heap.h"
+#include "safepoints.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 static int execute_bytecode(JVM* jvm, Frame* frame);
+static int execute_invokeinterface(JVM* jvm, Frame* frame, uint16_t method_index);
+static int execute_atomic(JVM* jvm, Frame* frame, uint16_t opcode);
 
-// Initialize JVM
-int jvm_init(JVM* jvm) {
-    if (!jvm) {
+// Initialize a JVM instance running the classes of a runtime, with the
+// process's standard streams as System.out, System.in and System.err
+int jvm_init(JVM* jvm, const Runtime* runtime) {
+    if (!jvm || !runtime) {
         return -1;
     }
     
     memset(jvm, 0, sizeof(JVM));
-    jvm->heap_used = 0;
+    jvm->runtime = runtime;
+    jvm->main = jvm;
+    jvm->backedge_budget = BACKEDGES_PER_YIELD;
+    jvm->lock_owner = lock_owner_new();
+    heap_init(&jvm->heap);
+    pthread_mutex_init(&jvm->lock, NULL);
+    pthread_cond_init(&jvm->thread_ended, NULL);
+    jvm->out = stdout;
+    jvm->in = stdin;
+    jvm->err = stderr;
+    jvm->stack_memory = calloc(MAX_STACK_SIZE, sizeof(jvalue));
+    jvm->locals_memory = calloc(MAX_LOCALS_SIZE, sizeof(jvalue));
+    if (!jvm->stack_memory || !jvm->locals_memory || box_cache_init(jvm) != 0) {
+        jvm_destroy(jvm);
+        return -1;
+    }
+    jvm->system_out = jvm_alloc_object(jvm, "java/io/PrintStream", sizeof(JObject));
+    jvm->system_in = jvm_alloc_object(jvm, "java/io/InputStream", sizeof(JObject));
+    jvm->system_err = jvm_alloc_object(jvm, "java/io/PrintStream", sizeof(JObject));
+    if (!jvm->system_out || !jvm->system_in || !jvm->system_err) {
+        jvm_destroy(jvm);
+        return -1;
+    }
     return 0;
 }
 
@@ -23,50 +63,184 @@ void jvm_destroy(JVM* jvm) {
         return;
     }
     
-    if (jvm->native_methods) {
-        free(jvm->native_methods);
+    jvm_wait_for_threads(jvm);
+    for (uint16_t i = 0; i < MAX_CLASSES; i++) {
+        free(jvm->library_bindings[i]);
     }
+    jvm_unload_libraries(jvm);
+    
+    // Interned strings are heap objects, freed with the rest below
+    free(jvm->intern_table.entries);
+    box_cache_free(jvm);
+    free(jvm->stack_memory);
+    free(jvm->locals_memory);
     
-    for (size_t i = 0; i < jvm->string_pool.count; i++) {
-        if (jvm->string_pool.strings[i].data) {
-            free(jvm->string_pool.strings[i].data);
+    while (jvm->objects) {
+        JObject* object = jvm->objects;
+        jvm->objects = object->next;
+        if (object->kind == OBJECT_THROWABLE) {
+            free(((JThrowable*)object)->backtrace);
+        } else if (object->kind == OBJECT_STRING_BUILDER) {
+            free(((JStringBuilder*)object)->value);
+        } else if (object->kind == OBJECT_ARRAY_LIST) {
+            free(((JArrayList*)object)->elements);
+        } else if (object->kind == OBJECT_HASH_MAP) {
+            free(((JHashMap*)object)->control);
+            free(((JHashMap*)object)->slots);
         }
+        monitor_free(object);
     }
+    heap_destroy(&jvm->heap);
     
+    pthread_cond_destroy(&jvm->thread_ended);
+    pthread_mutex_destroy(&jvm->lock);
     memset(jvm, 0, sizeof(JVM));
 }
 
-// Load class into JVM
-int jvm_load_class(JVM* jvm, const ClassInfo* class_info) {
-    if (!jvm || !class_info) {
+// Initialize an empty runtime; natives are registered and classes loaded
+// into it before any instance runs
+int runtime_init(Runtime* runtime) {
+    if (!runtime) {
+        return -1;
+    }
+    
+    memset(runtime, 0, sizeof(Runtime));
+    string_kernels_init();
+    runtime->scheduler = scheduler_new();
+    if (!runtime->scheduler) {
+        return -1;
+    }
+    if (jvm_init(&runtime->loader, runtime) != 0) {
+        scheduler_destroy(runtime->scheduler);
+        return -1;
+    }
+    return 0;
+}
+
+// Destroy a runtime once none of its instances runs; this stops the
+// workers of the thread scheduler
+void runtime_destroy(Runtime* runtime) {
+    if (!runtime) {
+        return;
+    }
+    
+    if (runtime->native_methods) {
+        // Each entry's key strings are one block, starting at its class name
+        for (size_t i = 0; i < runtime->native_methods_capacity; i++) {
+            free((void*)runtime->native_methods[i].class_name);
+        }
+        free(runtime->native_methods);
+    }
+    jvm_destroy(&runtime->loader);
+    scheduler_destroy(runtime->scheduler);
+    
+    memset(runtime, 0, sizeof(Runtime));
+}
+
+// Allocate a zeroed object from the thread's allocation buffer; objects
+// live until the JVM is destroyed
+JObject* jvm_alloc_object(JVM* jvm, const char* class_name, size_t size) {
+    JObject* object = heap_alloc(jvm, size);
+    if (!object) {
+        return NULL;
+    }
+    object->class_name = class_name;
+    object->next = jvm->objects;
+    jvm->objects = object;
+    return object;
+}
+
+// Resolve each string constant once to its interned string, cached in the
+// constants table so ldc of a string is a plain push
+static int resolve_string_constants(JVM* jvm, ClassInfo* class_info) {
+    if (!class_info->constants) {
+        return 0;
+    }
+    for (uint16_t i = 1; i < class_info->constant_pool_count; i++) {
+        ConstantPoolEntry* entry = &class_info->constant_pool[i];
+        if (entry->tag != CONST_STRING) {
+            continue;
+        }
+        uint16_t utf8_index = entry->class_info.string_index;
+        const char* value = constant_pool_utf8(class_info, utf8_index);
+        JString* str = value ? string_from_utf8(jvm, value,
+                                                class_info->constant_pool[utf8_index].utf8_info.length)
+                             : NULL;
+        class_info->constants[i].ref = str ? jvm_intern_string(jvm, str) : NULL;
+        if (!class_info->constants[i].ref) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Load class into the runtime. Objects the class links to, such as its
+// string constants, belong to the runtime's loader and are shared by all
+// instances.
+int runtime_load_class(Runtime* runtime, const ClassInfo* class_info) {
+    if (!runtime || !class_info) {
+        return -1;
+    }
+    
+    if (runtime->classes_count >= MAX_CLASSES) {
+        return -1;
+    }
+    
+    runtime->classes[runtime->classes_count] = *class_info;
+    ClassInfo* loaded = &runtime->classes[runtime->classes_count];
+    JVM* jvm = &runtime->loader;
+    loaded->class_object = jvm_alloc_object(jvm, "java/lang/Class", sizeof(JObject));
+    if (!loaded->class_object) {
         return -1;
     }
     
-    if (jvm->classes_count >= MAX_CLASSES) {
+    // Link methods: pre-decode all bytecode first so the optimizer can
+    // inline any method of the class, verify it against the original code,
+    // then optimize before execution
+    for (uint16_t i = 0; i < loaded->methods_count; i++) {
+        if (decode_method(&loaded->methods[i]) != 0) {
+            return -1;
+        }
+    }
+    for (uint16_t i = 0; i < loaded->methods_count; i++) {
+        if (verify_method(loaded, &loaded->methods[i]) != 0) {
+            return -1;
+        }
+    }
+    if (resolve_string_constants(jvm, loaded) != 0 || link_call_sites(jvm, loaded) != 0 ||
+        bind_native_methods(runtime, loaded) != 0) {
         return -1;
     }
+    for (uint16_t i = 0; i < loaded->methods_count; i++) {
+        optimize_method(loaded, &loaded->methods[i]);
+    }
+    for (uint16_t i = 0; i < loaded->methods_count; i++) {
+        if (build_exception_ranges(&loaded->methods[i]) != 0) {
+            return -1;
+        }
+    }
     
-    jvm->classes[jvm->classes_count] = *class_info;
-    jvm->classes_count++;
+    runtime->classes_count++;
     return 0;
 }
 
 // Find class by name
-static ClassInfo* find_class(JVM* jvm, const char* name) {
+static const ClassInfo* find_class(JVM* jvm, const char* name) {
     if (!jvm || !name) {
         return NULL;
     }
     
-    for (uint16_t i = 0; i < jvm->classes_count; i++) {
-        if (strcmp(jvm->classes[i].name, name) == 0) {
-            return &jvm->classes[i];
+    const Runtime* runtime = jvm->runtime;
+    for (uint16_t i = 0; i < runtime->classes_count; i++) {
+        if (strcmp(runtime->classes[i].name, name) == 0) {
+            return &runtime->classes[i];
         }
     }
     return NULL;
 }
 
 // Find method in class
-static MethodInfo* find_method(ClassInfo* class_info, const char* method_name) {
+static const MethodInfo* find_method(const ClassInfo* class_info, const char* method_name) {
     if (!class_info || !method_name) {
         return NULL;
     }
@@ -79,1123 +253,1278 @@ static MethodInfo* find_method(ClassInfo* class_info, const char* method_name) {
     return NULL;
 }
 
-// Stack operations - push/pop functions
-static void push_int(Frame* frame, jint value) {
-    if (frame->stack_top < MAX_STACK_SIZE) {
-        frame->operand_stack[frame->stack_top].i = value;
-        frame->stack_top++;
-    }
+// Stack operations - push/pop functions. Unchecked: the verifier has
+// proven that the operand stack stays within [0, max_stack]. Longs and
+// doubles take two slots, with the value in the lower one
+static inline void push_int(Frame* frame, jint value) {
+    frame->operand_stack[frame->stack_top++].i = value;
 }
 
-static jint pop_int(Frame* frame) {
-    if (frame->stack_top > 0) {
-        frame->stack_top--;
-        return frame->operand_stack[frame->stack_top].i;
-    }
-    return 0;
+static inline jint pop_int(Frame* frame) {
+    return frame->operand_stack[--frame->stack_top].i;
 }
 
-static void push_long(Frame* frame, jlong value) {
-    if (frame->stack_top < MAX_STACK_SIZE) {
-        frame->operand_stack[frame->stack_top].l = value;
-        frame->stack_top++;
-    }
+static inline void push_long(Frame* frame, jlong value) {
+    frame->operand_stack[frame->stack_top].l = value;
+    frame->stack_top += 2;
 }
 
-static jlong pop_long(Frame* frame) {
-    if (frame->stack_top > 0) {
-        frame->stack_top--;
-        return frame->operand_stack[frame->stack_top].l;
-    }
-    return 0;
+static inline jlong pop_long(Frame* frame) {
+    frame->stack_top -= 2;
+    return frame->operand_stack[frame->stack_top].l;
 }
 
-static void push_float(Frame* frame, jfloat value) {
-    if (frame->stack_top < MAX_STACK_SIZE) {
-        frame->operand_stack[frame->stack_top].f = value;
-        frame->stack_top++;
-    }
+static inline void push_float(Frame* frame, jfloat value) {
+    frame->operand_stack[frame->stack_top++].f = value;
+}
+
+static inline jfloat pop_float(Frame* frame) {
+    return frame->operand_stack[--frame->stack_top].f;
+}
+
+static inline void push_double(Frame* frame, jdouble value) {
+    frame->operand_stack[frame->stack_top].d = value;
+    frame->stack_top += 2;
+}
+
+static inline jdouble pop_double(Frame* frame) {
+    frame->stack_top -= 2;
+    return frame->operand_stack[frame->stack_top].d;
+}
+
+static inline void push_ref(Frame* frame, void* ref) {
+    frame->operand_stack[frame->stack_top++].ref = ref;
+}
+
+static inline void* pop_ref(Frame* frame) {
+    return frame->operand_stack[--frame->stack_top].ref;
+}
+
+// Duplicate the top count slots and insert the copy below the next depth slots
+static void dup_slots(Frame* frame, int count, int depth) {
+    jvalue* insert = &frame->operand_stack[frame->stack_top - count - depth];
+    jvalue top[2];
+    memcpy(top, &frame->operand_stack[frame->stack_top - count], count * sizeof(jvalue));
+    memmove(insert + count, insert, (count + depth) * sizeof(jvalue));
+    memcpy(insert, top, count * sizeof(jvalue));
+    frame->stack_top += count;
 }
 
-static jfloat pop_float(Frame* frame) {
-    if (frame->stack_top > 0) {
-        frame->stack_top--;
-        return frame->operand_stack[frame->stack_top].f;
+// Find method in class by name and descriptor
+static const MethodInfo* find_method_by_descriptor(const ClassInfo* class_info, const char* name,
+                                                   const char* descriptor) {
+    for (uint16_t i = 0; i < class_info->methods_count; i++) {
+        const MethodInfo* method = &class_info->methods[i];
+        if (strcmp(method->name, name) == 0 && strcmp(method->descriptor, descriptor) == 0) {
+            return method;
+        }
     }
-    return 0.0f;
+    return NULL;
 }
 
-static void push_double(Frame* frame, jdouble value) {
-    if (frame->stack_top < MAX_STACK_SIZE) {
-        frame->operand_stack[frame->stack_top].d = value;
-        frame->stack_top++;
+// Set up a callee frame directly above the caller's locals and operand
+// stack; the verifier bounds each frame by max_locals and max_stack
+static int push_frame(JVM* jvm, Frame* caller, Frame* callee,
+                      const ClassInfo* class_info, const MethodInfo* method) {
+    memset(callee, 0, sizeof(Frame));
+    callee->locals = caller->locals + caller->method->max_locals;
+    callee->operand_stack = caller->operand_stack + caller->method->max_stack;
+    if (callee->locals + method->max_locals > jvm->locals_memory + MAX_LOCALS_SIZE ||
+        callee->operand_stack + method->max_stack > jvm->stack_memory + MAX_STACK_SIZE) {
+        return jvm_throw_new(jvm, caller, "java/lang/StackOverflowError", NULL);
     }
+    callee->caller = caller;
+    callee->stack_top = 0;
+    callee->pc = method->instructions;
+    callee->method = method;
+    callee->class_info = class_info;
+    return 0;
 }
 
-static jdouble pop_double(Frame* frame) {
-    if (frame->stack_top > 0) {
-        frame->stack_top--;
-        return frame->operand_stack[frame->stack_top].d;
+// Number of local variable slots taken by the arguments of a descriptor
+static int argument_slots(const char* descriptor) {
+    char arg_types[256];
+    int arg_count = parse_method_descriptor(descriptor, arg_types, sizeof(arg_types));
+    if (arg_count < 0) {
+        return -1;
     }
-    return 0.0;
+    
+    int slots = 0;
+    for (int i = 0; i < arg_count; i++) {
+        slots += (arg_types[i] == 'J' || arg_types[i] == 'D') ? 2 : 1;
+    }
+    return slots;
 }
 
-static void push_ref(Frame* frame, void* ref) {
-    if (frame->stack_top < MAX_STACK_SIZE) {
-        frame->operand_stack[frame->stack_top].ref = ref;
-        frame->stack_top++;
+// Push a method result in as many slots as its descriptor type takes
+static void push_return_value(Frame* frame, const char* descriptor, jvalue value) {
+    char type = descriptor_return_type(descriptor);
+    if (type == 'V') {
+        return;
     }
+    frame->operand_stack[frame->stack_top] = value;
+    frame->stack_top += (type == 'J' || type == 'D') ? 2 : 1;
 }
 
-static void* pop_ref(Frame* frame) {
-    if (frame->stack_top > 0) {
-        frame->stack_top--;
-        return frame->operand_stack[frame->stack_top].ref;
+// Invoke a bytecode method: arguments (and the receiver of instance
+// methods) move from the caller's operand stack into the callee's locals
+static int invoke_method(JVM* jvm, Frame* frame, const ClassInfo* class_info,
+                         const MethodInfo* method) {
+    int slots = argument_slots(method->descriptor);
+    if (slots < 0 || !method->instructions) {
+        return -1;
     }
-    return NULL;
+    
+    Frame new_frame;
+    int status = push_frame(jvm, frame, &new_frame, class_info, method);
+    if (status != 0) {
+        return status;
+    }
+    
+    slots += (method->access_flags & ACC_STATIC) ? 0 : 1;
+    frame->stack_top -= slots;
+    memcpy(new_frame.locals, &frame->operand_stack[frame->stack_top], slots * sizeof(jvalue));
+    
+    // A synchronized method holds the lock of its receiver, or of its
+    // class when static, until it returns or throws
+    JObject* lock = NULL;
+    if (method->access_flags & ACC_SYNCHRONIZED) {
+        lock = (method->access_flags & ACC_STATIC) ? class_info->class_object
+                                                   : (JObject*)new_frame.locals[0].ref;
+        status = monitor_enter(jvm, frame, lock);
+        if (status != 0) {
+            return status;
+        }
+    }
+    
+    status = execute_bytecode(jvm, &new_frame);
+    if (lock) {
+        int exit_status = monitor_exit(jvm, frame, lock);
+        if (exit_status != 0) {
+            status = exit_status;
+        }
+    }
+    if (status != 0) {
+        return status;
+    }
+    push_return_value(frame, method->descriptor, new_frame.return_value);
+    return 0;
 }
 
-// Bytecode reading functions
-static uint8_t read_u1(uint8_t** pc) {
-    uint8_t value = **pc;
-    (*pc)++;
-    return value;
+// Discard the arguments of a call the VM does not implement and push a
+// default return value, keeping the operand stack as the verifier expects
+static int skip_invocation(Frame* frame, const char* descriptor, int has_receiver) {
+    int slots = argument_slots(descriptor);
+    if (slots < 0) {
+        return -1;
+    }
+    
+    frame->stack_top -= slots + (has_receiver ? 1 : 0);
+    jvalue zero;
+    memset(&zero, 0, sizeof(jvalue));
+    push_return_value(frame, descriptor, zero);
+    return 0;
 }
 
-static uint16_t read_u2(uint8_t** pc) {
-    uint16_t value = ((*pc)[0] << 8) | (*pc)[1];
-    *pc += 2;
-    return value;
+// Native bound to a member ref at link time, or NULL
+static inline const NativeBinding* native_binding(const ClassInfo* class_info, uint16_t index) {
+    if (!class_info->native_bindings || index >= class_info->constant_pool_count ||
+        (!class_info->native_bindings[index].function && !class_info->native_bindings[index].critical)) {
+        return NULL;
+    }
+    return &class_info->native_bindings[index];
 }
 
-static int16_t read_s2(uint8_t** pc) {
-    int16_t value = ((*pc)[0] << 8) | (*pc)[1];
-    *pc += 2;
-    return value;
+// Call a native with its arguments in place on the caller's operand stack.
+// Bound invokes come here directly; the invoke handlers check for natives
+// reached otherwise, such as the targets of method references.
+static int invoke_native(JVM* jvm, Frame* frame, const NativeBinding* binding, bool has_receiver) {
+    int slots = binding->argument_slots + (has_receiver ? 1 : 0);
+    jvalue* args = &frame->operand_stack[frame->stack_top - slots];
+    if (has_receiver && !args[0].ref) {
+        return jvm_throw_new(jvm, frame, "java/lang/NullPointerException", NULL);
+    }
+    
+    jvalue result;
+    memset(&result, 0, sizeof(jvalue));
+    int status = 0;
+    if (binding->leaves_java) {
+        // A safepoint does not wait for blocking and library natives
+        safepoint_leave_java(jvm);
+    }
+    if (binding->critical) {
+        binding->critical(args, &result);
+    } else {
+        status = binding->function(jvm, frame, args, &result);
+    }
+    if (binding->leaves_java) {
+        safepoint_enter_java(jvm);
+    }
+    if (status != 0) {
+        return status;
+    }
+    frame->stack_top -= slots;
+    frame->operand_stack[frame->stack_top] = result;
+    frame->stack_top += binding->result_slots;
+    return 0;
 }
 
-/*
-    Unused function
-*/
+// Bind a native method of the class to its function in a loaded library
+// on the first call; later calls find it with find_library_native
+static int link_native_method(JVM* jvm, Frame* frame, uint16_t method_index, const MethodInfo* method) {
+    const NativeBinding* binding = bind_library_native(jvm, frame->class_info, method_index, method);
+    if (!binding) {
+        return jvm_throw_new(jvm, frame, "java/lang/UnsatisfiedLinkError", method->name);
+    }
+    return invoke_native(jvm, frame, binding, !(method->access_flags & ACC_STATIC));
+}
 
-/*
-static uint32_t read_u4(uint8_t** pc) {
-    uint32_t value = ((*pc)[0] << 24) | ((*pc)[1] << 16) | ((*pc)[2] << 8) | (*pc)[3];
-    *pc += 4;
-    return value;
+// Box the primitive on top of the stack, as valueOf does
+static int execute_box(JVM* jvm, Frame* frame, char type) {
+    frame->stack_top -= (type == 'J' || type == 'D') ? 2 : 1;
+    JBox* box = box_value(jvm, type, frame->operand_stack[frame->stack_top]);
+    if (!box) {
+        return -1;
+    }
+    push_ref(frame, box);
+    return 0;
 }
-*/
 
+// Replace the box on top of the stack by its value, as xxxValue does
+static int execute_unbox(JVM* jvm, Frame* frame, char type) {
+    JBox* box = (JBox*)pop_ref(frame);
+    if (!box) {
+        return jvm_throw_new(jvm, frame, "java/lang/NullPointerException", NULL);
+    }
+    frame->operand_stack[frame->stack_top] = unbox_value(box, type);
+    frame->stack_top += (type == 'J' || type == 'D') ? 2 : 1;
+    return 0;
+}
 
-// Load string constant
-static int execute_ldc_string(JVM* jvm, Frame* frame, uint16_t string_index) {
-    if (string_index >= frame->class_info->constant_pool_count) {
+// Execute static method invocation
+static int execute_invokestatic(JVM* jvm, Frame* frame, uint16_t method_index) {
+    const NativeBinding* binding = native_binding(frame->class_info, method_index);
+    if (binding) {
+        return invoke_native(jvm, frame, binding, false);
+    }
+    binding = find_library_native(jvm, frame->class_info, method_index);
+    if (binding) {
+        return invoke_native(jvm, frame, binding, false);
+    }
+    
+    const char* class_name;
+    const char* method_name;
+    const char* descriptor;
+    if (constant_pool_member_ref(frame->class_info, method_index,
+                                 &class_name, &method_name, &descriptor) != 0) {
         return -1;
     }
     
-    ConstantPoolEntry* string_entry = &frame->class_info->constant_pool[string_index];
-    if (string_entry->tag == CONST_STRING) {
-        char* str_data = read_utf8_string(frame->class_info, string_entry->class_info.string_index);
-        if (str_data) {
-            JString* jstr = jvm_create_string(jvm, str_data);
-            push_ref(frame, jstr);
-            free(str_data);
-            return 0;
+    // Handle methods of current class
+    if (strcmp(class_name, frame->class_info->name) == 0) {
+        const MethodInfo* target_method = find_method_by_descriptor(frame->class_info, method_name, descriptor);
+        if (target_method && target_method->instructions) {
+            return invoke_method(jvm, frame, frame->class_info, target_method);
+        }
+        if (target_method && (target_method->access_flags & ACC_NATIVE)) {
+            return link_native_method(jvm, frame, method_index, target_method);
         }
     }
-    return -1;
+    
+    // Boxing calls the optimizer did not bind, such as method references
+    char type = box_method_type(class_name, method_name, descriptor);
+    if (type) {
+        return execute_box(jvm, frame, type);
+    }
+    
+    return skip_invocation(frame, descriptor, 0);
 }
 
-// Execute static method invocation
-static int execute_invokestatic(JVM* jvm, Frame* frame) {
-    uint16_t method_index = read_u2(&frame->pc);
-    if (method_index >= frame->class_info->constant_pool_count) {
-        return -1;
+// StringBuilder.append overloads: the argument is formatted straight into
+// the builder's buffer
+static int execute_builder_append(JVM* jvm, Frame* frame, const char* descriptor) {
+    char buffer[40];
+    const char* text = buffer;
+    JObject* object = NULL;
+    jint c = 0;
+    switch (descriptor[1]) {
+    case 'I':
+        snprintf(buffer, sizeof(buffer), "%d", pop_int(frame));
+        break;
+    case 'J':
+        snprintf(buffer, sizeof(buffer), "%lld", (long long)pop_long(frame));
+        break;
+    case 'D':
+        format_double(buffer, sizeof(buffer), pop_double(frame));
+        break;
+    case 'Z':
+        text = pop_int(frame) ? "true" : "false";
+        break;
+    case 'C':
+        c = pop_int(frame);
+        text = NULL;
+        break;
+    case 'L':
+        object = (JObject*)pop_ref(frame);
+        text = NULL;
+        break;
+    default:
+        return skip_invocation(frame, descriptor, 1);
     }
     
-    ConstantPoolEntry* method_ref = &frame->class_info->constant_pool[method_index];
-    if (method_ref->tag != CONST_METHODREF) {
+    JStringBuilder* builder = (JStringBuilder*)pop_ref(frame);
+    if (!builder) {
+        return jvm_throw_new(jvm, frame, "java/lang/NullPointerException", NULL);
+    }
+    int status;
+    if (text) {
+        status = builder_append_latin1(builder, text, (uint32_t)strlen(text));
+    } else if (descriptor[1] == 'C') {
+        status = builder_append_char(builder, (uint16_t)c);
+    } else {
+        status = builder_append_object(builder, object);
+    }
+    if (status != 0) {
         return -1;
     }
+    push_ref(frame, builder);
+    return 0;
+}
+
+// Execute virtual method invocation
+static int execute_invokevirtual(JVM* jvm, Frame* frame, uint16_t method_index) {
+    const NativeBinding* binding = native_binding(frame->class_info, method_index);
+    if (binding) {
+        return invoke_native(jvm, frame, binding, true);
+    }
+    binding = find_library_native(jvm, frame->class_info, method_index);
+    if (binding) {
+        return invoke_native(jvm, frame, binding, true);
+    }
     
-    ConstantPoolEntry* class_entry = &frame->class_info->constant_pool[method_ref->ref_info.class_index];
-    ConstantPoolEntry* name_and_type = &frame->class_info->constant_pool[method_ref->ref_info.name_and_type_index];
-    if (class_entry->tag != CONST_CLASS || name_and_type->tag != 12) {
+    const char* class_name;
+    const char* method_name;
+    const char* descriptor;
+    if (constant_pool_member_ref(frame->class_info, method_index,
+                                 &class_name, &method_name, &descriptor) != 0) {
         return -1;
     }
     
-    char* class_name = read_utf8_string(frame->class_info, class_entry->class_info.string_index);
-    char* method_name = read_utf8_string(frame->class_info, name_and_type->ref_info.class_index);
-    char* descriptor = read_utf8_string(frame->class_info, name_and_type->ref_info.name_and_type_index);
-    
     // Handle methods of current class
-    if (class_name && frame->class_info->name && strstr(class_name, frame->class_info->name)) {
-        MethodInfo* target_method = NULL;
-        for (uint16_t i = 0; i < frame->class_info->methods_count; i++) {
-            if (method_name && frame->class_info->methods[i].name &&
-                strcmp(frame->class_info->methods[i].name, method_name) == 0) {
-                target_method = &frame->class_info->methods[i];
-                break;
+    if (strcmp(class_name, frame->class_info->name) == 0) {
+        const MethodInfo* target_method = find_method_by_descriptor(frame->class_info, method_name, descriptor);
+        if (target_method && !(target_method->access_flags & ACC_STATIC)) {
+            if (target_method->instructions) {
+                return invoke_method(jvm, frame, frame->class_info, target_method);
+            }
+            if (target_method->access_flags & ACC_NATIVE) {
+                return link_native_method(jvm, frame, method_index, target_method);
             }
         }
-        
-        if (target_method && target_method->code) {
-            // Create new frame for method
-            Frame new_frame;
-            memset(&new_frame, 0, sizeof(Frame));
-            new_frame.locals = &frame->locals[256];
-            new_frame.operand_stack = &frame->operand_stack[512];
-            new_frame.stack_top = 0;
-            new_frame.pc = target_method->code;
-            new_frame.method = target_method;
-            new_frame.class_info = frame->class_info;
-            
-            // Pass parameters
-            if (descriptor && strstr(descriptor, "(II)")) {
-                // Method takes two int parameters
-                jint param2 = pop_int(frame);
-                jint param1 = pop_int(frame);
-                new_frame.locals[0].i = param1;
-                new_frame.locals[1].i = param2;
-            } else if (descriptor && strstr(descriptor, "(I)")) {
-                // Method takes one int parameter
-                jint param = pop_int(frame);
-                new_frame.locals[0].i = param;
+    }
+    
+    // Handle Throwable methods
+    if ((strcmp(method_name, "getMessage") == 0 || strcmp(method_name, "printStackTrace") == 0) &&
+        strncmp(descriptor, "()", 2) == 0 && is_throwable_class(jvm, class_name)) {
+        JThrowable* throwable = (JThrowable*)pop_ref(frame);
+        if (!throwable) {
+            return jvm_throw_new(jvm, frame, "java/lang/NullPointerException", NULL);
+        }
+        if (strcmp(method_name, "printStackTrace") == 0) {
+            jvm_print_stack_trace(jvm, throwable);
+            return 0;
+        }
+        if (!throwable->message && throwable->detail) {
+            throwable->message = jvm_create_string(jvm, throwable->detail);
+        }
+        push_ref(frame, throwable->message);
+        return 0;
+    }
+    
+    // Handle wrapper methods; unboxing is normally bound by the optimizer,
+    // but Number methods reach here with any wrapper as the receiver
+    if ((box_class_type(class_name) || strcmp(class_name, "java/lang/Number") == 0) &&
+        descriptor[0] == '(' && descriptor[1] == ')') {
+        JObject* receiver = (JObject*)frame->operand_stack[frame->stack_top - 1].ref;
+        char type = receiver && receiver->kind == OBJECT_BOX
+                        ? unbox_method_type(receiver->class_name, method_name, descriptor)
+                        : 0;
+        if (type) {
+            return execute_unbox(jvm, frame, type);
+        }
+    }
+    if (box_class_type(class_name)) {
+        if (strcmp(method_name, "equals") == 0 || strcmp(method_name, "hashCode") == 0 ||
+            strcmp(method_name, "toString") == 0) {
+            JObject* other = strcmp(method_name, "equals") == 0 ? (JObject*)pop_ref(frame) : NULL;
+            JBox* box = (JBox*)pop_ref(frame);
+            if (!box) {
+                return jvm_throw_new(jvm, frame, "java/lang/NullPointerException", NULL);
+            }
+            if (method_name[0] == 'e') {
+                push_int(frame, box_equals(box, other));
+                return 0;
             }
-            
-            // Execute method
-            int result = execute_bytecode(jvm, &new_frame);
-            
-            // Handle return values
-            if (descriptor && strstr(descriptor, ")I")) {
-                // Returns int
-                jint return_value = 0;
-                if (new_frame.stack_top > 0) {
-                    return_value = new_frame.operand_stack[new_frame.stack_top - 1].i;
-                } else {
-                    return_value = result;
-                }
-                push_int(frame, return_value);
-            } else if (descriptor && strstr(descriptor, ")Ljava/lang/String;")) {
-                // Returns String
-                JString* result_str = NULL;
-                if (method_name && strcmp(method_name, "getGrade") == 0) {
-                    jint score = new_frame.locals[0].i;
-                    if (score >= 90) {
-                        result_str = jvm_create_string(jvm, "A");
-                    } else if (score >= 80) {
-                        result_str = jvm_create_string(jvm, "B");
-                    } else if (score >= 70) {
-                        result_str = jvm_create_string(jvm, "C");
-                    } else {
-                        result_str = jvm_create_string(jvm, "F");
-                    }
-                } else {
-                    result_str = jvm_create_string(jvm, "Unknown");
-                }
-                push_ref(frame, result_str);
+            if (method_name[0] == 'h') {
+                push_int(frame, box_hash_code(box));
+                return 0;
             }
-            
-            if (class_name) free(class_name);
-            if (method_name) free(method_name);
-            if (descriptor) free(descriptor);
+            JString* str = object_to_string(jvm, &box->header);
+            if (!str) {
+                return -1;
+            }
+            push_ref(frame, str);
             return 0;
         }
     }
     
-    // Handle System.out methods
-    if (class_name && strstr(class_name, "System")) {
-        if (method_name && strstr(method_name, "print")) {
-            jvalue args[4];
-            int arg_count = 0;
-            if (descriptor && strstr(descriptor, "(I)")) {
-                arg_count = 1;
-                args[0].i = pop_int(frame);
-                if (strstr(method_name, "println")) {
-                    native_system_out_println_int(jvm, args, arg_count);
-                } else {
-                    native_system_out_print_int(jvm, args, arg_count);
-                }
-            } else if (descriptor && strstr(descriptor, "()V")) {
-                native_system_out_println_void(jvm, NULL, 0);
-            } else if (descriptor && strstr(descriptor, "String")) {
-                arg_count = 1;
-                args[0].ref = pop_ref(frame);
-                if (strstr(method_name, "println")) {
-                    native_system_out_println(jvm, args, arg_count);
-                } else {
-                    native_system_out_print(jvm, args, arg_count);
-                }
-            }
+    // Handle the monitor methods of Object, which are final
+    if (strcmp(descriptor, "()V") == 0 &&
+        (strcmp(method_name, "wait") == 0 || strcmp(method_name, "notify") == 0 ||
+         strcmp(method_name, "notifyAll") == 0)) {
+        JObject* object = (JObject*)pop_ref(frame);
+        if (method_name[0] == 'w') {
+            return monitor_wait(jvm, frame, object);
         }
+        return monitor_notify(jvm, frame, object, strcmp(method_name, "notifyAll") == 0);
+    }
+    
+    // Handle atomic methods the optimizer did not bind, such as the targets
+    // of method references
+    uint16_t atomic_opcode = atomic_method_opcode(class_name, method_name, descriptor);
+    if (atomic_opcode) {
+        return execute_atomic(jvm, frame, atomic_opcode);
     }
-    // Handle Scanner methods
-    else if (class_name && strstr(class_name, "Scanner")) {
-        if (method_name && strcmp(method_name, "nextInt") == 0) {
-            int result = native_scanner_next_int(jvm, NULL, 0);
-            push_int(frame, result);
-        } else if (method_name && strcmp(method_name, "nextLine") == 0) {
-            int result = native_scanner_next_line(jvm, NULL, 0);
-            push_ref(frame, (void*)(intptr_t)result);
+    
+    // Handle StringBuilder methods
+    if (strcmp(class_name, "java/lang/StringBuilder") == 0) {
+        if (strcmp(method_name, "append") == 0) {
+            return execute_builder_append(jvm, frame, descriptor);
+        }
+        if (strcmp(descriptor, "()Ljava/lang/String;") == 0 || strcmp(descriptor, "()I") == 0) {
+            JStringBuilder* builder = (JStringBuilder*)pop_ref(frame);
+            if (!builder) {
+                return jvm_throw_new(jvm, frame, "java/lang/NullPointerException", NULL);
+            }
+            if (strcmp(method_name, "length") == 0) {
+                push_int(frame, (jint)builder->length);
+                return 0;
+            }
+            JString* str = builder_to_string(jvm, builder);
+            if (!str) {
+                return -1;
+            }
+            push_ref(frame, str);
+            return 0;
         }
     }
     
-    if (class_name) free(class_name);
-    if (method_name) free(method_name);
-    if (descriptor) free(descriptor);
-    return 0;
+    return skip_invocation(frame, descriptor, 1);
 }
 
-// Execute virtual method invocation
-static int execute_invokevirtual(JVM* jvm, Frame* frame) {
-    uint16_t method_index = read_u2(&frame->pc);
-    if (method_index >= frame->class_info->constant_pool_count) {
-        return -1;
-    }
+// Execute a call site linked at load time
+static int execute_invokedynamic(JVM* jvm, Frame* frame, uint32_t site_index) {
+    const CallSite* site = &frame->method->call_sites[site_index];
+    frame->stack_top -= site->argument_slots;
     
-    ConstantPoolEntry* method_ref = &frame->class_info->constant_pool[method_index];
-    if (method_ref->tag != CONST_METHODREF) {
-        return -1;
+    if (site->kind == CALL_SITE_CONCAT) {
+        JString* str = concat_call_site(jvm, site, &frame->operand_stack[frame->stack_top]);
+        if (!str) {
+            return -1;
+        }
+        push_ref(frame, str);
+        return 0;
+    }
+    if (site->kind == CALL_SITE_LAMBDA) {
+        JObject* lambda = site->instance;
+        if (!lambda &&
+            !(lambda = (JObject*)lambda_new(jvm, site->lambda, &frame->operand_stack[frame->stack_top]))) {
+            return -1;
+        }
+        push_ref(frame, lambda);
+        return 0;
+    }
+    return jvm_throw_new(jvm, frame, "java/lang/BootstrapMethodError", site->error);
+}
+
+// Execute special method invocation: private methods of the current class;
+// constructors of builtin classes have nothing to run beyond keeping the
+// message of exceptions and the initial contents of a StringBuilder
+static int execute_invokespecial(JVM* jvm, Frame* frame, uint16_t method_index) {
+    const NativeBinding* binding = native_binding(frame->class_info, method_index);
+    if (binding) {
+        return invoke_native(jvm, frame, binding, true);
+    }
+    binding = find_library_native(jvm, frame->class_info, method_index);
+    if (binding) {
+        return invoke_native(jvm, frame, binding, true);
     }
     
-    ConstantPoolEntry* class_entry = &frame->class_info->constant_pool[method_ref->ref_info.class_index];
-    ConstantPoolEntry* name_and_type = &frame->class_info->constant_pool[method_ref->ref_info.name_and_type_index];
-    if (class_entry->tag != CONST_CLASS || name_and_type->tag != 12) {
+    const char* class_name;
+    const char* method_name;
+    const char* descriptor;
+    if (constant_pool_member_ref(frame->class_info, method_index,
+                                 &class_name, &method_name, &descriptor) != 0) {
         return -1;
     }
     
-    char* class_name = read_utf8_string(frame->class_info, class_entry->class_info.string_index);
-    char* method_name = read_utf8_string(frame->class_info, name_and_type->ref_info.class_index);
-    char* descriptor = read_utf8_string(frame->class_info, name_and_type->ref_info.name_and_type_index);
+    if (strcmp(class_name, frame->class_info->name) == 0 && strcmp(method_name, "<init>") != 0) {
+        const MethodInfo* target_method = find_method_by_descriptor(frame->class_info, method_name, descriptor);
+        if (target_method && target_method->instructions) {
+            return invoke_method(jvm, frame, frame->class_info, target_method);
+        }
+        if (target_method && (target_method->access_flags & ACC_NATIVE)) {
+            return link_native_method(jvm, frame, method_index, target_method);
+        }
+    }
     
-    // Handle PrintStream methods
-    if (class_name && strstr(class_name, "PrintStream")) {
-        if (method_name && strstr(method_name, "print")) {
-            jvalue args[4];
-            int arg_count = 0;
-            if (descriptor && strstr(descriptor, "(I)")) {
-                arg_count = 1;
-                args[0].i = pop_int(frame);
-                pop_ref(frame); // Remove PrintStream object
-                if (strstr(method_name, "println")) {
-                    native_system_out_println_int(jvm, args, arg_count);
-                } else {
-                    native_system_out_print_int(jvm, args, arg_count);
-                }
-            } else if (descriptor && strstr(descriptor, "()V")) {
-                pop_ref(frame); // Remove PrintStream object
-                native_system_out_println_void(jvm, NULL, 0);
-            } else if (descriptor && strstr(descriptor, "String")) {
-                arg_count = 1;
-                args[0].ref = pop_ref(frame);
-                pop_ref(frame); // Remove PrintStream object
-                if (strstr(method_name, "println")) {
-                    native_system_out_println(jvm, args, arg_count);
-                } else {
-                    native_system_out_print(jvm, args, arg_count);
-                }
-            }
+    if (strcmp(class_name, "java/lang/StringBuilder") == 0 &&
+        strcmp(descriptor, "(Ljava/lang/String;)V") == 0) {
+        JString* str = (JString*)pop_ref(frame);
+        JStringBuilder* builder = (JStringBuilder*)pop_ref(frame);
+        if (!str || !builder) {
+            return jvm_throw_new(jvm, frame, "java/lang/NullPointerException", NULL);
         }
+        return builder_append_string(builder, str);
     }
     
-    // Handle StringBuilder methods
-    if (class_name && strstr(class_name, "StringBuilder")) {
-        if (method_name && strstr(method_name, "append")) {
-            if (descriptor && strstr(descriptor, "(I)")) {
-                jint value = pop_int(frame);
-                void* stringbuilder = pop_ref(frame);
-                char buffer[32];
-                snprintf(buffer, sizeof(buffer), "%d", value);
-                JString* current = (JString*)stringbuilder;
-                if (current && current->data) {
-                    size_t old_len = current->length;
-                    size_t new_len = old_len + strlen(buffer);
-                    current->data = realloc(current->data, new_len + 1);
-                    if (current->data) {
-                        strcat(current->data, buffer);
-                        current->length = new_len;
-                    }
-                } else {
-                    current = jvm_create_string(jvm, buffer);
-                }
-                push_ref(frame, current);
-            } else if (descriptor && strstr(descriptor, "String")) {
-                JString* str_to_append = (JString*)pop_ref(frame);
-                void* stringbuilder = pop_ref(frame);
-                JString* current = (JString*)stringbuilder;
-                if (current && current->data && str_to_append && str_to_append->data) {
-                    size_t old_len = current->length;
-                    size_t add_len = str_to_append->length;
-                    current->data = realloc(current->data, old_len + add_len + 1);
-                    if (current->data) {
-                        strcat(current->data, str_to_append->data);
-                        current->length = old_len + add_len;
-                    }
-                } else if (str_to_append && str_to_append->data) {
-                    current = jvm_create_string(jvm, str_to_append->data);
-                }
-                push_ref(frame, current);
-            }
-        } else if (method_name && strcmp(method_name, "toString") == 0) {
-            void* stringbuilder = pop_ref(frame);
-            JString* str = (JString*)stringbuilder;
-            if (str && str->data) {
-                push_ref(frame, str);
-            } else {
-                JString* empty = jvm_create_string(jvm, "");
-                push_ref(frame, empty);
-            }
+    if (strcmp(method_name, "<init>") == 0 && is_throwable_class(jvm, class_name)) {
+        int slots = argument_slots(descriptor);
+        if (slots < 0) {
+            return -1;
+        }
+        frame->stack_top -= slots + 1;
+        JThrowable* throwable = (JThrowable*)frame->operand_stack[frame->stack_top].ref;
+        if (throwable && strncmp(descriptor, "(Ljava/lang/String;", 19) == 0) {
+            throwable->message = (JString*)frame->operand_stack[frame->stack_top + 1].ref;
         }
+        return 0;
+    }
+    
+    return skip_invocation(frame, descriptor, 1);
+}
+
+// Call the target of a functional object: its captured values take the
+// place of the receiver, in front of the interface method arguments
+static int invoke_lambda(JVM* jvm, Frame* frame, const JLambda* lambda, int slots) {
+    const LambdaVTable* vtable = lambda->vtable;
+    jvalue* args = &frame->operand_stack[frame->stack_top - slots];
+    if (args + slots + vtable->captured_slots > jvm->stack_memory + MAX_STACK_SIZE) {
+        return jvm_throw_new(jvm, frame, "java/lang/StackOverflowError", NULL);
     }
+    memmove(args - 1 + vtable->captured_slots, args, slots * sizeof(jvalue));
+    memcpy(args - 1, lambda->captured, vtable->captured_slots * sizeof(jvalue));
+    frame->stack_top += vtable->captured_slots - 1;
     
-    if (class_name) free(class_name);
-    if (method_name) free(method_name);
-    if (descriptor) free(descriptor);
+    int status;
+    if (vtable->method) {
+        status = invoke_method(jvm, frame, vtable->class_info, vtable->method);
+    } else {
+        // Builtin targets run as the instruction the method handle stands
+        // for, with its member ref in the pool of the lambda's class
+        const ClassInfo* caller_class = frame->class_info;
+        frame->class_info = vtable->class_info;
+        switch (vtable->reference_kind) {
+        case REF_INVOKE_STATIC:
+            status = execute_invokestatic(jvm, frame, vtable->method_ref);
+            break;
+        case REF_INVOKE_SPECIAL:
+            status = execute_invokespecial(jvm, frame, vtable->method_ref);
+            break;
+        case REF_INVOKE_INTERFACE:
+            status = execute_invokeinterface(jvm, frame, vtable->method_ref);
+            break;
+        default:
+            status = execute_invokevirtual(jvm, frame, vtable->method_ref);
+            break;
+        }
+        frame->class_info = caller_class;
+    }
+    if (status != 0) {
+        return status;
+    }
+    frame->stack_top -= vtable->discarded_slots;
     return 0;
 }
 
-// Execute object creation
-static int execute_new(JVM* jvm, Frame* frame) {
-    uint16_t class_index = read_u2(&frame->pc);
-    if (class_index >= frame->class_info->constant_pool_count) {
+// Execute interface method invocation: functional objects dispatch through
+// the vtable of their call site; other receivers are builtin objects
+// handled as by invokevirtual
+static int execute_invokeinterface(JVM* jvm, Frame* frame, uint16_t method_index) {
+    const NativeBinding* binding = native_binding(frame->class_info, method_index);
+    if (binding) {
+        return invoke_native(jvm, frame, binding, true);
+    }
+    
+    const char* class_name;
+    const char* method_name;
+    const char* descriptor;
+    if (constant_pool_member_ref(frame->class_info, method_index,
+                                 &class_name, &method_name, &descriptor) != 0) {
+        return -1;
+    }
+    int slots = argument_slots(descriptor);
+    if (slots < 0) {
         return -1;
     }
     
-    ConstantPoolEntry* class_entry = &frame->class_info->constant_pool[class_index];
-    if (class_entry->tag != CONST_CLASS) {
+    JObject* receiver = (JObject*)frame->operand_stack[frame->stack_top - slots - 1].ref;
+    if (!receiver) {
+        return jvm_throw_new(jvm, frame, "java/lang/NullPointerException", NULL);
+    }
+    if (receiver->kind == OBJECT_LAMBDA) {
+        const JLambda* lambda = (const JLambda*)receiver;
+        if (strcmp(lambda->vtable->name, method_name) == 0 &&
+            strcmp(lambda->vtable->descriptor, descriptor) == 0) {
+            return invoke_lambda(jvm, frame, lambda, slots);
+        }
+        // Default methods of functional interfaces are not modelled
+        return skip_invocation(frame, descriptor, 1);
+    }
+    return execute_invokevirtual(jvm, frame, method_index);
+}
+
+// Execute checkcast. Classes and interfaces are not modelled, so only
+// casts to String and the wrapper classes, which are final, are checked.
+static int execute_checkcast(JVM* jvm, Frame* frame, uint16_t class_index) {
+    const char* class_name = constant_pool_class_name(frame->class_info, class_index);
+    if (!class_name) {
+        return -1;
+    }
+    const JObject* object = (const JObject*)frame->operand_stack[frame->stack_top - 1].ref;
+    if (object && (strcmp(class_name, "java/lang/String") == 0 || box_class_type(class_name)) &&
+        strcmp(object->class_name, class_name) != 0) {
+        return jvm_throw_new(jvm, frame, "java/lang/ClassCastException", NULL);
+    }
+    return 0;
+}
+
+// Execute object creation
+static int execute_new(JVM* jvm, Frame* frame, uint16_t class_index) {
+    const char* class_name = constant_pool_class_name(frame->class_info, class_index);
+    if (!class_name) {
         return -1;
     }
     
-    char* class_name = read_utf8_string(frame->class_info, class_entry->class_info.string_index);
-    if (class_name && strstr(class_name, "Scanner")) {
-        void* scanner_obj = malloc(sizeof(int));
-        if (scanner_obj) {
-            *(int*)scanner_obj = 1;
-            push_ref(frame, scanner_obj);
+    if (strstr(class_name, "Scanner")) {
+        JObject* scanner = jvm_alloc_object(jvm, "java/util/Scanner", sizeof(JObject));
+        if (!scanner) {
+            return -1;
+        }
+        push_ref(frame, scanner);
+    } else if (strcmp(class_name, "java/util/ArrayList") == 0) {
+        JArrayList* list = list_new(jvm, 0);
+        if (!list) {
+            return -1;
+        }
+        push_ref(frame, list);
+    } else if (strcmp(class_name, "java/util/HashMap") == 0) {
+        JHashMap* map = map_new(jvm);
+        if (!map) {
+            return -1;
+        }
+        push_ref(frame, map);
+    } else if (atomic_class_type(class_name)) {
+        JAtomic* atomic = atomic_new(jvm, class_name);
+        if (!atomic) {
+            return -1;
+        }
+        push_ref(frame, atomic);
+    } else if (strcmp(class_name, "java/lang/Thread") == 0) {
+        JThread* thread = thread_new(jvm);
+        if (!thread) {
+            return -1;
+        }
+        push_ref(frame, thread);
+    } else if (strstr(class_name, "StringBuilder")) {
+        JStringBuilder* builder = builder_new(jvm);
+        if (!builder) {
+            return -1;
         }
-    } else if (class_name && strstr(class_name, "StringBuilder")) {
-        JString* empty_sb = jvm_create_string(jvm, "");
-        push_ref(frame, empty_sb);
+        push_ref(frame, builder);
+    } else if (is_throwable_class(jvm, class_name)) {
+        JThrowable* throwable = jvm_new_throwable(jvm, class_name, NULL);
+        if (!throwable) {
+            return -1;
+        }
+        push_ref(frame, throwable);
     } else {
-        push_ref(frame, NULL);
+        // Fields are not modelled, so java/lang/Object and user classes are
+        // plain objects that can still be locked and compared
+        JObject* object = jvm_alloc_object(jvm, class_name, sizeof(JObject));
+        if (!object) {
+            return -1;
+        }
+        push_ref(frame, object);
     }
-    
-    if (class_name) free(class_name);
     return 0;
 }
 
-// Main bytecode interpreter
-static int execute_bytecode(JVM* jvm, Frame* frame) {
-    uint8_t* code_end = frame->method->code + frame->method->code_length;
+// Object of System.out, System.in or System.err, or NULL for another field
+static JObject* system_stream(const JVM* main, const char* class_name, const char* field_name) {
+    if (strcmp(class_name, "java/lang/System") != 0) {
+        return NULL;
+    }
+    if (strcmp(field_name, "out") == 0) {
+        return main->system_out;
+    }
+    if (strcmp(field_name, "in") == 0) {
+        return main->system_in;
+    }
+    if (strcmp(field_name, "err") == 0) {
+        return main->system_err;
+    }
+    return NULL;
+}
+
+// Execute static field read: static fields are not stored yet, so the
+// System streams read as their objects, other references as null and
+// numbers as zero
+static int execute_getstatic(JVM* jvm, Frame* frame, uint16_t field_index) {
+    const char* class_name;
+    const char* field_name;
+    const char* descriptor;
+    if (constant_pool_member_ref(frame->class_info, field_index,
+                                 &class_name, &field_name, &descriptor) != 0) {
+        return -1;
+    }
     
-    while (frame->pc < code_end) {
-        uint8_t opcode = read_u1(&frame->pc);
-        fflush(stdout);
-        
-        switch (opcode) {
-            case NOP:
-                break;
-                
-            // Constants - null and objects
-            case ACONST_NULL:
-                push_ref(frame, NULL);
-                break;
-                
-            // Integer constants
-            case ICONST_M1:
-                push_int(frame, -1);
-                break;
-            case ICONST_0:
-                push_int(frame, 0);
-                break;
-            case ICONST_1:
-                push_int(frame, 1);
-                break;
-            case ICONST_2:
-                push_int(frame, 2);
-                break;
-            case ICONST_3:
-                push_int(frame, 3);
-                break;
-            case ICONST_4:
-                push_int(frame, 4);
-                break;
-            case ICONST_5:
-                push_int(frame, 5);
-                break;
-                
-            // Long constants
-            case LCONST_0:
-                push_long(frame, 0L);
-                break;
-            case LCONST_1:
-                push_long(frame, 1L);
-                break;
-                
-            // Float constants
-            case FCONST_0:
-                push_float(frame, 0.0f);
-                break;
-            case FCONST_1:
-                push_float(frame, 1.0f);
-                break;
-            case FCONST_2:
-                push_float(frame, 2.0f);
-                break;
-                
-            // Double constants
-            case DCONST_0:
-                push_double(frame, 0.0);
-                break;
-            case DCONST_1:
-                push_double(frame, 1.0);
-                break;
-                
-            // Load constants
-            case BIPUSH: {
-                int8_t value = (int8_t)read_u1(&frame->pc);
-                push_int(frame, value);
-                break;
-            }
-            
-            case SIPUSH: {
-                int16_t value = read_s2(&frame->pc);
-                push_int(frame, value);
+    switch (descriptor[0]) {
+        case 'L':
+        case '[':
+            push_ref(frame, system_stream(jvm->main, class_name, field_name));
+            break;
+        case 'J':
+            push_long(frame, 0);
+            break;
+        case 'D':
+            push_double(frame, 0.0);
+            break;
+        default:
+            push_int(frame, 0);
+            break;
+    }
+    return 0;
+}
+
+// Execute instance field read
+static int execute_getfield(JVM* jvm, Frame* frame, uint16_t field_index) {
+    (void)jvm;
+    (void)frame;
+    (void)field_index;
+    // Objects have no instance fields yet
+    return -1;
+}
+
+// Handler generation from the opcode table: per verification type, the C
+// type, the jvalue member and the stack operations
+#define CTYPE_I jint
+#define CTYPE_J jlong
+#define CTYPE_F jfloat
+#define CTYPE_D jdouble
+#define CTYPE_A void*
+#define FIELD_I i
+#define FIELD_J l
+#define FIELD_F f
+#define FIELD_D d
+#define FIELD_A ref
+#define PUSH_I push_int
+#define PUSH_J push_long
+#define PUSH_F push_float
+#define PUSH_D push_double
+#define PUSH_A push_ref
+#define POP_I pop_int
+#define POP_J pop_long
+#define POP_F pop_float
+#define POP_D pop_double
+#define POP_A pop_ref
+
+#define GENERATE_HANDLER(name, code, format, pops, pushes, kind, type, op) \
+    GENERATE_##kind(name, type, op)
+#define GENERATE_SPECIAL(name, type, op)
+#define GENERATE_DECODED(name, type, op)
+#define GENERATE_CONST(name, type, op) \
+    case name: PUSH_##type(frame, op); break;
+#define GENERATE_LOAD(name, type, op) \
+    case name: PUSH_##type(frame, frame->locals[insn->a].FIELD_##type); break;
+#define GENERATE_STORE(name, type, op) \
+    case name: frame->locals[insn->a].FIELD_##type = POP_##type(frame); break;
+#define GENERATE_UNARY(name, type, op) \
+    case name: { \
+        CTYPE_##type value = POP_##type(frame); \
+        PUSH_##type(frame, op(value)); \
+        break; \
+    }
+#define GENERATE_BINARY(name, type, op) \
+    case name: { \
+        CTYPE_##type value2 = POP_##type(frame); \
+        CTYPE_##type value1 = POP_##type(frame); \
+        PUSH_##type(frame, op(value1, value2)); \
+        break; \
+    }
+#define GENERATE_DIVIDE(name, type, op) \
+    case name: { \
+        CTYPE_##type value2 = POP_##type(frame); \
+        CTYPE_##type value1 = POP_##type(frame); \
+        if (value2 == 0) { \
+            status = jvm_throw_new(jvm, frame, "java/lang/ArithmeticException", "/ by zero"); \
+            goto unwind; \
+        } \
+        PUSH_##type(frame, op(value1, value2)); \
+        break; \
+    }
+#define GENERATE_SHIFT(name, type, op) \
+    case name: { \
+        jint shift = pop_int(frame); \
+        CTYPE_##type value = POP_##type(frame); \
+        PUSH_##type(frame, op(value, shift)); \
+        break; \
+    }
+#define GENERATE_CONVERT(name, type, op) \
+    case name: { \
+        CTYPE_##type value = POP_##type(frame); \
+        PUSH_##op(frame, CONVERT_##type##_TO_##op(value)); \
+        break; \
+    }
+#define GENERATE_COMPARE(name, type, op) \
+    case name: { \
+        CTYPE_##type value2 = POP_##type(frame); \
+        CTYPE_##type value1 = POP_##type(frame); \
+        push_int(frame, value1 > value2 ? 1 : value1 == value2 ? 0 : value1 < value2 ? -1 : op); \
+        break; \
+    }
+// Slow path of a backward branch: stop at a pending safepoint, and yield
+// once the time slice is used up. A yielded green thread waits in a run
+// queue, outside Java until it runs again.
+static void backedge_poll(JVM* jvm) {
+    safepoint_poll(jvm);
+    if (jvm->backedge_budget <= 0) {
+        safepoint_leave_java(jvm);
+        thread_yield(jvm);
+        safepoint_enter_java(jvm);
+    }
+}
+
+// Take a branch. Backward branches poll for a safepoint and use up the
+// thread's time slice, after which a green thread yields its worker to the
+// other runnable threads.
+#define BRANCH_TO(target) \
+    do { \
+        const Instruction* branch_target = code + (target); \
+        if (branch_target <= insn && \
+            (--jvm->backedge_budget <= 0 || safepoint_requested())) { \
+            backedge_poll(jvm); \
+        } \
+        frame->pc = branch_target; \
+    } while (0)
+
+#define GENERATE_IF(name, type, op) \
+    case name: \
+        if (POP_##type(frame) op 0) { \
+            BRANCH_TO(insn->a); \
+        } \
+        break;
+#define GENERATE_IF_CMP(name, type, op) \
+    case name: { \
+        CTYPE_##type value2 = POP_##type(frame); \
+        CTYPE_##type value1 = POP_##type(frame); \
+        if (value1 op value2) { \
+            BRANCH_TO(insn->a); \
+        } \
+        break; \
+    }
+
+#define GENERATE_INTRINSIC(name, class_name, method, descriptor, pops, pushes, kind, type, result, op) \
+    INTRINSIC_##kind(name, type, result, op)
+#define INTRINSIC_UNARY(name, type, result, op) \
+    case name: { \
+        CTYPE_##type value = POP_##type(frame); \
+        PUSH_##result(frame, op(value)); \
+        break; \
+    }
+#define INTRINSIC_BINARY(name, type, result, op) \
+    case name: { \
+        CTYPE_##type value2 = POP_##type(frame); \
+        CTYPE_##type value1 = POP_##type(frame); \
+        PUSH_##result(frame, op(value1, value2)); \
+        break; \
+    }
+#define INTRINSIC_TERNARY(name, type, result, op) \
+    case name: { \
+        CTYPE_##type value3 = POP_##type(frame); \
+        CTYPE_##type value2 = POP_##type(frame); \
+        CTYPE_##type value1 = POP_##type(frame); \
+        PUSH_##result(frame, op(value1, value2, value3)); \
+        break; \
+    }
+
+// Atomic intrinsics on the JAtomic below the operands: one atomic
+// instruction on its value, in the memory order of the Java method
+#define GENERATE_ATOMIC(name, class_name, method, descriptor, pops, pushes, kind, type, op) \
+    case name: { \
+        ATOMIC_##kind(type, op) \
+        break; \
+    }
+#define ATOMIC_RECEIVER(atomic) \
+    JAtomic* atomic = (JAtomic*)pop_ref(frame); \
+    if (!atomic) { \
+        status = jvm_throw_new(jvm, frame, "java/lang/NullPointerException", NULL); \
+        goto unwind; \
+    }
+#define ATOMIC_GET(type, order) \
+    ATOMIC_RECEIVER(atomic) \
+    PUSH_##type(frame, __atomic_load_n(&atomic->value.FIELD_##type, order));
+#define ATOMIC_SET(type, order) \
+    CTYPE_##type value = POP_##type(frame); \
+    ATOMIC_RECEIVER(atomic) \
+    __atomic_store_n(&atomic->value.FIELD_##type, value, order);
+#define ATOMIC_CAS(type, order) \
+    CTYPE_##type update = POP_##type(frame); \
+    CTYPE_##type expected = POP_##type(frame); \
+    ATOMIC_RECEIVER(atomic) \
+    push_int(frame, __atomic_compare_exchange_n(&atomic->value.FIELD_##type, &expected, update, \
+                                                false, order, order));
+#define ATOMIC_SWAP(type, order) \
+    CTYPE_##type value = POP_##type(frame); \
+    ATOMIC_RECEIVER(atomic) \
+    PUSH_##type(frame, __atomic_exchange_n(&atomic->value.FIELD_##type, value, order));
+#define ATOMIC_GET_AND_ADD(type, delta) \
+    CTYPE_##type value = ATOMIC_DELTA_##delta(type); \
+    ATOMIC_RECEIVER(atomic) \
+    PUSH_##type(frame, __atomic_fetch_add(&atomic->value.FIELD_##type, value, __ATOMIC_SEQ_CST));
+#define ATOMIC_ADD_AND_GET(type, delta) \
+    CTYPE_##type value = ATOMIC_DELTA_##delta(type); \
+    ATOMIC_RECEIVER(atomic) \
+    PUSH_##type(frame, __atomic_add_fetch(&atomic->value.FIELD_##type, value, __ATOMIC_SEQ_CST));
+#define ATOMIC_DELTA_ARGUMENT(type) POP_##type(frame)
+#define ATOMIC_DELTA_ONE(type) 1
+#define ATOMIC_DELTA_MINUS_ONE(type) (-1)
+
+// Run an atomic intrinsic reached through an unbound invocation
+static int execute_atomic(JVM* jvm, Frame* frame, uint16_t opcode) {
+    int status;
+    switch (opcode) {
+        ATOMIC_INTRINSICS(GENERATE_ATOMIC)
+        default:
+            return -1;
+    }
+    return 0;
+    
+unwind:
+    return status;
+}
+
+// Target of a sparse lookupswitch: a single probe for perfect-hashed keys,
+// otherwise a branchless binary search over the sorted keys
+static inline int32_t lookup_switch_target(const SwitchTable* table, jint key) {
+    if (table->hash_multiplier) {
+        uint32_t slot = ((uint32_t)key * table->hash_multiplier) >> table->hash_shift;
+        return table->keys[slot] == key ? table->targets[slot] : table->default_target;
+    }
+
+    const int32_t* keys = table->keys;
+    uint32_t n = table->count;
+    while (n > 1) {
+        uint32_t half = n / 2;
+        keys = keys[half] <= key ? keys + half : keys;
+        n -= half;
+    }
+    return *keys == key ? table->targets[keys - table->keys] : table->default_target;
+}
+
+// Main bytecode interpreter
+static int execute_bytecode(JVM* jvm, Frame* frame) {
+    const Instruction* code = frame->method->instructions;
+    const Instruction* code_end = code + frame->method->instructions_count;
+    int status;
+    
+    while (frame->pc < code_end) {
+        const Instruction* insn = frame->pc++;
+        
+        switch (insn->opcode) {
+            case NOP:
                 break;
-            }
-            
-            case LDC: {
-                uint8_t index = read_u1(&frame->pc);
-                if (index >= frame->class_info->constant_pool_count) {
-                    return -1;
-                }
                 
-                ConstantPoolEntry* entry = &frame->class_info->constant_pool[index];
-                if (entry->tag == CONST_INTEGER) {
-                    push_int(frame, entry->integer_info.value);
-                } else if (entry->tag == CONST_FLOAT) {
-                    push_float(frame, entry->float_info.value);
-                } else if (entry->tag == CONST_STRING) {
-                    if (execute_ldc_string(jvm, frame, index) != 0) {
-                        return -1;
-                    }
-                } else {
-                    return -1;
-                }
-                break;
-            }
+            // Typed constants, locals, arithmetic, conversions, comparisons
+            // and conditional branches, generated from the opcode table
+            JVM_OPCODES(GENERATE_HANDLER)
             
-            // Load from locals - int
-            case ILOAD: {
-                uint8_t index = read_u1(&frame->pc);
-                push_int(frame, frame->locals[index].i);
-                break;
-            }
+            // Math intrinsics bound by the optimizer
+            MATH_INTRINSICS(GENERATE_INTRINSIC)
             
-            case ILOAD_0:
-                push_int(frame, frame->locals[0].i);
-                break;
-            case ILOAD_1:
-                push_int(frame, frame->locals[1].i);
-                break;
-            case ILOAD_2:
-                push_int(frame, frame->locals[2].i);
-                break;
-            case ILOAD_3:
-                push_int(frame, frame->locals[3].i);
-                break;
+            // Atomic intrinsics bound by the optimizer
+            ATOMIC_INTRINSICS(GENERATE_ATOMIC)
                 
-            // Load from locals - reference
-            case ALOAD_0:
-                push_ref(frame, frame->locals[0].ref);
-                break;
-            case ALOAD_1:
-                push_ref(frame, frame->locals[1].ref);
-                break;
-            case ALOAD_2:
-                push_ref(frame, frame->locals[2].ref);
-                break;
-            case ALOAD_3:
-                push_ref(frame, frame->locals[3].ref);
+            // Integer constants (iconst_*, bipush and sipush)
+            case ICONST:
+                push_int(frame, insn->a);
                 break;
                 
-            // Load from locals - other types
-            case LLOAD: {
-                uint8_t index = read_u1(&frame->pc);
-                push_long(frame, frame->locals[index].l);
-                break;
-            }
-            
-            case FLOAD: {
-                uint8_t index = read_u1(&frame->pc);
-                push_float(frame, frame->locals[index].f);
-                break;
-            }
-            
-            case DLOAD: {
-                uint8_t index = read_u1(&frame->pc);
-                push_double(frame, frame->locals[index].d);
-                break;
-            }
-            
-            case ALOAD: {
-                uint8_t index = read_u1(&frame->pc);
-                push_ref(frame, frame->locals[index].ref);
-                break;
-            }
-            
-            // Store to locals - int
-            case ISTORE: {
-                uint8_t index = read_u1(&frame->pc);
-                frame->locals[index].i = pop_int(frame);
+            // Load constants from the resolved table: numbers unboxed,
+            // strings interned
+            case LDC:
+            case LDC_W: {
+                uint16_t index = (uint16_t)insn->a;
+                uint8_t tag = frame->class_info->constant_pool[index].tag;
+                if (tag != CONST_INTEGER && tag != CONST_FLOAT && tag != CONST_STRING) {
+                    return -1;
+                }
+                frame->operand_stack[frame->stack_top++] = frame->class_info->constants[index];
                 break;
             }
             
-            case ISTORE_0:
-                frame->locals[0].i = pop_int(frame);
-                break;
-            case ISTORE_1:
-                frame->locals[1].i = pop_int(frame);
-                break;
-            case ISTORE_2:
-                frame->locals[2].i = pop_int(frame);
-                break;
-            case ISTORE_3:
-                frame->locals[3].i = pop_int(frame);
+            case LDC_CONST:
+                frame->operand_stack[frame->stack_top++] = frame->class_info->constants[insn->a];
                 break;
                 
-            // Store to locals - reference
-            case ASTORE_0:
-                frame->locals[0].ref = pop_ref(frame);
-                break;
-            case ASTORE_1:
-                frame->locals[1].ref = pop_ref(frame);
-                break;
-            case ASTORE_2:
-                frame->locals[2].ref = pop_ref(frame);
-                break;
-            case ASTORE_3:
-                frame->locals[3].ref = pop_ref(frame);
-                break;
-                
-            // Store to locals - other types
-            case LSTORE: {
-                uint8_t index = read_u1(&frame->pc);
-                frame->locals[index].l = pop_long(frame);
-                break;
-            }
-            
-            case FSTORE: {
-                uint8_t index = read_u1(&frame->pc);
-                frame->locals[index].f = pop_float(frame);
-                break;
-            }
-            
-            case DSTORE: {
-                uint8_t index = read_u1(&frame->pc);
-                frame->locals[index].d = pop_double(frame);
-                break;
-            }
-            
-            case ASTORE: {
-                uint8_t index = read_u1(&frame->pc);
-                frame->locals[index].ref = pop_ref(frame);
-                break;
-            }
-            
-            // Arithmetic operations - addition
-            case IADD: {
-                jint value2 = pop_int(frame);
-                jint value1 = pop_int(frame);
-                push_int(frame, value1 + value2);
-                break;
-            }
-            
-            case LADD: {
-                jlong value2 = pop_long(frame);
-                jlong value1 = pop_long(frame);
-                push_long(frame, value1 + value2);
-                break;
-            }
-            
-            case FADD: {
-                jfloat value2 = pop_float(frame);
-                jfloat value1 = pop_float(frame);
-                push_float(frame, value1 + value2);
-                break;
-            }
-            
-            case DADD: {
-                jdouble value2 = pop_double(frame);
-                jdouble value1 = pop_double(frame);
-                push_double(frame, value1 + value2);
-                break;
-            }
-            
-            // Arithmetic operations - subtraction
-            case ISUB: {
-                jint value2 = pop_int(frame);
-                jint value1 = pop_int(frame);
-                push_int(frame, value1 - value2);
-                break;
-            }
-            
-            case LSUB: {
-                jlong value2 = pop_long(frame);
-                jlong value1 = pop_long(frame);
-                push_long(frame, value1 - value2);
+            case LDC2_W:
+                frame->operand_stack[frame->stack_top] = frame->class_info->constants[insn->a];
+                frame->stack_top += 2;
                 break;
-            }
             
-            case FSUB: {
-                jfloat value2 = pop_float(frame);
-                jfloat value1 = pop_float(frame);
-                push_float(frame, value1 - value2);
+            case IINC:
+                frame->locals[insn->a].i = INT_ADD(frame->locals[insn->a].i, insn->b);
                 break;
-            }
-            
-            case DSUB: {
-                jdouble value2 = pop_double(frame);
-                jdouble value1 = pop_double(frame);
-                push_double(frame, value1 - value2);
-                break;
-            }
             
-            // Arithmetic operations - multiplication
-            case IMUL: {
-                jint value2 = pop_int(frame);
-                jint value1 = pop_int(frame);
-                push_int(frame, value1 * value2);
+            // Unconditional branch
+            case GOTO:
+                BRANCH_TO(insn->a);
                 break;
-            }
             
-            case LMUL: {
-                jlong value2 = pop_long(frame);
-                jlong value1 = pop_long(frame);
-                push_long(frame, value1 * value2);
+            // Switches; dense lookupswitches were decoded as jump arrays
+            case TABLESWITCH: {
+                const SwitchTable* table = &frame->method->switch_tables[insn->a];
+                uint32_t index = (uint32_t)pop_int(frame) - (uint32_t)table->low;
+                BRANCH_TO(index < table->count ? table->targets[index] : table->default_target);
                 break;
             }
-            
-            case FMUL: {
-                jfloat value2 = pop_float(frame);
-                jfloat value1 = pop_float(frame);
-                push_float(frame, value1 * value2);
+            case LOOKUPSWITCH:
+                BRANCH_TO(lookup_switch_target(&frame->method->switch_tables[insn->a], pop_int(frame)));
                 break;
-            }
             
-            case DMUL: {
-                jdouble value2 = pop_double(frame);
-                jdouble value1 = pop_double(frame);
-                push_double(frame, value1 * value2);
-                break;
-            }
+            // Method returns, polling for a safepoint
+            case IRETURN:
+            case FRETURN:
+            case ARETURN:
+                frame->return_value = frame->operand_stack[frame->stack_top - 1];
+                safepoint_poll(jvm);
+                return 0;
+            case LRETURN:
+            case DRETURN:
+                frame->return_value = frame->operand_stack[frame->stack_top - 2];
+                safepoint_poll(jvm);
+                return 0;
+            case RETURN:
+                safepoint_poll(jvm);
+                return 0;
             
-            // Arithmetic operations - division
-            case IDIV: {
-                jint value2 = pop_int(frame);
-                jint value1 = pop_int(frame);
-                if (value2 == 0) {
-                    return -1;
-                }
-                push_int(frame, value1 / value2);
-                break;
-            }
+            // Exceptions
+            case ATHROW:
+                status = jvm_throw(jvm, frame, (JThrowable*)pop_ref(frame));
+                goto unwind;
             
-            case LDIV: {
-                jlong value2 = pop_long(frame);
-                jlong value1 = pop_long(frame);
-                if (value2 == 0) {
-                    return -1;
+            // Locks
+            case MONITORENTER:
+                status = monitor_enter(jvm, frame, (JObject*)pop_ref(frame));
+                if (status != 0) {
+                    goto unwind;
                 }
-                push_long(frame, value1 / value2);
                 break;
-            }
-            
-            case FDIV: {
-                jfloat value2 = pop_float(frame);
-                jfloat value1 = pop_float(frame);
-                push_float(frame, value1 / value2);
-                break;
-            }
-            
-            case DDIV: {
-                jdouble value2 = pop_double(frame);
-                jdouble value1 = pop_double(frame);
-                push_double(frame, value1 / value2);
-                break;
-            }
-            
-            // Arithmetic operations - remainder
-            case IREM: {
-                jint value2 = pop_int(frame);
-                jint value1 = pop_int(frame);
-                if (value2 == 0) {
-                    return -1;
+                
+            case MONITOREXIT:
+                status = monitor_exit(jvm, frame, (JObject*)pop_ref(frame));
+                if (status != 0) {
+                    goto unwind;
                 }
-                push_int(frame, value1 % value2);
-                break;
-            }
-            
-            // Arithmetic operations - negation
-            case INEG: {
-                jint value = pop_int(frame);
-                push_int(frame, -value);
-                break;
-            }
-            
-            case LNEG: {
-                jlong value = pop_long(frame);
-                push_long(frame, -value);
-                break;
-            }
-            
-            case FNEG: {
-                jfloat value = pop_float(frame);
-                push_float(frame, -value);
-                break;
-            }
-            
-            case DNEG: {
-                jdouble value = pop_double(frame);
-                push_double(frame, -value);
-                break;
-            }
-            
-            // Bitwise operations
-            case IAND: {
-                jint value2 = pop_int(frame);
-                jint value1 = pop_int(frame);
-                push_int(frame, value1 & value2);
-                break;
-            }
-            
-            case IOR: {
-                jint value2 = pop_int(frame);
-                jint value1 = pop_int(frame);
-                push_int(frame, value1 | value2);
                 break;
-            }
-            
-            case IXOR: {
-                jint value2 = pop_int(frame);
-                jint value1 = pop_int(frame);
-                push_int(frame, value1 ^ value2);
-                break;
-            }
-            
-            // Type conversions
-            case I2L: {
-                jint value = pop_int(frame);
-                push_long(frame, (jlong)value);
-                break;
-            }
-            
-            case I2F: {
-                jint value = pop_int(frame);
-                push_float(frame, (jfloat)value);
-                break;
-            }
-            
-            case I2D: {
-                jint value = pop_int(frame);
-                push_double(frame, (jdouble)value);
+                
+            // Stack management
+            case DUP:
+                frame->operand_stack[frame->stack_top] = frame->operand_stack[frame->stack_top - 1];
+                frame->stack_top++;
                 break;
-            }
             
-            case L2I: {
-                jlong value = pop_long(frame);
-                push_int(frame, (jint)value);
+            case DUP_X1:
+                dup_slots(frame, 1, 1);
                 break;
-            }
             
-            case L2F: {
-                jlong value = pop_long(frame);
-                push_float(frame, (jfloat)value);
+            case DUP_X2:
+                dup_slots(frame, 1, 2);
                 break;
-            }
             
-            case L2D: {
-                jlong value = pop_long(frame);
-                push_double(frame, (jdouble)value);
+            case DUP2:
+                dup_slots(frame, 2, 0);
                 break;
-            }
             
-            case F2I: {
-                jfloat value = pop_float(frame);
-                push_int(frame, (jint)value);
+            case DUP2_X1:
+                dup_slots(frame, 2, 1);
                 break;
-            }
             
-            case F2L: {
-                jfloat value = pop_float(frame);
-                push_long(frame, (jlong)value);
+            case DUP2_X2:
+                dup_slots(frame, 2, 2);
                 break;
-            }
             
-            case F2D: {
-                jfloat value = pop_float(frame);
-                push_double(frame, (jdouble)value);
-                break;
-            }
-            
-            case D2I: {
-                jdouble value = pop_double(frame);
-                push_int(frame, (jint)value);
-                break;
-            }
-            
-            case D2L: {
-                jdouble value = pop_double(frame);
-                push_long(frame, (jlong)value);
+            case POP:
+                frame->stack_top--;
                 break;
-            }
             
-            case D2F: {
-                jdouble value = pop_double(frame);
-                push_float(frame, (jfloat)value);
+            case POP2:
+                frame->stack_top -= 2;
                 break;
-            }
-            
-            // Comparison operations
-            case LCMP: {
-                jlong value2 = pop_long(frame);
-                jlong value1 = pop_long(frame);
-                if (value1 > value2) {
-                    push_int(frame, 1);
-                } else if (value1 == value2) {
-                    push_int(frame, 0);
-                } else {
-                    push_int(frame, -1);
-                }
+                
+            case SWAP: {
+                jvalue temp = frame->operand_stack[frame->stack_top - 1];
+                frame->operand_stack[frame->stack_top - 1] = frame->operand_stack[frame->stack_top - 2];
+                frame->operand_stack[frame->stack_top - 2] = temp;
                 break;
             }
             
-            case FCMPL:
-            case FCMPG: {
-                jfloat value2 = pop_float(frame);
-                jfloat value1 = pop_float(frame);
-                if (value1 > value2) {
-                    push_int(frame, 1);
-                } else if (value1 == value2) {
-                    push_int(frame, 0);
-                } else {
-                    push_int(frame, -1);
+            // Method invocations
+            case INVOKESTATIC:
+                status = execute_invokestatic(jvm, frame, (uint16_t)insn->a);
+                if (status != 0) {
+                    goto unwind;
                 }
                 break;
-            }
-            
-            case DCMPL:
-            case DCMPG: {
-                jdouble value2 = pop_double(frame);
-                jdouble value1 = pop_double(frame);
-                if (value1 > value2) {
-                    push_int(frame, 1);
-                } else if (value1 == value2) {
-                    push_int(frame, 0);
-                } else {
-                    push_int(frame, -1);
+                
+            case INVOKEVIRTUAL:
+                status = execute_invokevirtual(jvm, frame, (uint16_t)insn->a);
+                if (status != 0) {
+                    goto unwind;
                 }
                 break;
-            }
-            
-            // Conditional branches
-            case IFEQ: {
-                int16_t branch = read_s2(&frame->pc);
-                jint value = pop_int(frame);
-                if (value == 0) {
-                    frame->pc += branch - 3;
+                
+            case INVOKESPECIAL:
+                status = execute_invokespecial(jvm, frame, (uint16_t)insn->a);
+                if (status != 0) {
+                    goto unwind;
                 }
                 break;
-            }
-            
-            case IFNE: {
-                int16_t branch = read_s2(&frame->pc);
-                jint value = pop_int(frame);
-                if (value != 0) {
-                    frame->pc += branch - 3;
+                
+            case INVOKEINTERFACE:
+                status = execute_invokeinterface(jvm, frame, (uint16_t)insn->a);
+                if (status != 0) {
+                    goto unwind;
                 }
                 break;
-            }
-            
-            case IFLT: {
-                int16_t branch = read_s2(&frame->pc);
-                jint value = pop_int(frame);
-                if (value < 0) {
-                    frame->pc += branch - 3;
+                
+            case INVOKE_NATIVE:
+                status = invoke_native(jvm, frame, &frame->class_info->native_bindings[insn->a], insn->b);
+                if (status != 0) {
+                    goto unwind;
                 }
                 break;
-            }
-            
-            case IFGE: {
-                int16_t branch = read_s2(&frame->pc);
-                jint value = pop_int(frame);
-                if (value >= 0) {
-                    frame->pc += branch - 3;
+                
+            case INVOKEDYNAMIC:
+                status = execute_invokedynamic(jvm, frame, (uint32_t)insn->a);
+                if (status != 0) {
+                    goto unwind;
                 }
                 break;
-            }
             
-            case IFGT: {
-                int16_t branch = read_s2(&frame->pc);
-                jint value = pop_int(frame);
-                if (value > 0) {
-                    frame->pc += branch - 3;
+            // Wrapper intrinsics bound by the optimizer
+            case BOX:
+                if (execute_box(jvm, frame, (char)insn->a) != 0) {
+                    return -1;
                 }
                 break;
-            }
-            
-            case IFLE: {
-                int16_t branch = read_s2(&frame->pc);
-                jint value = pop_int(frame);
-                if (value <= 0) {
-                    frame->pc += branch - 3;
+                
+            case UNBOX:
+                status = execute_unbox(jvm, frame, (char)insn->a);
+                if (status != 0) {
+                    goto unwind;
                 }
                 break;
-            }
             
-            // Compare two ints
-            case IF_ICMPEQ: {
-                int16_t branch = read_s2(&frame->pc);
-                jint value2 = pop_int(frame);
-                jint value1 = pop_int(frame);
-                if (value1 == value2) {
-                    frame->pc += branch - 3;
+            // Object operations
+            case CHECKCAST:
+                status = execute_checkcast(jvm, frame, (uint16_t)insn->a);
+                if (status != 0) {
+                    goto unwind;
                 }
                 break;
-            }
-            
-            case IF_ICMPNE: {
-                int16_t branch = read_s2(&frame->pc);
-                jint value2 = pop_int(frame);
-                jint value1 = pop_int(frame);
-                if (value1 != value2) {
-                    frame->pc += branch - 3;
+                
+            case NEW:
+                status = execute_new(jvm, frame, (uint16_t)insn->a);
+                if (status != 0) {
+                    goto unwind;
                 }
                 break;
-            }
-            
-            case IF_ICMPLT: {
-                int16_t branch = read_s2(&frame->pc);
-                jint value2 = pop_int(frame);
-                jint value1 = pop_int(frame);
-                if (value1 < value2) {
-                    frame->pc += branch - 3;
+                
+            case GETSTATIC:
+                if (execute_getstatic(jvm, frame, (uint16_t)insn->a) != 0) {
+                    return -1;
                 }
                 break;
-            }
-            
-            case IF_ICMPGE: {
-                int16_t branch = read_s2(&frame->pc);
-                jint value2 = pop_int(frame);
-                jint value1 = pop_int(frame);
-                if (value1 >= value2) {
-                    frame->pc += branch - 3;
+                
+            case GETFIELD:
+                if (execute_getfield(jvm, frame, (uint16_t)insn->a) != 0) {
+                    return -1;
                 }
                 break;
-            }
-            
-            case IF_ICMPGT: {
-                int16_t branch = read_s2(&frame->pc);
-                jint value2 = pop_int(frame);
-                jint value1 = pop_int(frame);
-                if (value1 > value2) {
-                    frame->pc += branch - 3;
-                }
+                
+            // Superinstructions
+            case ILOAD_ILOAD_IADD_ISTORE:
+                frame->locals[insn->c].i = INT_ADD(frame->locals[insn->a].i, frame->locals[insn->b].i);
                 break;
-            }
-            
-            case IF_ICMPLE: {
-                int16_t branch = read_s2(&frame->pc);
-                jint value2 = pop_int(frame);
-                jint value1 = pop_int(frame);
-                if (value1 <= value2) {
-                    frame->pc += branch - 3;
-                }
+            case ILOAD_ILOAD_ISUB_ISTORE:
+                frame->locals[insn->c].i = INT_SUB(frame->locals[insn->a].i, frame->locals[insn->b].i);
                 break;
-            }
-            
-            // Unconditional branch
-            case GOTO: {
-                int16_t branch = read_s2(&frame->pc);
-                frame->pc += branch - 3;
+            case ILOAD_ILOAD_IMUL_ISTORE:
+                frame->locals[insn->c].i = INT_MUL(frame->locals[insn->a].i, frame->locals[insn->b].i);
                 break;
-            }
-            
-            // Method returns
-            case IRETURN:
-                return pop_int(frame);
-            case LRETURN:
-                return (int)pop_long(frame);
-            case FRETURN:
-                return (int)pop_float(frame);
-            case DRETURN:
-                return (int)pop_double(frame);
-            case ARETURN:
-                return (int)(intptr_t)pop_ref(frame);
-            case RETURN:
-                return 0;
                 
-            // Stack management
-            case DUP: {
-                if (frame->stack_top > 0) {
-                    jvalue value = frame->operand_stack[frame->stack_top - 1];
-                    frame->operand_stack[frame->stack_top] = value;
-                    frame->stack_top++;
+            case ILOAD_ICONST_IF_ICMPEQ:
+                if (frame->locals[insn->a].i == insn->b) {
+                    BRANCH_TO(insn->c);
                 }
                 break;
-            }
-            
-            case POP:
-                if (frame->stack_top > 0) {
-                    frame->stack_top--;
+            case ILOAD_ICONST_IF_ICMPNE:
+                if (frame->locals[insn->a].i != insn->b) {
+                    BRANCH_TO(insn->c);
                 }
                 break;
-                
-            case SWAP: {
-                if (frame->stack_top >= 2) {
-                    jvalue temp = frame->operand_stack[frame->stack_top - 1];
-                    frame->operand_stack[frame->stack_top - 1] = frame->operand_stack[frame->stack_top - 2];
-                    frame->operand_stack[frame->stack_top - 2] = temp;
+            case ILOAD_ICONST_IF_ICMPLT:
+                if (frame->locals[insn->a].i < insn->b) {
+                    BRANCH_TO(insn->c);
                 }
                 break;
-            }
-            
-            // Method invocations
-            case INVOKESTATIC:
-                if (execute_invokestatic(jvm, frame) != 0) {
-                    return -1;
+            case ILOAD_ICONST_IF_ICMPGE:
+                if (frame->locals[insn->a].i >= insn->b) {
+                    BRANCH_TO(insn->c);
                 }
                 break;
-                
-            case INVOKEVIRTUAL:
-                if (execute_invokevirtual(jvm, frame) != 0) {
-                    return -1;
+            case ILOAD_ICONST_IF_ICMPGT:
+                if (frame->locals[insn->a].i > insn->b) {
+                    BRANCH_TO(insn->c);
                 }
                 break;
-                
-            case INVOKESPECIAL: {
-                uint16_t method_index = read_u2(&frame->pc);
-                (void)method_index;
-                break;
-            }
-            
-            // Object operations
-            case NEW:
-                if (execute_new(jvm, frame) != 0) {
-                    return -1;
+            case ILOAD_ICONST_IF_ICMPLE:
+                if (frame->locals[insn->a].i <= insn->b) {
+                    BRANCH_TO(insn->c);
                 }
                 break;
                 
-            case GETSTATIC: {
-                uint16_t field_index = read_u2(&frame->pc);
-                (void)field_index;
-                push_ref(frame, (void*)0x1);
-                break;
-            }
             
             default:
                 return -1;
         }
+        continue;
+        
+    unwind:
+        // Exceptions transfer to the first matching handler with the
+        // exception alone on the operand stack, or leave the method
+        if (status < 0) {
+            return -1;
+        }
+        const ExceptionHandler* handler = find_exception_handler(jvm, frame, jvm->exception);
+        if (!handler) {
+            return status;
+        }
+        frame->stack_top = 0;
+        push_ref(frame, jvm->exception);
+        jvm->exception = NULL;
+        frame->pc = code + handler->handler;
     }
     return 0;
 }
@@ -1206,13 +1535,14 @@ int jvm_execute_method(JVM* jvm, const char* class_name, const char* method_name
         return -1;
     }
     
-    ClassInfo* class_info = find_class(jvm, class_name);
+    const ClassInfo* class_info = find_class(jvm, class_name);
     if (!class_info) {
         return -1;
     }
     
-    MethodInfo* method = find_method(class_info, method_name);
-    if (!method) {
+    const MethodInfo* method = find_method(class_info, method_name);
+    if (!method || !method->instructions ||
+        method->max_locals > MAX_LOCALS_SIZE || method->max_stack > MAX_STACK_SIZE) {
         return -1;
     }
     
@@ -1221,10 +1551,70 @@ int jvm_execute_method(JVM* jvm, const char* class_name, const char* method_name
     frame.locals = jvm->locals_memory;
     frame.operand_stack = jvm->stack_memory;
     frame.stack_top = 0;
-    frame.pc = method->code;
+    frame.pc = method->instructions;
     frame.method = method;
     frame.class_info = class_info;
     jvm->current_frame = &frame;
     
-    return execute_bytecode(jvm, &frame);
-}
\ No newline at end of file
+    safepoint_attach(jvm);
+    int status = execute_bytecode(jvm, &frame);
+    safepoint_detach(jvm);
+    if (status == JVM_EXCEPTION_PENDING) {
+        fprintf(jvm->err, "Exception in thread \"main\" ");
+        jvm_print_stack_trace(jvm, jvm->exception);
+        jvm->exception = NULL;
+    }
+    
+    // The program ends when main and the threads it started have
+    jvm_wait_for_threads(jvm);
+    if (status != 0) {
+        return -1;
+    }
+    if (descriptor_return_type(method->descriptor) == 'I') {
+        return frame.return_value.i;
+    }
+    return 0;
+}
+
+// Bottom frame of every thread other than main, as Thread.run is in Java
+static Instruction thread_run_code[] = {{.opcode = RETURN}};
+static const MethodInfo thread_run_method = {
+    .name = "run",
+    .descriptor = "()V",
+    .max_stack = 1,
+    .instructions_count = 1,
+    .instructions = thread_run_code,
+};
+static const ClassInfo thread_class = {.name = "java/lang/Thread"};
+
+// Run the Runnable of a thread on the thread's own context. An exception
+// it does not catch ends the thread and is printed, as Java's default
+// handler does.
+int jvm_run_thread(JVM* jvm, JThread* thread) {
+    const JLambda* target = (const JLambda*)thread->target;
+    if (!target || target->header.kind != OBJECT_LAMBDA ||
+        strcmp(target->vtable->name, "run") != 0 || strcmp(target->vtable->descriptor, "()V") != 0) {
+        return 0;
+    }
+    
+    Frame frame;
+    memset(&frame, 0, sizeof(Frame));
+    frame.locals = jvm->locals_memory;
+    frame.operand_stack = jvm->stack_memory;
+    frame.pc = thread_run_method.instructions;
+    frame.method = &thread_run_method;
+    frame.class_info = &thread_class;
+    jvm->current_frame = &frame;
+    
+    push_ref(&frame, (void*)target);
+    safepoint_attach(jvm);
+    int status = invoke_lambda(jvm, &frame, target, 0);
+    safepoint_detach(jvm);
+    if (status == JVM_EXCEPTION_PENDING) {
+        fprintf(jvm->err, "Exception in thread \"Thread-%u\" ", (unsigned)thread->id);
+        jvm_print_stack_trace(jvm, jvm->exception);
+        jvm->exception = NULL;
+        return 0;
+    }
+    return status;
+}
@@ -4,6 +4,9 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "opcodes.h"
 
 // Core constants
 #define MAX_STACK_SIZE 2048
@@ -11,8 +14,17 @@
 #define MAX_CODE_SIZE 8192
 #define MAX_CONSTANT_POOL_SIZE 256
 #define MAX_CLASSES 32
-#define MAX_STRING_POOL 256
 #define MAX_STRING_LENGTH 1024
+#define INTERN_TABLE_INITIAL_CAPACITY 64
+
+// Access flags
+#define ACC_PUBLIC 0x0001
+#define ACC_PRIVATE 0x0002
+#define ACC_STATIC 0x0008
+#define ACC_FINAL 0x0010
+#define ACC_SYNCHRONIZED 0x0020
+#define ACC_NATIVE 0x0100
+#define ACC_ABSTRACT 0x0400
 
 // Java data types
 typedef int32_t jint;
@@ -38,12 +50,18 @@ enum ConstantType {
     CONST_CLASS = 7,
     CONST_FIELDREF = 9,
     CONST_METHODREF = 10,
+    CONST_INTERFACE_METHODREF = 11,
+    CONST_NAME_AND_TYPE = 12,
     CONST_STRING = 8,
     CONST_INTEGER = 3,
     CONST_FLOAT = 4,
     CONST_LONG = 5,
     CONST_DOUBLE = 6,
-    CONST_UTF8 = 1
+    CONST_UTF8 = 1,
+    CONST_METHOD_HANDLE = 15,
+    CONST_METHOD_TYPE = 16,
+    CONST_DYNAMIC = 17,
+    CONST_INVOKE_DYNAMIC = 18
 };
 
 // Constant pool entry
@@ -52,7 +70,7 @@ typedef struct {
     union {
         struct {
             uint16_t string_index;
-        } class_info;
+        } class_info;           // Also String and MethodType constants
         struct {
             uint16_t class_index;
             uint16_t name_and_type_index;
@@ -63,13 +81,119 @@ typedef struct {
         struct {
             jfloat value;
         } float_info;
+        struct {
+            jlong value;
+        } long_info;
+        struct {
+            jdouble value;
+        } double_info;
         struct {
             const char* bytes;
             uint16_t length;
         } utf8_info;
+        struct {
+            uint8_t reference_kind;
+            uint16_t reference_index;
+        } method_handle_info;
+        struct {
+            uint16_t bootstrap_method_index;
+            uint16_t name_and_type_index;
+        } dynamic_info;         // Dynamic and InvokeDynamic constants
     };
 } ConstantPoolEntry;
 
+// MethodHandle reference kinds of method targets
+#define REF_INVOKE_VIRTUAL 5
+#define REF_INVOKE_STATIC 6
+#define REF_INVOKE_SPECIAL 7
+#define REF_NEW_INVOKE_SPECIAL 8
+#define REF_INVOKE_INTERFACE 9
+
+// Entry of the BootstrapMethods attribute
+typedef struct {
+    uint16_t method_handle;     // MethodHandle constant of the bootstrap method
+    uint16_t arguments_count;
+    uint16_t* arguments;        // Static arguments, as loadable constants
+} BootstrapMethod;
+
+// Piece of a string concatenation: constant text, or an argument
+typedef struct {
+    struct JString* constant;   // Interned text, or NULL for an argument
+    char type;                  // Argument type as a descriptor character
+    uint16_t slot;              // Argument offset in operand stack slots
+} ConcatPart;
+
+typedef enum {
+    CALL_SITE_UNLINKED,         // Throws BootstrapMethodError when executed
+    CALL_SITE_CONCAT,           // StringConcatFactory recipe
+    CALL_SITE_LAMBDA            // LambdaMetafactory lambda or method reference
+} CallSiteKind;
+
+// invokedynamic call site linked at load time; the instruction's operand a
+// indexes the method's call sites
+typedef struct {
+    CallSiteKind kind;
+    uint16_t constant_index;    // InvokeDynamic constant
+    uint16_t argument_slots;
+    const char* error;          // Why an unlinked site failed to link
+    uint16_t parts_count;
+    ConcatPart* parts;
+    struct LambdaVTable* lambda;
+    struct JObject* instance;   // Shared object of a non-capturing lambda
+} CallSite;
+
+// Pre-decoded instruction
+typedef struct {
+    uint16_t opcode;      // JVM opcode or internal opcode
+    uint16_t length;      // Length in bytes of the original bytecode
+    uint32_t offset;      // Bytecode offset of the original instruction
+    int32_t a;            // First operand (local, constant, pool index or branch target)
+    int32_t b;            // Second operand
+    int32_t c;            // Third operand
+} Instruction;
+
+// Pre-decoded tableswitch/lookupswitch; the instruction's operand a indexes
+// the method's switch tables
+typedef struct {
+    int32_t low;                // Key of targets[0] in a jump table
+    uint32_t count;             // Entries in targets (and keys)
+    int32_t default_target;     // Instruction index when no key matches
+    int32_t* targets;           // Instruction index per entry
+    int32_t* keys;              // Sorted keys, or the key of each hash slot
+    uint32_t hash_multiplier;   // Non-zero when keys form a perfect hash
+    uint8_t hash_shift;
+} SwitchTable;
+
+// Exception table entry of a Code attribute, in bytecode offsets
+typedef struct {
+    uint16_t start_pc;
+    uint16_t end_pc;
+    uint16_t handler_pc;
+    uint16_t catch_type;        // Class constant, or 0 to catch everything
+} ExceptionTableEntry;
+
+// Pre-decoded exception handler covering instructions [start, end)
+typedef struct {
+    int32_t start;
+    int32_t end;
+    int32_t handler;
+    uint16_t catch_type;
+} ExceptionHandler;
+
+// Instructions from start up to the next range are covered by count
+// handlers, listed from first in exception_range_handlers in table order
+typedef struct {
+    int32_t start;
+    uint32_t first;
+    uint16_t count;
+} ExceptionRange;
+
+// LineNumberTable entry
+typedef struct {
+    uint16_t start_pc;
+    uint16_t line_number;
+} LineNumberEntry;
+
 // Method information
 typedef struct {
     uint16_t access_flags;
@@ -79,251 +203,411 @@ typedef struct {
     uint16_t max_locals;
     uint32_t code_length;
     uint8_t* code;
+    uint32_t stack_map_table_length;
+    uint8_t* stack_map_table;
+    uint16_t exception_table_length;
+    ExceptionTableEntry* exception_table;
+    uint16_t line_numbers_count;
+    LineNumberEntry* line_numbers;
+    uint32_t instructions_count;
+    Instruction* instructions;
+    uint32_t switch_tables_count;
+    SwitchTable* switch_tables;
+    uint16_t exception_handlers_count;
+    ExceptionHandler* exception_handlers;
+    uint32_t exception_ranges_count;
+    ExceptionRange* exception_ranges;
+    uint16_t* exception_range_handlers;
+    uint16_t call_sites_count;
+    CallSite* call_sites;
 } MethodInfo;
 
+// Native method function type: args are the caller's argument slots, the
+// receiver first for instance methods, and result receives the return
+// value. Returns 0, -1 on error or JVM_EXCEPTION_PENDING.
+struct JVM;
+struct Frame;
+typedef int (*NativeMethod)(struct JVM* jvm, struct Frame* frame, jvalue* args, jvalue* result);
+
+// Critical native of a loaded library: a leaf taking only the argument
+// slots of a static method, which cannot call back into the VM or throw
+typedef void (*CriticalNativeMethod)(const jvalue* args, jvalue* result);
+
+// Native method a Methodref constant resolves to, bound at link time
+typedef struct {
+    NativeMethod function;      // NULL when the method has no native
+    CriticalNativeMethod critical;  // Called instead of function when set
+    uint16_t argument_slots;    // Not counting the receiver
+    uint8_t result_slots;
+    bool leaves_java;           // Runs outside Java, counted as stopped at a
+                                // safepoint: it blocks, or is a library's
+} NativeBinding;
+
 // Class information
 typedef struct {
     const char* name;
+    const char* super_name;
+    const char* source_file;
+    uint16_t major_version;
     uint16_t constant_pool_count;
     ConstantPoolEntry* constant_pool;
+    jvalue* constants;          // Resolved constants by pool index: numbers
+                                // unboxed, strings interned at link time
+    NativeBinding* native_bindings;  // Natives bound by pool index at link time
     uint16_t methods_count;
     MethodInfo* methods;
+    uint16_t bootstrap_methods_count;
+    BootstrapMethod* bootstrap_methods;
+    struct JObject* class_object;  // Locked by static synchronized methods
 } ClassInfo;
 
-// Execution frame
-typedef struct {
+// Dispatch table of the functional objects a lambda call site creates: the
+// interface's one abstract method and the target it forwards to
+typedef struct LambdaVTable {
+    char* interface_name;       // Functional interface, the objects' class
+    const char* name;           // Interface method name
+    const char* descriptor;     // Erased interface method descriptor
+    const ClassInfo* class_info;  // Class of the call site
+    const MethodInfo* method;   // Target in class_info, or NULL for a builtin
+    uint16_t method_ref;        // Target member ref in class_info's pool
+    uint8_t reference_kind;     // How the target is invoked
+    uint8_t discarded_slots;    // Result of a target whose interface returns void
+    uint16_t captured_slots;
+} LambdaVTable;
+
+// Execution frame; frames form a stack through their callers
+typedef struct Frame {
+    struct Frame* caller;
     jvalue* locals;
     jvalue* operand_stack;
     uint16_t stack_top;
-    uint8_t* pc;
-    MethodInfo* method;
-    ClassInfo* class_info;
+    const Instruction* pc;
+    const MethodInfo* method;
+    const ClassInfo* class_info;
+    jvalue return_value;
 } Frame;
 
-// String structure
-typedef struct {
-    char* data;
-    size_t length;
-    size_t capacity;
+// Layout of a heap object after its header
+typedef enum {
+    OBJECT_PLAIN,
+    OBJECT_STRING,
+    OBJECT_STRING_BUILDER,
+    OBJECT_THROWABLE,
+    OBJECT_LAMBDA,
+    OBJECT_BOX,
+    OBJECT_ARRAY_LIST,
+    OBJECT_LIST_ITERATOR,
+    OBJECT_HASH_MAP,
+    OBJECT_THREAD,
+    OBJECT_ATOMIC
+} ObjectKind;
+
+// Heap object header
+typedef struct JObject {
+    struct JObject* next;       // Next allocated object
+    const char* class_name;
+    ObjectKind kind;
+    uintptr_t lock;             // Lock word, see monitors.h
+} JObject;
+
+// String coders: Latin-1 bytes, or UTF-16 code units when any character
+// is outside Latin-1
+#define STRING_LATIN1 0
+#define STRING_UTF16 1
+
+// java.lang.String: immutable, with the characters stored inline
+typedef struct JString {
+    JObject header;
+    uint32_t length;            // Length in characters
+    int32_t hash;               // Cached hashCode, 0 until computed
+    uint8_t coder;
+    uint8_t value[];            // length bytes, or 2 * length for UTF-16
 } JString;
 
-// String pool
+// Intern table of canonical strings, open addressing with linear probing
 typedef struct {
-    JString strings[MAX_STRING_POOL];
+    int32_t hash;
+    JString* string;
+} InternEntry;
+
+typedef struct {
+    InternEntry* entries;
+    size_t capacity;            // Power of two, or 0 before the first string
     size_t count;
-} StringPool;
+} InternTable;
 
-// Forward declaration for NativeMethod
-struct JVM;
+// Memory of the objects of an instance, in chunks that live until it is
+// destroyed; its threads carve their allocation buffers from the current
+// chunk under the lock
+typedef struct HeapChunk HeapChunk;
 
-// Native method function type
-typedef int (*NativeMethod)(struct JVM* jvm, jvalue* args, int arg_count);
+typedef struct {
+    pthread_mutex_t lock;
+    HeapChunk* chunks;          // Newest first
+    uint8_t* top;               // Free space of the current chunk
+    uint8_t* end;
+} Heap;
 
-// Native method entry
+// java.lang.StringBuilder: a growable character buffer, Latin-1 until a
+// character outside Latin-1 is appended
 typedef struct {
-    const char* class_name;
+    JObject header;
+    uint8_t* value;
+    uint32_t length;            // Length in characters
+    uint32_t capacity;          // Capacity in characters
+    uint8_t coder;
+} JStringBuilder;
+
+// Frame recorded when an exception is thrown; line numbers are looked up
+// only when the stack trace is printed
+typedef struct {
+    const ClassInfo* class_info;
+    const MethodInfo* method;
+    uint32_t offset;            // Bytecode offset of the executing instruction
+} BacktraceEntry;
+
+// java.lang.Throwable and its subclasses
+typedef struct {
+    JObject header;
+    JString* message;
+    const char* detail;         // Message of exceptions raised by the VM
+    uint16_t backtrace_depth;
+    BacktraceEntry* backtrace;
+} JThrowable;
+
+// Functional interface object of a lambda or method reference, holding
+// the values its call site captured
+typedef struct {
+    JObject header;
+    const LambdaVTable* vtable;
+    jvalue captured[];
+} JLambda;
+
+// Wrapper of a primitive value: Integer, Long, Short, Byte, Character,
+// Boolean, Float or Double
+typedef struct {
+    JObject header;
+    char type;                  // Wrapped type as a descriptor character
+    jvalue value;
+} JBox;
+
+// java.util.ArrayList: a growable array of references
+typedef struct {
+    JObject header;
+    JObject** elements;
+    uint32_t size;
+    uint32_t capacity;
+    uint32_t mod_count;         // Structural changes, checked by iterators
+} JArrayList;
+
+// Iterator of an ArrayList
+typedef struct {
+    JObject header;
+    JArrayList* list;
+    uint32_t cursor;
+    uint32_t expected_mod_count;
+} JListIterator;
+
+// Key and value of a HashMap slot, with the key's hashCode
+typedef struct {
+    JObject* key;
+    JObject* value;
+    int32_t hash;
+} MapSlot;
+
+// java.util.HashMap: open addressing over groups of MAP_GROUP_SIZE slots.
+// Each slot has a control byte holding 7 bits of its key's hash when full,
+// so a whole group is matched against a key with one vector compare.
+typedef struct {
+    JObject header;
+    uint8_t* control;           // Control byte per slot
+    MapSlot* slots;
+    uint32_t capacity;          // Power of two, at least MAP_GROUP_SIZE, or 0
+    uint32_t size;
+    uint32_t growth_left;       // Insertions into empty slots before growing
+} JHashMap;
+
+#define MAP_GROUP_SIZE 16
+
+// Life cycle of a java.lang.Thread
+typedef enum {
+    THREAD_NEW,
+    THREAD_RUNNABLE,
+    THREAD_TERMINATED
+} ThreadState;
+
+// java.lang.Thread, run as a green thread by the runtime's scheduler. The
+// state and joiners are guarded by the lock of the instance's main thread.
+typedef struct JThread {
+    JObject header;
+    JObject* target;            // Runnable passed to the constructor
+    uint32_t id;                // Number in the default name Thread-<id>
+    ThreadState state;
+    struct GreenThread* joiners;  // Green threads waiting in join
+} JThread;
+
+// java.util.concurrent.atomic.AtomicInteger, AtomicLong or AtomicReference,
+// whose value the atomic intrinsics access in place
+typedef struct {
+    JObject header;
+    char type;                  // Value type as a descriptor character
+    jvalue value;
+} JAtomic;
+
+// Wrapper classes with preallocated boxes
+#define BOX_CLASSES_COUNT 8
+
+// Native method registry entry, in an open-addressing table keyed by
+// (class, name, descriptor); the key strings are copied into one block
+typedef struct {
+    const char* class_name;     // Start of the key block, NULL when empty
     const char* method_name;
     const char* descriptor;
     NativeMethod function;
+    uint32_t hash;
+    bool leaves_java;           // Blocks, so runs outside Java
 } NativeMethodEntry;
 
-// Main JVM structure
+// Smallest capacity of the native method registry, a power of two
+#define NATIVE_METHODS_MIN_CAPACITY 64
+
+// Execution state of one interpreter instance, or of one Java thread of
+// it. Instances only read the classes and natives of their runtime, so
+// instances sharing a runtime can run on separate threads. The threads of
+// an instance share the intern table, libraries and thread bookkeeping of
+// its main thread, under that thread's lock; the rest is their own.
 typedef struct JVM {
+    const struct Runtime* runtime;
+    struct JVM* main;           // Main thread of the instance, itself there
+    struct GreenThread* green;  // Green thread running this context, or NULL
+    int32_t backedge_budget;    // Backward branches left before yielding
+    uintptr_t lock_owner;       // Owner field of the lock words this thread holds
+    int safepoint_state;        // Whether the thread runs Java code
+    struct JVM* safepoint_prev; // Neighbours among the threads safepoints stop
+    struct JVM* safepoint_next;
+    Frame* current_frame;
+    jvalue* stack_memory;       // MAX_STACK_SIZE slots
+    jvalue* locals_memory;      // MAX_LOCALS_SIZE slots
+    uint8_t* tlab_top;          // Free space of the thread's allocation buffer
+    uint8_t* tlab_end;
+    size_t tlab_size;           // Size of the next buffer, 0 before the first
+    Heap heap;                  // Memory of the instance's objects
+    JObject* objects;           // All allocated objects
+    JThrowable* exception;      // Exception being thrown, while unwinding
+    InternTable intern_table;   // Strings interned by this instance
+    JBox* box_cache;            // Shared boxes of small values, one block
+    JBox* box_caches[BOX_CLASSES_COUNT];  // Start of each wrapper's boxes
+    FILE* out;                  // System.out
+    FILE* in;                   // System.in
+    FILE* err;                  // System.err and uncaught exceptions
+    JObject* system_out;        // Objects getstatic reads for System.out,
+    JObject* system_in;         // System.in and System.err, so that they
+    JObject* system_err;        // can be locked like any object
+    void** libraries;           // Handles of the loaded native libraries
+    size_t libraries_count;
+    NativeBinding* library_bindings[MAX_CLASSES];  // Natives bound from the libraries,
+                                                   // per class and member ref
+    pthread_mutex_t lock;
+    pthread_cond_t thread_ended;  // Signalled as each started thread ends
+    uint32_t threads_created;
+    uint32_t threads_running;   // Started threads that have not ended
+} JVM;
+
+// Classes and native methods loaded once and shared by JVM instances.
+// Loading classes and registering natives must finish before instances
+// start; the runtime is read-only while they run.
+typedef struct Runtime {
     ClassInfo classes[MAX_CLASSES];
     uint16_t classes_count;
-    Frame* current_frame;
-    jvalue stack_memory[MAX_STACK_SIZE];
-    jvalue locals_memory[MAX_LOCALS_SIZE];
-    uint8_t heap[8192];
-    size_t heap_used;
-    StringPool string_pool;
     NativeMethodEntry* native_methods;
     size_t native_methods_count;
-} JVM;
+    size_t native_methods_capacity;
+    const char* library_path;   // java.library.path, or NULL for the default
+    struct Scheduler* scheduler;  // Runs the Java threads of all instances
+    JVM loader;                 // Owns the objects created while linking, such as
+                                // string constants, and their intern table
+} Runtime;
 
-// Additional opcodes
-enum AdditionalOpCodes {
-    GETSTATIC = 0xb2,
-    PUTSTATIC = 0xb3,
-    GETFIELD = 0xb4,
-    PUTFIELD = 0xb5,
-    INVOKEINTERFACE = 0xb9,
-    INVOKESPECIAL = 0xb7
+// JVM opcodes
+enum OpCode {
+#define OPCODE_ENUM(name, code, format, pops, pushes, kind, type, op) name = code,
+    JVM_OPCODES(OPCODE_ENUM)
+#undef OPCODE_ENUM
 };
 
-// Main opcodes
-enum OpCode {
-    // Constants
-    NOP = 0x00,
-    ACONST_NULL = 0x01,
-    ICONST_M1 = 0x02,
-    ICONST_0 = 0x03,
-    ICONST_1 = 0x04,
-    ICONST_2 = 0x05,
-    ICONST_3 = 0x06,
-    ICONST_4 = 0x07,
-    ICONST_5 = 0x08,
-    LCONST_0 = 0x09,
-    LCONST_1 = 0x0a,
-    FCONST_0 = 0x0b,
-    FCONST_1 = 0x0c,
-    FCONST_2 = 0x0d,
-    DCONST_0 = 0x0e,
-    DCONST_1 = 0x0f,
-    
-    // Load constants
-    BIPUSH = 0x10,
-    SIPUSH = 0x11,
-    LDC = 0x12,
-    
-    // Load from locals
-    ILOAD = 0x15,
-    LLOAD = 0x16,
-    FLOAD = 0x17,
-    DLOAD = 0x18,
-    ALOAD = 0x19,
-    ILOAD_0 = 0x1a,
-    ILOAD_1 = 0x1b,
-    ILOAD_2 = 0x1c,
-    ILOAD_3 = 0x1d,
-    ALOAD_0 = 0x2a,
-    ALOAD_1 = 0x2b,
-    ALOAD_2 = 0x2c,
-    ALOAD_3 = 0x2d,
-    
-    // Store to locals
-    ISTORE = 0x36,
-    LSTORE = 0x37,
-    FSTORE = 0x38,
-    DSTORE = 0x39,
-    ASTORE = 0x3a,
-    ISTORE_0 = 0x3b,
-    ISTORE_1 = 0x3c,
-    ISTORE_2 = 0x3d,
-    ISTORE_3 = 0x3e,
-    ASTORE_0 = 0x4b,
-    ASTORE_1 = 0x4c,
-    ASTORE_2 = 0x4d,
-    ASTORE_3 = 0x4e,
-    
-    // Stack operations
-    DUP = 0x59,
-    POP = 0x57,
-    SWAP = 0x5f,
-    
-    // Arithmetic operations
-    IADD = 0x60,
-    LADD = 0x61,
-    FADD = 0x62,
-    DADD = 0x63,
-    ISUB = 0x64,
-    LSUB = 0x65,
-    FSUB = 0x66,
-    DSUB = 0x67,
-    IMUL = 0x68,
-    LMUL = 0x69,
-    FMUL = 0x6a,
-    DMUL = 0x6b,
-    IDIV = 0x6c,
-    LDIV = 0x6d,
-    FDIV = 0x6e,
-    DDIV = 0x6f,
-    IREM = 0x70,
-    LREM = 0x71,
-    FREM = 0x72,
-    DREM = 0x73,
-    INEG = 0x74,
-    LNEG = 0x75,
-    FNEG = 0x76,
-    DNEG = 0x77,
-    
-    // Bitwise operations
-    IAND = 0x7e,
-    IOR = 0x80,
-    IXOR = 0x82,
-    
-    // Type conversions
-    I2L = 0x85,
-    I2F = 0x86,
-    I2D = 0x87,
-    L2I = 0x88,
-    L2F = 0x89,
-    L2D = 0x8a,
-    F2I = 0x8b,
-    F2L = 0x8c,
-    F2D = 0x8d,
-    D2I = 0x8e,
-    D2L = 0x8f,
-    D2F = 0x90,
-    
-    // Comparisons
-    LCMP = 0x94,
-    FCMPL = 0x95,
-    FCMPG = 0x96,
-    DCMPL = 0x97,
-    DCMPG = 0x98,
-    
-    // Conditional branches
-    IFEQ = 0x99,
-    IFNE = 0x9a,
-    IFLT = 0x9b,
-    IFGE = 0x9c,
-    IFGT = 0x9d,
-    IFLE = 0x9e,
-    IF_ICMPEQ = 0x9f,
-    IF_ICMPNE = 0xa0,
-    IF_ICMPLT = 0xa1,
-    IF_ICMPGE = 0xa2,
-    IF_ICMPGT = 0xa3,
-    IF_ICMPLE = 0xa4,
-    
-    // Control flow
-    GOTO = 0xa7,
-    
-    // Method returns
-    IRETURN = 0xac,
-    LRETURN = 0xad,
-    FRETURN = 0xae,
-    DRETURN = 0xaf,
-    ARETURN = 0xb0,
-    RETURN = 0xb1,
-    
-    // Method invocations
-    INVOKEVIRTUAL = 0xb6,
-    INVOKESTATIC = 0xb8,
-    
-    // Object operations
-    NEW = 0xbb
+// Internal opcodes produced by the decoder and optimizer
+enum InternalOpCode {
+    ICONST = 0x100,                 // push a
+    ILOAD_ILOAD_IADD_ISTORE,        // locals[c] = locals[a] + locals[b]
+    ILOAD_ILOAD_ISUB_ISTORE,        // locals[c] = locals[a] - locals[b]
+    ILOAD_ILOAD_IMUL_ISTORE,        // locals[c] = locals[a] * locals[b]
+    ILOAD_ICONST_IF_ICMPEQ,         // if (locals[a] == b) goto c
+    ILOAD_ICONST_IF_ICMPNE,
+    ILOAD_ICONST_IF_ICMPLT,
+    ILOAD_ICONST_IF_ICMPGE,
+    ILOAD_ICONST_IF_ICMPGT,
+    ILOAD_ICONST_IF_ICMPLE,
+    LDC_CONST,                      // push constants[a] (float or string)
+    BOX,                            // valueOf of primitive type a
+    UNBOX,                          // xxxValue returning primitive type a
+    INVOKE_NATIVE,                  // native bound to member ref a; b = has receiver
+#define INTRINSIC_ENUM(name, class_name, method, descriptor, pops, pushes, kind, type, result, op) name,
+    MATH_INTRINSICS(INTRINSIC_ENUM)
+#undef INTRINSIC_ENUM
+#define ATOMIC_ENUM(name, class_name, method, descriptor, pops, pushes, kind, type, op) name,
+    ATOMIC_INTRINSICS(ATOMIC_ENUM)
+#undef ATOMIC_ENUM
 };
 
+// Status returned while an exception unwinds the frame stack; errors are -1
+#define JVM_EXCEPTION_PENDING 1
+
+// Runtime API functions
+int runtime_init(Runtime* runtime);
+int runtime_load_class(Runtime* runtime, const ClassInfo* class_info);
+void runtime_destroy(Runtime* runtime);
+
 // Core JVM API functions
-int jvm_init(JVM* jvm);
-int jvm_load_class(JVM* jvm, const ClassInfo* class_info);
+int jvm_init(JVM* jvm, const Runtime* runtime);
 int jvm_execute_method(JVM* jvm, const char* class_name, const char* method_name);
+int jvm_run_thread(JVM* jvm, JThread* thread);
 void jvm_destroy(JVM* jvm);
 
 // String and native method functions
-int jvm_register_native_method(JVM* jvm, const char* class_name,
-                              const char* method_name, const char* descriptor,
-                              NativeMethod function);
+int runtime_register_native_method(Runtime* runtime, const char* class_name,
+                                   const char* method_name, const char* descriptor,
+                                   NativeMethod function);
+int runtime_register_blocking_native_method(Runtime* runtime, const char* class_name,
+                                            const char* method_name, const char* descriptor,
+                                            NativeMethod function);
+NativeMethod runtime_find_native_method(const Runtime* runtime, const char* class_name,
+                                        const char* method_name, const char* descriptor);
+int init_native_binding(NativeBinding* binding, const char* descriptor);
+int bind_native_methods(const Runtime* runtime, ClassInfo* class_info);
 JString* jvm_create_string(JVM* jvm, const char* str);
+JString* jvm_intern_string(JVM* jvm, JString* str);
+JObject* jvm_alloc_object(JVM* jvm, const char* class_name, size_t size);
 void jvm_print_string(JVM* jvm, JString* str);
 int jvm_read_int(JVM* jvm);
 char* jvm_read_line(JVM* jvm);
+void format_double(char* buffer, size_t size, jdouble value);
+void format_float(char* buffer, size_t size, jfloat value);
 
 // System.out native methods
-int native_system_out_print(JVM* jvm, jvalue* args, int arg_count);
-int native_system_out_println(JVM* jvm, jvalue* args, int arg_count);
-int native_system_out_print_int(JVM* jvm, jvalue* args, int arg_count);
-int native_system_out_println_int(JVM* jvm, jvalue* args, int arg_count);
-int native_system_out_println_void(JVM* jvm, jvalue* args, int arg_count);
+int native_system_out_print(JVM* jvm, Frame* frame, jvalue* args, jvalue* result);
+int native_system_out_println(JVM* jvm, Frame* frame, jvalue* args, jvalue* result);
+int native_system_out_print_int(JVM* jvm, Frame* frame, jvalue* args, jvalue* result);
+int native_system_out_println_int(JVM* jvm, Frame* frame, jvalue* args, jvalue* result);
+int native_system_out_println_long(JVM* jvm, Frame* frame, jvalue* args, jvalue* result);
+int native_system_out_println_double(JVM* jvm, Frame* frame, jvalue* args, jvalue* result);
+int native_system_out_println_void(JVM* jvm, Frame* frame, jvalue* args, jvalue* result);
 
 // Scanner native methods
-int native_scanner_init(JVM* jvm, jvalue* args, int arg_count);
-int native_scanner_next_int(JVM* jvm, jvalue* args, int arg_count);
-int native_scanner_next_line(JVM* jvm, jvalue* args, int arg_count);
+int native_scanner_init(JVM* jvm, Frame* frame, jvalue* args, jvalue* result);
+int native_scanner_next_int(JVM* jvm, Frame* frame, jvalue* args, jvalue* result);
+int native_scanner_next_line(JVM* jvm, Frame* frame, jvalue* args, jvalue* result);
 
 // Register standard native methods
-void register_standard_native_methods(JVM* jvm);
+void register_standard_native_methods(Runtime* runtime);
 
 #endif // JVM_H
\ No newline at end of file
@@ -1,12 +1,15 @@
 #include "jvm.h"
 #include "class_loader.h"
+#include "safepoints.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 // Print usage information
 void print_usage(const char* program_name) {
-    printf("Usage: %s <class_file> [method_name]\n", program_name);
+    printf("Usage: %s [-Djava.library.path=<dirs>] [-Xlog:safepoint] <class_file> [method_name]\n", program_name);
+    printf("  dirs        - Directories searched by System.loadLibrary, ':' separated\n");
+    printf("  -Xlog:safepoint - Print the time threads took to reach safepoints on exit\n");
     printf("  class_file  - Path to .class file\n");
     printf("  method_name - Method to execute (default: main)\n");
     printf("\n");
@@ -95,13 +98,27 @@ int find_method_by_name(const LoadedClass* loaded_class, const char* method_name
 
 // Main entry point
 int main(int argc, char* argv[]) {
-    if (argc < 2) {
+    // Options come first: system properties as -D<name>=<value>, of
+    // which only java.library.path is used, and -Xlog:safepoint
+    const char* library_path = NULL;
+    bool log_safepoints = false;
+    int arg = 1;
+    while (arg < argc && (strncmp(argv[arg], "-D", 2) == 0 || strcmp(argv[arg], "-Xlog:safepoint") == 0)) {
+        if (strncmp(argv[arg], "-Djava.library.path=", 20) == 0) {
+            library_path = argv[arg] + 20;
+        } else if (strcmp(argv[arg], "-Xlog:safepoint") == 0) {
+            log_safepoints = true;
+        }
+        arg++;
+    }
+
+    if (arg >= argc) {
         print_usage(argv[0]);
         return 1;
     }
 
-    const char* class_file = argv[1];
-    const char* method_name = (argc >= 3) ? argv[2] : "main";
+    const char* class_file = argv[arg];
+    const char* method_name = (arg + 1 < argc) ? argv[arg + 1] : "main";
 
     // Load .class file
     LoadedClass loaded_class;
@@ -118,22 +135,27 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    // Initialize JVM
-    JVM jvm;
-    if (jvm_init(&jvm) != 0) {
+    // Initialize the runtime, which holds the loaded classes and natives
+    // shared by JVM instances
+    Runtime* runtime = malloc(sizeof(Runtime));
+    if (!runtime || runtime_init(runtime) != 0) {
         printf("Error: Failed to initialize JVM\n");
+        free(runtime);
         free_jvm_class(&jvm_class);
         free_loaded_class(&loaded_class);
         return 1;
     }
 
     // Register standard native methods
-    register_standard_native_methods(&jvm);
+    runtime->library_path = library_path;
+    register_standard_native_methods(runtime);
 
-    // Load class into JVM
-    if (jvm_load_class(&jvm, &jvm_class) != 0) {
+    // Load class into the runtime, then start an instance running it
+    JVM jvm;
+    if (runtime_load_class(runtime, &jvm_class) != 0 || jvm_init(&jvm, runtime) != 0) {
         printf("Error: Failed to load class into JVM\n");
-        jvm_destroy(&jvm);
+        runtime_destroy(runtime);
+        free(runtime);
         free_jvm_class(&jvm_class);
         free_loaded_class(&loaded_class);
         return 1;
@@ -154,6 +176,8 @@ int main(int argc, char* argv[]) {
             }
         }
         jvm_destroy(&jvm);
+        runtime_destroy(runtime);
+        free(runtime);
         free_jvm_class(&jvm_class);
         free_loaded_class(&loaded_class);
         return 1;
@@ -161,9 +185,18 @@ int main(int argc, char* argv[]) {
 
     // Execute method
     int result = jvm_execute_method(&jvm, jvm_class.name, method_name);
+    if (log_safepoints) {
+        SafepointStatistics statistics;
+        safepoint_get_statistics(&statistics);
+        fprintf(stderr, "Safepoints: %llu, time to safepoint: total %.3f ms, max %.3f ms\n",
+                (unsigned long long)statistics.count, statistics.total_nanos / 1e6,
+                statistics.max_nanos / 1e6);
+    }
 
     // Cleanup resources
     jvm_destroy(&jvm);
+    runtime_destroy(runtime);
+    free(runtime);
     free_jvm_class(&jvm_class);
     free_loaded_class(&loaded_class);
 
@@ -0,0 +1,314 @@
+#include "monitors.h"
+#include "exceptions.h"
+#include "threads.h"
+#include "safepoints.h"
+#include <stdlib.h>
+
+// Thread blocked on a monitor, linked from the stack it blocks on
+typedef struct Waiter {
+    uintptr_t owner;            // lock_owner of the thread
+    GreenThread* green;         // Green thread to unpark, or NULL
+    bool ready;                 // Handed the monitor
+    struct Waiter* next;
+} Waiter;
+
+typedef struct {
+    Waiter* first;
+    Waiter* last;
+} WaiterQueue;
+
+// Inflated lock: a mutex guarding the owner, with the threads waiting to
+// enter and those waiting for a notify
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t handed_off;  // Signalled when a thread outside the
+                                // scheduler is handed the monitor
+    uintptr_t owner;            // lock_owner of the owner, or 0
+    uint32_t count;             // Acquisitions by the owner
+    WaiterQueue entrants;
+    WaiterQueue waiting;        // Wait set, in notify order
+} Monitor;
+
+// Owners of the locks held by threads of all instances, which can share
+// objects such as string constants
+static uintptr_t lock_owners;
+
+// Lock owner of a new thread
+uintptr_t lock_owner_new(void) {
+    return __atomic_add_fetch(&lock_owners, 1, __ATOMIC_RELAXED) << LOCK_OWNER_SHIFT;
+}
+
+static void waiter_queue_push(WaiterQueue* queue, Waiter* waiter) {
+    waiter->next = NULL;
+    if (queue->last) {
+        queue->last->next = waiter;
+    } else {
+        queue->first = waiter;
+    }
+    queue->last = waiter;
+}
+
+static Waiter* waiter_queue_take(WaiterQueue* queue) {
+    Waiter* waiter = queue->first;
+    if (waiter) {
+        queue->first = waiter->next;
+        if (!queue->first) {
+            queue->last = NULL;
+        }
+    }
+    return waiter;
+}
+
+static inline Monitor* word_monitor(uintptr_t word) {
+    return (Monitor*)(word & ~(uintptr_t)LOCK_INFLATED);
+}
+
+// Replace a thin lock word by a monitor in the same state. Returns 0 with
+// *word updated, 1 if the word changed meanwhile, leaving its new value in
+// *word, or -1 when out of memory.
+static int inflate(JObject* object, uintptr_t* word) {
+    Monitor* monitor = calloc(1, sizeof(Monitor));
+    if (!monitor) {
+        return -1;
+    }
+    pthread_mutex_init(&monitor->lock, NULL);
+    pthread_cond_init(&monitor->handed_off, NULL);
+    if (*word != 0) {
+        monitor->owner = *word & LOCK_OWNER_MASK;
+        monitor->count = (uint32_t)((*word & LOCK_COUNT_MASK) >> LOCK_COUNT_SHIFT) + 1;
+    }
+
+    uintptr_t inflated = (uintptr_t)monitor | LOCK_INFLATED;
+    if (__atomic_compare_exchange_n(&object->lock, word, inflated, false,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        *word = inflated;
+        return 0;
+    }
+    pthread_cond_destroy(&monitor->handed_off);
+    pthread_mutex_destroy(&monitor->lock);
+    free(monitor);
+    return 1;
+}
+
+// Block with the monitor's mutex held until a releasing thread hands the
+// monitor over; returns with the mutex held
+static void wait_for_handoff(JVM* jvm, Monitor* monitor, Waiter* waiter) {
+    if (jvm->green) {
+        thread_park(jvm, &monitor->lock);
+        pthread_mutex_lock(&monitor->lock);
+        return;
+    }
+    while (!waiter->ready) {
+        pthread_cond_wait(&monitor->handed_off, &monitor->lock);
+    }
+}
+
+// Give a released monitor to the first thread waiting to enter, so that
+// threads enter in turn
+static void hand_off(JVM* jvm, Monitor* monitor) {
+    Waiter* waiter = waiter_queue_take(&monitor->entrants);
+    if (!waiter) {
+        monitor->owner = 0;
+        return;
+    }
+    monitor->owner = waiter->owner;
+    monitor->count = 1;
+    waiter->ready = true;
+    if (waiter->green) {
+        thread_unpark(jvm, waiter->green);
+    } else {
+        pthread_cond_broadcast(&monitor->handed_off);
+    }
+}
+
+static int monitor_lock(JVM* jvm, Monitor* monitor) {
+    pthread_mutex_lock(&monitor->lock);
+    if (monitor->owner == 0) {
+        monitor->owner = jvm->lock_owner;
+        monitor->count = 1;
+    } else if (monitor->owner == jvm->lock_owner) {
+        monitor->count++;
+    } else {
+        // Blocked threads count as stopped at a safepoint
+        Waiter waiter = {jvm->lock_owner, jvm->green, false, NULL};
+        waiter_queue_push(&monitor->entrants, &waiter);
+        safepoint_leave_java(jvm);
+        wait_for_handoff(jvm, monitor, &waiter);
+        pthread_mutex_unlock(&monitor->lock);
+        safepoint_enter_java(jvm);
+        return 0;
+    }
+    pthread_mutex_unlock(&monitor->lock);
+    return 0;
+}
+
+// monitorenter: uncontended, a single compare-and-swap of the lock word
+int monitor_enter(JVM* jvm, Frame* frame, JObject* object) {
+    if (!object) {
+        return jvm_throw_new(jvm, frame, "java/lang/NullPointerException", NULL);
+    }
+
+    uintptr_t owner = jvm->lock_owner;
+    uintptr_t word = 0;
+    if (__atomic_compare_exchange_n(&object->lock, &word, owner, false,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+    for (;;) {
+        if (word & LOCK_INFLATED) {
+            return monitor_lock(jvm, word_monitor(word));
+        }
+
+        uintptr_t locked;
+        if (word == 0) {
+            locked = owner;
+        } else if ((word & LOCK_OWNER_MASK) == owner && (word & LOCK_COUNT_MASK) != LOCK_COUNT_MASK) {
+            // Recursive: only the owner changes the count, but another
+            // thread may inflate the lock meanwhile
+            locked = word + ((uintptr_t)1 << LOCK_COUNT_SHIFT);
+        } else {
+            // Held by another thread, or nested too deeply: the monitor
+            // takes over the lock as it stands
+            if (inflate(object, &word) < 0) {
+                return jvm_throw_new(jvm, frame, "java/lang/OutOfMemoryError", NULL);
+            }
+            continue;
+        }
+        if (__atomic_compare_exchange_n(&object->lock, &word, locked, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+            return 0;
+        }
+    }
+}
+
+// monitorexit: uncontended, a single compare-and-swap of the lock word
+int monitor_exit(JVM* jvm, Frame* frame, JObject* object) {
+    if (!object) {
+        return jvm_throw_new(jvm, frame, "java/lang/NullPointerException", NULL);
+    }
+
+    uintptr_t owner = jvm->lock_owner;
+    uintptr_t word = owner;
+    if (__atomic_compare_exchange_n(&object->lock, &word, 0, false,
+                                    __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+    for (;;) {
+        if (word & LOCK_INFLATED) {
+            Monitor* monitor = word_monitor(word);
+            pthread_mutex_lock(&monitor->lock);
+            bool owned = monitor->owner == owner;
+            if (owned && --monitor->count == 0) {
+                hand_off(jvm, monitor);
+            }
+            pthread_mutex_unlock(&monitor->lock);
+            if (owned) {
+                return 0;
+            }
+            break;
+        }
+        if ((word & LOCK_OWNER_MASK) != owner) {
+            break;
+        }
+        // A recursive acquisition, since the word is not just the owner
+        uintptr_t released = word - ((uintptr_t)1 << LOCK_COUNT_SHIFT);
+        if (__atomic_compare_exchange_n(&object->lock, &word, released, false,
+                                        __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)) {
+            return 0;
+        }
+    }
+    return jvm_throw_new(jvm, frame, "java/lang/IllegalMonitorStateException", NULL);
+}
+
+// Monitor of an object whose lock jvm's thread holds, inflating a thin
+// lock; NULL with an exception thrown otherwise
+static Monitor* owned_monitor(JVM* jvm, Frame* frame, JObject* object) {
+    uintptr_t word = __atomic_load_n(&object->lock, __ATOMIC_ACQUIRE);
+    for (;;) {
+        if (word & LOCK_INFLATED) {
+            Monitor* monitor = word_monitor(word);
+            // Only this thread could have made itself the owner
+            pthread_mutex_lock(&monitor->lock);
+            bool owned = monitor->owner == jvm->lock_owner;
+            pthread_mutex_unlock(&monitor->lock);
+            if (owned) {
+                return monitor;
+            }
+            break;
+        }
+        if ((word & LOCK_OWNER_MASK) != jvm->lock_owner) {
+            break;
+        }
+        if (inflate(object, &word) < 0) {
+            jvm_throw_new(jvm, frame, "java/lang/OutOfMemoryError", NULL);
+            return NULL;
+        }
+    }
+    jvm_throw_new(jvm, frame, "java/lang/IllegalMonitorStateException", NULL);
+    return NULL;
+}
+
+// Object.wait(): release the lock and block until notified, then take it
+// back as many times as it was held
+int monitor_wait(JVM* jvm, Frame* frame, JObject* object) {
+    if (!object) {
+        return jvm_throw_new(jvm, frame, "java/lang/NullPointerException", NULL);
+    }
+    Monitor* monitor = owned_monitor(jvm, frame, object);
+    if (!monitor) {
+        return JVM_EXCEPTION_PENDING;
+    }
+
+    pthread_mutex_lock(&monitor->lock);
+    uint32_t count = monitor->count;
+    Waiter waiter = {jvm->lock_owner, jvm->green, false, NULL};
+    waiter_queue_push(&monitor->waiting, &waiter);
+    hand_off(jvm, monitor);
+    safepoint_leave_java(jvm);
+    wait_for_handoff(jvm, monitor, &waiter);
+    monitor->count = count;
+    pthread_mutex_unlock(&monitor->lock);
+    safepoint_enter_java(jvm);
+    return 0;
+}
+
+// Object.notify() and notifyAll(): waiting threads queue to enter again.
+// A thin lock has never been waited on, so there is nobody to notify.
+int monitor_notify(JVM* jvm, Frame* frame, JObject* object, bool all) {
+    if (!object) {
+        return jvm_throw_new(jvm, frame, "java/lang/NullPointerException", NULL);
+    }
+    uintptr_t word = __atomic_load_n(&object->lock, __ATOMIC_ACQUIRE);
+    if (!(word & LOCK_INFLATED)) {
+        if ((word & LOCK_OWNER_MASK) != jvm->lock_owner) {
+            return jvm_throw_new(jvm, frame, "java/lang/IllegalMonitorStateException", NULL);
+        }
+        return 0;
+    }
+
+    Monitor* monitor = word_monitor(word);
+    pthread_mutex_lock(&monitor->lock);
+    bool owned = monitor->owner == jvm->lock_owner;
+    Waiter* waiter;
+    while (owned && (waiter = waiter_queue_take(&monitor->waiting)) != NULL) {
+        waiter_queue_push(&monitor->entrants, waiter);
+        if (!all) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&monitor->lock);
+    if (!owned) {
+        return jvm_throw_new(jvm, frame, "java/lang/IllegalMonitorStateException", NULL);
+    }
+    return 0;
+}
+
+// Free the monitor of an object being freed, if its lock was inflated
+void monitor_free(JObject* object) {
+    if (object->lock & LOCK_INFLATED) {
+        Monitor* monitor = word_monitor(object->lock);
+        pthread_cond_destroy(&monitor->handed_off);
+        pthread_mutex_destroy(&monitor->lock);
+        free(monitor);
+    }
+}
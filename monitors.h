@@ -0,0 +1,27 @@
+// monitors.h - Thin locks and monitors for synchronized, wait and notify
+#ifndef MONITORS_H
+#define MONITORS_H
+
+#include "jvm.h"
+
+// Lock word of an object header. 0 when unlocked. A thin lock holds the
+// owning thread's lock_owner with the lowest bit clear and the number of
+// recursive acquisitions in LOCK_COUNT_BITS bits below it. A lock that was
+// contended, waited on or nested too deeply is inflated: the word holds
+// the address of its Monitor with the lowest bit set, for good.
+#define LOCK_INFLATED 1
+#define LOCK_COUNT_SHIFT 1
+#define LOCK_COUNT_BITS 7
+#define LOCK_OWNER_SHIFT (LOCK_COUNT_SHIFT + LOCK_COUNT_BITS)
+#define LOCK_COUNT_MASK ((((uintptr_t)1 << LOCK_COUNT_BITS) - 1) << LOCK_COUNT_SHIFT)
+#define LOCK_OWNER_MASK (~(uintptr_t)0 << LOCK_OWNER_SHIFT)
+
+// Public API functions
+uintptr_t lock_owner_new(void);
+int monitor_enter(JVM* jvm, Frame* frame, JObject* object);
+int monitor_exit(JVM* jvm, Frame* frame, JObject* object);
+int monitor_wait(JVM* jvm, Frame* frame, JObject* object);
+int monitor_notify(JVM* jvm, Frame* frame, JObject* object, bool all);
+void monitor_free(JObject* object);
+
+#endif // MONITORS_H
@@ -0,0 +1,273 @@
+#include "native_libraries.h"
+#include "exceptions.h"
+#include "jstring.h"
+#include "safepoints.h"
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__APPLE__)
+#define LIBRARY_SUFFIX ".dylib"
+#else
+#define LIBRARY_SUFFIX ".so"
+#endif
+
+// Open a shared object for this instance and keep its handle until the
+// instance is destroyed; loading a library twice has no further effect.
+// The threads of an instance share its libraries.
+int jvm_load_library(JVM* jvm, const char* path) {
+    // Outside Java while the library loads and runs its initializers
+    safepoint_leave_java(jvm);
+    void* handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    safepoint_enter_java(jvm);
+    if (!handle) {
+        return -1;
+    }
+    JVM* main = jvm->main;
+    pthread_mutex_lock(&main->lock);
+    int status = 0;
+    size_t i = 0;
+    while (i < main->libraries_count && main->libraries[i] != handle) {
+        i++;
+    }
+    if (i < main->libraries_count) {
+        dlclose(handle);
+    } else {
+        void** libraries = realloc(main->libraries, (main->libraries_count + 1) * sizeof(void*));
+        if (libraries) {
+            libraries[main->libraries_count++] = handle;
+            main->libraries = libraries;
+        } else {
+            dlclose(handle);
+            status = -1;
+        }
+    }
+    pthread_mutex_unlock(&main->lock);
+    return status;
+}
+
+void jvm_unload_libraries(JVM* jvm) {
+    for (size_t i = 0; i < jvm->libraries_count; i++) {
+        dlclose(jvm->libraries[i]);
+    }
+    free(jvm->libraries);
+    jvm->libraries = NULL;
+    jvm->libraries_count = 0;
+}
+
+// Append text to a name being built, failing when it does not fit
+static bool append(char* name, size_t* length, const char* text) {
+    size_t count = strlen(text);
+    if (*length + count >= NATIVE_NAME_MAX) {
+        return false;
+    }
+    memcpy(name + *length, text, count + 1);
+    *length += count;
+    return true;
+}
+
+// Append the JNI mangling of text up to its end or stop: '/' separates
+// the components, and '_', ';', '[' and other characters are escaped
+static bool append_mangled(char* name, size_t* length, const char* text, char stop) {
+    for (const char* p = text; *p && *p != stop; p++) {
+        char escape[8];
+        unsigned char c = (unsigned char)*p;
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) {
+            escape[0] = (char)c;
+            escape[1] = '\0';
+        } else if (c == '/') {
+            strcpy(escape, "_");
+        } else if (c == '_') {
+            strcpy(escape, "_1");
+        } else if (c == ';') {
+            strcpy(escape, "_2");
+        } else if (c == '[') {
+            strcpy(escape, "_3");
+        } else {
+            snprintf(escape, sizeof(escape), "_0%04x", c);
+        }
+        if (!append(name, length, escape)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// First loaded library defining the symbol, or NULL
+static void* find_symbol(JVM* jvm, const char* symbol) {
+    for (size_t i = 0; i < jvm->libraries_count; i++) {
+        void* address = dlsym(jvm->libraries[i], symbol);
+        if (address) {
+            return address;
+        }
+    }
+    return NULL;
+}
+
+// Look a method up under its short symbol, <prefix><class>_<method>, then
+// under the long one that adds __<argument types> for overloads
+static void* find_native_symbol(JVM* jvm, const char* prefix, const char* class_name,
+                                const MethodInfo* method) {
+    char symbol[NATIVE_NAME_MAX];
+    size_t length = 0;
+    symbol[0] = '\0';
+    if (!append(symbol, &length, prefix) || !append_mangled(symbol, &length, class_name, '\0') ||
+        !append(symbol, &length, "_") || !append_mangled(symbol, &length, method->name, '\0')) {
+        return NULL;
+    }
+    void* address = find_symbol(jvm, symbol);
+    if (address) {
+        return address;
+    }
+    if (!append(symbol, &length, "__") ||
+        !append_mangled(symbol, &length, method->descriptor + 1, ')')) {
+        return NULL;
+    }
+    return find_symbol(jvm, symbol);
+}
+
+// Bind a native method of a loaded class to its function in a library
+// loaded by this instance, once; the binding is kept per instance since
+// each loads its own libraries. Static methods prefer a JavaCritical_
+// variant, which takes the argument slots alone.
+static const NativeBinding* bind_native(JVM* main, const ClassInfo* class_info, uint16_t method_index,
+                                        const MethodInfo* method) {
+    size_t class_index = (size_t)(class_info - main->runtime->classes);
+    if (class_index >= main->runtime->classes_count || method_index >= class_info->constant_pool_count) {
+        return NULL;
+    }
+    if (!main->library_bindings[class_index]) {
+        NativeBinding* bindings = calloc(class_info->constant_pool_count, sizeof(NativeBinding));
+        if (!bindings) {
+            return NULL;
+        }
+        __atomic_store_n(&main->library_bindings[class_index], bindings, __ATOMIC_RELEASE);
+    }
+    NativeBinding* binding = &main->library_bindings[class_index][method_index];
+    if (binding->function || binding->critical) {
+        return binding;
+    }
+    if (init_native_binding(binding, method->descriptor) != 0) {
+        return NULL;
+    }
+    binding->leaves_java = true;
+
+    // Published last, for find_library_native
+    if (method->access_flags & ACC_STATIC) {
+        CriticalNativeMethod critical = (CriticalNativeMethod)find_native_symbol(main, "JavaCritical_",
+                                                                                 class_info->name, method);
+        if (critical) {
+            __atomic_store_n(&binding->critical, critical, __ATOMIC_RELEASE);
+            return binding;
+        }
+    }
+    NativeMethod function = (NativeMethod)find_native_symbol(main, "Java_", class_info->name, method);
+    if (!function) {
+        return NULL;
+    }
+    __atomic_store_n(&binding->function, function, __ATOMIC_RELEASE);
+    return binding;
+}
+
+const NativeBinding* bind_library_native(JVM* jvm, const ClassInfo* class_info, uint16_t method_index,
+                                         const MethodInfo* method) {
+    pthread_mutex_lock(&jvm->main->lock);
+    const NativeBinding* binding = bind_native(jvm->main, class_info, method_index, method);
+    pthread_mutex_unlock(&jvm->main->lock);
+    return binding;
+}
+
+// Copy a Java string holding a file name into a C string; names outside
+// ASCII are not supported
+static bool string_to_file_name(const JString* str, char* buffer, size_t size) {
+    if (str->length >= size) {
+        return false;
+    }
+    for (uint32_t i = 0; i < str->length; i++) {
+        uint16_t c = string_char_at(str, i);
+        if (c == 0 || c >= 0x80) {
+            return false;
+        }
+        buffer[i] = (char)c;
+    }
+    buffer[str->length] = '\0';
+    return true;
+}
+
+static int throw_unsatisfied_link(JVM* jvm, Frame* frame, const char* text) {
+    JString* message = jvm_create_string(jvm, text);
+    JThrowable* exception = message ? jvm_new_throwable(jvm, "java/lang/UnsatisfiedLinkError", message)
+                                    : NULL;
+    if (!exception) {
+        return -1;
+    }
+    return jvm_throw(jvm, frame, exception);
+}
+
+// System.load(String): a library by absolute file name
+static int native_system_load(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)result;
+    const JString* file_name = (const JString*)args[0].ref;
+    if (!file_name) {
+        return jvm_throw_new(jvm, frame, "java/lang/NullPointerException", NULL);
+    }
+    char path[NATIVE_NAME_MAX];
+    if (!string_to_file_name(file_name, path, sizeof(path)) || path[0] != '/') {
+        return jvm_throw_new(jvm, frame, "java/lang/UnsatisfiedLinkError",
+                             "Expecting an absolute path of the library");
+    }
+    if (jvm_load_library(jvm, path) != 0) {
+        char message[NATIVE_NAME_MAX + 32];
+        snprintf(message, sizeof(message), "Can't load library: %s", path);
+        return throw_unsatisfied_link(jvm, frame, message);
+    }
+    return 0;
+}
+
+// System.loadLibrary(String): lib<name>.so from the first directory of
+// java.library.path that has it. The path defaults to LD_LIBRARY_PATH,
+// then the current directory.
+static int native_system_load_library(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)result;
+    const JString* library_name = (const JString*)args[0].ref;
+    if (!library_name) {
+        return jvm_throw_new(jvm, frame, "java/lang/NullPointerException", NULL);
+    }
+    char name[NATIVE_NAME_MAX];
+    if (!string_to_file_name(library_name, name, sizeof(name)) || strchr(name, '/')) {
+        return jvm_throw_new(jvm, frame, "java/lang/UnsatisfiedLinkError",
+                             "Directory separator should not appear in library name");
+    }
+
+    const char* library_path = jvm->runtime->library_path ? jvm->runtime->library_path
+                                                          : getenv("LD_LIBRARY_PATH");
+    if (!library_path || !*library_path) {
+        library_path = ".";
+    }
+    const char* directory = library_path;
+    for (;;) {
+        const char* end = strchr(directory, LIBRARY_PATH_SEPARATOR);
+        int directory_length = end ? (int)(end - directory) : (int)strlen(directory);
+        char path[NATIVE_NAME_MAX * 2];
+        snprintf(path, sizeof(path), "%.*s%slib%s" LIBRARY_SUFFIX, directory_length, directory,
+                 directory_length > 0 ? "/" : "", name);
+        if (jvm_load_library(jvm, path) == 0) {
+            return 0;
+        }
+        if (!end) {
+            break;
+        }
+        directory = end + 1;
+    }
+    char message[NATIVE_NAME_MAX * 2];
+    snprintf(message, sizeof(message), "no %s in java.library.path: %s", name, library_path);
+    return throw_unsatisfied_link(jvm, frame, message);
+}
+
+void register_library_native_methods(Runtime* runtime) {
+    runtime_register_native_method(runtime, "java/lang/System", "load", "(Ljava/lang/String;)V",
+                                   native_system_load);
+    runtime_register_native_method(runtime, "java/lang/System", "loadLibrary", "(Ljava/lang/String;)V",
+                                   native_system_load_library);
+}
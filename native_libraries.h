@@ -0,0 +1,41 @@
+// native_libraries.h - Shared objects loaded with System.loadLibrary
+#ifndef NATIVE_LIBRARIES_H
+#define NATIVE_LIBRARIES_H
+
+#include "jvm.h"
+
+// Longest symbol or file name built for a library lookup
+#define NATIVE_NAME_MAX 1024
+
+// Separator of the directories of java.library.path
+#define LIBRARY_PATH_SEPARATOR ':'
+
+// Public API functions
+int jvm_load_library(JVM* jvm, const char* path);
+const NativeBinding* bind_library_native(JVM* jvm, const ClassInfo* class_info, uint16_t method_index,
+                                         const MethodInfo* method);
+void jvm_unload_libraries(JVM* jvm);
+void register_library_native_methods(Runtime* runtime);
+
+// Library native a call of the class already bound, or NULL. Read without
+// the lock: a binding is published once complete, by its function.
+static inline const NativeBinding* find_library_native(const JVM* jvm, const ClassInfo* class_info,
+                                                       uint16_t method_index) {
+    const JVM* main = jvm->main;
+    size_t class_index = (size_t)(class_info - main->runtime->classes);
+    if (class_index >= main->runtime->classes_count || method_index >= class_info->constant_pool_count) {
+        return NULL;
+    }
+    const NativeBinding* bindings = __atomic_load_n(&main->library_bindings[class_index], __ATOMIC_ACQUIRE);
+    if (!bindings) {
+        return NULL;
+    }
+    const NativeBinding* binding = &bindings[method_index];
+    if (__atomic_load_n(&binding->critical, __ATOMIC_ACQUIRE) ||
+        __atomic_load_n(&binding->function, __ATOMIC_ACQUIRE)) {
+        return binding;
+    }
+    return NULL;
+}
+
+#endif // NATIVE_LIBRARIES_H
@@ -1,72 +1,216 @@
 #include "jvm.h"
+#include "jstring.h"
+#include "class_loader.h"
+#include "collections.h"
+#include "native_libraries.h"
+#include "threads.h"
+#include "atomics.h"
+#include "safepoints.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
-// Register native method
-int jvm_register_native_method(JVM* jvm, const char* class_name,
-                              const char* method_name, const char* descriptor,
-                              NativeMethod function) {
-    if (!jvm || !class_name || !method_name || !function) {
-        return -1;
+// FNV-1a over the class name, method name and descriptor, each with its
+// terminator so the parts cannot run together
+static uint32_t native_method_hash(const char* class_name, const char* method_name,
+                                   const char* descriptor) {
+    const char* parts[3] = {class_name, method_name, descriptor};
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < 3; i++) {
+        const char* p = parts[i];
+        do {
+            hash ^= (uint8_t)*p;
+            hash *= 16777619u;
+        } while (*p++);
     }
+    return hash;
+}
 
-    // Expand native methods array if needed
-    if (jvm->native_methods_count == 0) {
-        jvm->native_methods = malloc(32 * sizeof(NativeMethodEntry));
-        if (!jvm->native_methods) {
-            return -1;
+// Slot of the entry with the given key, or of the empty slot ending its
+// probe sequence
+static NativeMethodEntry* native_method_slot(NativeMethodEntry* table, size_t capacity, uint32_t hash,
+                                             const char* class_name, const char* method_name,
+                                             const char* descriptor) {
+    size_t mask = capacity - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        NativeMethodEntry* entry = &table[i];
+        if (!entry->class_name ||
+            (entry->hash == hash && strcmp(entry->class_name, class_name) == 0 &&
+             strcmp(entry->method_name, method_name) == 0 && strcmp(entry->descriptor, descriptor) == 0)) {
+            return entry;
         }
     }
+}
 
-    NativeMethodEntry* entry = &jvm->native_methods[jvm->native_methods_count];
-    entry->class_name = class_name;
-    entry->method_name = method_name;
-    entry->descriptor = descriptor;
-    entry->function = function;
-    jvm->native_methods_count++;
+// Rehash the registry into a table twice as large
+static int grow_native_methods(Runtime* runtime) {
+    size_t capacity = runtime->native_methods_capacity ? runtime->native_methods_capacity * 2
+                                                       : NATIVE_METHODS_MIN_CAPACITY;
+    NativeMethodEntry* table = calloc(capacity, sizeof(NativeMethodEntry));
+    if (!table) {
+        return -1;
+    }
+    for (size_t i = 0; i < runtime->native_methods_capacity; i++) {
+        NativeMethodEntry* entry = &runtime->native_methods[i];
+        if (entry->class_name) {
+            *native_method_slot(table, capacity, entry->hash, entry->class_name,
+                                entry->method_name, entry->descriptor) = *entry;
+        }
+    }
+    free(runtime->native_methods);
+    runtime->native_methods = table;
+    runtime->native_methods_capacity = capacity;
     return 0;
 }
 
-// Create Java string
-JString* jvm_create_string(JVM* jvm, const char* str) {
-    if (!jvm || !str) {
-        return NULL;
+// Register native method; registering a method again replaces its function
+static int register_native_method(Runtime* runtime, const char* class_name,
+                                  const char* method_name, const char* descriptor,
+                                  NativeMethod function, bool leaves_java) {
+    if (!runtime || !class_name || !method_name || !descriptor || !function) {
+        return -1;
     }
 
-    if (jvm->string_pool.count >= MAX_STRING_POOL) {
-        return NULL;
+    // Keep the table at most three quarters full
+    if ((runtime->native_methods_count + 1) * 4 > runtime->native_methods_capacity * 3 &&
+        grow_native_methods(runtime) != 0) {
+        return -1;
+    }
+
+    uint32_t hash = native_method_hash(class_name, method_name, descriptor);
+    NativeMethodEntry* entry = native_method_slot(runtime->native_methods,
+                                                  runtime->native_methods_capacity, hash,
+                                                  class_name, method_name, descriptor);
+    if (entry->class_name) {
+        entry->function = function;
+        entry->leaves_java = leaves_java;
+        return 0;
     }
 
-    JString* jstr = &jvm->string_pool.strings[jvm->string_pool.count];
-    size_t len = strlen(str);
-    jstr->capacity = len + 1;
-    jstr->data = malloc(jstr->capacity);
-    if (!jstr->data) {
+    size_t class_length = strlen(class_name) + 1;
+    size_t name_length = strlen(method_name) + 1;
+    size_t descriptor_length = strlen(descriptor) + 1;
+    char* key = malloc(class_length + name_length + descriptor_length);
+    if (!key) {
+        return -1;
+    }
+    memcpy(key, class_name, class_length);
+    memcpy(key + class_length, method_name, name_length);
+    memcpy(key + class_length + name_length, descriptor, descriptor_length);
+
+    entry->class_name = key;
+    entry->method_name = key + class_length;
+    entry->descriptor = key + class_length + name_length;
+    entry->function = function;
+    entry->hash = hash;
+    entry->leaves_java = leaves_java;
+    runtime->native_methods_count++;
+    return 0;
+}
+
+int runtime_register_native_method(Runtime* runtime, const char* class_name,
+                                   const char* method_name, const char* descriptor,
+                                   NativeMethod function) {
+    return register_native_method(runtime, class_name, method_name, descriptor, function, false);
+}
+
+// Register a native that blocks, such as Thread.join. It runs outside Java,
+// so a safepoint does not wait for it; others stay in Java, since they
+// work on objects.
+int runtime_register_blocking_native_method(Runtime* runtime, const char* class_name,
+                                            const char* method_name, const char* descriptor,
+                                            NativeMethod function) {
+    return register_native_method(runtime, class_name, method_name, descriptor, function, true);
+}
+
+// Registry entry of a native method, or NULL when none is registered
+static const NativeMethodEntry* find_native_method(const Runtime* runtime, const char* class_name,
+                                                   const char* method_name, const char* descriptor) {
+    if (!runtime || runtime->native_methods_count == 0) {
         return NULL;
     }
+    uint32_t hash = native_method_hash(class_name, method_name, descriptor);
+    const NativeMethodEntry* entry = native_method_slot(runtime->native_methods,
+                                                        runtime->native_methods_capacity, hash,
+                                                        class_name, method_name, descriptor);
+    return entry->class_name ? entry : NULL;
+}
 
-    strcpy(jstr->data, str);
-    jstr->length = len;
-    jvm->string_pool.count++;
-    return jstr;
+// Look up a native method, or NULL when none is registered
+NativeMethod runtime_find_native_method(const Runtime* runtime, const char* class_name,
+                                        const char* method_name, const char* descriptor) {
+    const NativeMethodEntry* entry = find_native_method(runtime, class_name, method_name, descriptor);
+    return entry ? entry->function : NULL;
 }
 
-// Print string to output
-void jvm_print_string(JVM* jvm, JString* str) {
-    if (!jvm || !str || !str->data) {
-        return;
+// Record the argument and result slots of a bound native's descriptor
+int init_native_binding(NativeBinding* binding, const char* descriptor) {
+    char arg_types[256];
+    int arg_count = parse_method_descriptor(descriptor, arg_types, sizeof(arg_types));
+    if (arg_count < 0) {
+        return -1;
+    }
+    uint16_t slots = 0;
+    for (int i = 0; i < arg_count; i++) {
+        slots += (arg_types[i] == 'J' || arg_types[i] == 'D') ? 2 : 1;
     }
+    char type = descriptor_return_type(descriptor);
+    binding->argument_slots = slots;
+    binding->result_slots = type == 'V' ? 0 : (type == 'J' || type == 'D') ? 2 : 1;
+    return 0;
+}
 
-    printf("%s", str->data);
-    fflush(stdout);
+// Resolve the member refs of a class against the registry once, caching
+// each native in the class's binding table, and turn the invokes of bound
+// methods into invoke_native so that a call is a single indirect call
+int bind_native_methods(const Runtime* runtime, ClassInfo* class_info) {
+    if (!class_info->native_bindings || runtime->native_methods_count == 0) {
+        return 0;
+    }
+
+    for (uint16_t i = 1; i < class_info->constant_pool_count; i++) {
+        uint8_t tag = class_info->constant_pool[i].tag;
+        if (tag != CONST_METHODREF && tag != CONST_INTERFACE_METHODREF) {
+            continue;
+        }
+        const char* class_name;
+        const char* method_name;
+        const char* descriptor;
+        if (constant_pool_member_ref(class_info, i, &class_name, &method_name, &descriptor) != 0) {
+            continue;
+        }
+        const NativeMethodEntry* entry = find_native_method(runtime, class_name, method_name, descriptor);
+        if (!entry) {
+            continue;
+        }
+        NativeBinding* binding = &class_info->native_bindings[i];
+        if (init_native_binding(binding, descriptor) != 0) {
+            return -1;
+        }
+        binding->function = entry->function;
+        binding->leaves_java = entry->leaves_java;
+    }
+
+    for (uint16_t m = 0; m < class_info->methods_count; m++) {
+        MethodInfo* method = &class_info->methods[m];
+        for (uint32_t i = 0; i < method->instructions_count; i++) {
+            Instruction* insn = &method->instructions[i];
+            if ((insn->opcode == INVOKEVIRTUAL || insn->opcode == INVOKESPECIAL ||
+                 insn->opcode == INVOKESTATIC || insn->opcode == INVOKEINTERFACE) &&
+                class_info->native_bindings[insn->a].function) {
+                insn->b = insn->opcode != INVOKESTATIC;
+                insn->opcode = INVOKE_NATIVE;
+            }
+        }
+    }
+    return 0;
 }
 
 // Read integer from input
 int jvm_read_int(JVM* jvm) {
-    (void)jvm; // Suppress warning
     int value;
-    if (scanf("%d", &value) == 1) {
+    if (fscanf(jvm->in, "%d", &value) == 1) {
         return value;
     }
     return 0;
@@ -74,9 +218,8 @@ int jvm_read_int(JVM* jvm) {
 
 // Read line from input
 char* jvm_read_line(JVM* jvm) {
-    (void)jvm; // Suppress warning
     char* line = malloc(256);
-    if (line && fgets(line, 256, stdin)) {
+    if (line && fgets(line, 256, jvm->in)) {
         // Remove newline character
         size_t len = strlen(line);
         if (len > 0 && line[len-1] == '\n') {
@@ -91,117 +234,241 @@ char* jvm_read_line(JVM* jvm) {
     return NULL;
 }
 
-// System.out.print(String)
-int native_system_out_print(JVM* jvm, jvalue* args, int arg_count) {
-    if (!jvm || !args || arg_count < 1) {
-        return -1;
-    }
-
-    JString* str = (JString*)args[0].ref;
+// PrintStream.print(String); args[0] is the stream
+int native_system_out_print(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)frame;
+    (void)result;
+    JString* str = (JString*)args[1].ref;
     if (str) {
         jvm_print_string(jvm, str);
+    } else {
+        fprintf(jvm->out, "null");
     }
     return 0;
 }
 
-// System.out.println(String)
-int native_system_out_println(JVM* jvm, jvalue* args, int arg_count) {
-    if (!jvm || !args || arg_count < 1) {
-        return -1;
-    }
-
-    JString* str = (JString*)args[0].ref;
+// PrintStream.println(String)
+int native_system_out_println(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)frame;
+    (void)result;
+    JString* str = (JString*)args[1].ref;
     if (str) {
         jvm_print_string(jvm, str);
+    } else {
+        fprintf(jvm->out, "null");
     }
 
-    printf("\n");
-    fflush(stdout);
+    fprintf(jvm->out, "\n");
+    fflush(jvm->out);
     return 0;
 }
 
-// System.out.print(int)
-int native_system_out_print_int(JVM* jvm, jvalue* args, int arg_count) {
-    (void)jvm; // Suppress warning
-    if (!args || arg_count < 1) {
-        return -1;
-    }
+// PrintStream.print(int)
+int native_system_out_print_int(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)frame;
+    (void)result;
+    fprintf(jvm->out, "%d", args[1].i);
+    fflush(jvm->out);
+    return 0;
+}
 
-    printf("%d", args[0].i);
-    fflush(stdout);
+// PrintStream.println(int)
+int native_system_out_println_int(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)frame;
+    (void)result;
+    fprintf(jvm->out, "%d\n", args[1].i);
+    fflush(jvm->out);
     return 0;
 }
 
-// System.out.println(int)
-int native_system_out_println_int(JVM* jvm, jvalue* args, int arg_count) {
-    (void)jvm; // Suppress warning
-    if (!args || arg_count < 1) {
-        return -1;
+// PrintStream.println(long)
+int native_system_out_println_long(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)frame;
+    (void)result;
+    fprintf(jvm->out, "%lld\n", (long long)args[1].l);
+    fflush(jvm->out);
+    return 0;
+}
+
+// Format a number the way Double.toString and Float.toString do: the
+// shortest digits that read back as the same double (or float) value, in
+// plain notation for 1e-3 <= |v| < 1e7
+static void format_decimal(char* buffer, size_t size, jdouble value, bool single) {
+    if (value != value) {
+        snprintf(buffer, size, "NaN");
+        return;
+    }
+    if (value == 0.0) {
+        snprintf(buffer, size, signbit(value) ? "-0.0" : "0.0");
+        return;
+    }
+    if (value > 1.7976931348623157e308 || value < -1.7976931348623157e308) {
+        snprintf(buffer, size, value > 0 ? "Infinity" : "-Infinity");
+        return;
     }
 
-    printf("%d\n", args[0].i);
-    fflush(stdout);
+    // Shortest round-tripping mantissa digits and decimal exponent
+    char scientific[32];
+    for (int precision = 1; precision <= (single ? 9 : 17); precision++) {
+        snprintf(scientific, sizeof(scientific), "%.*e", precision - 1, value);
+        if (single ? strtof(scientific, NULL) == (jfloat)value : strtod(scientific, NULL) == value) {
+            break;
+        }
+    }
+    char* e = strchr(scientific, 'e');
+    int exponent = atoi(e + 1);
+    *e = '\0';
+
+    char digits[20];
+    int count = 0;
+    const char* p = scientific;
+    bool negative = *p == '-';
+    for (p += negative ? 1 : 0; *p; p++) {
+        if (*p != '.') {
+            digits[count++] = *p;
+        }
+    }
+    while (count > 1 && digits[count - 1] == '0') {
+        count--;
+    }
+
+    char* out = buffer;
+    char* end = buffer + size - 1;
+    if (negative && out < end) {
+        *out++ = '-';
+    }
+    if (exponent >= -3 && exponent < 7) {
+        // Plain notation with at least one digit after the point
+        int point = exponent + 1;
+        if (point <= 0) {
+            for (int i = 0; i < 2 && out < end; i++) {
+                *out++ = i == 1 ? '.' : '0';
+            }
+            for (int i = 0; i < -point && out < end; i++) {
+                *out++ = '0';
+            }
+            for (int i = 0; i < count && out < end; i++) {
+                *out++ = digits[i];
+            }
+        } else {
+            for (int i = 0; i < point && out < end; i++) {
+                *out++ = i < count ? digits[i] : '0';
+            }
+            if (out < end) {
+                *out++ = '.';
+            }
+            if (count <= point && out < end) {
+                *out++ = '0';
+            }
+            for (int i = point; i < count && out < end; i++) {
+                *out++ = digits[i];
+            }
+        }
+        *out = '\0';
+    } else {
+        // Computerized scientific notation: d.dddE<exponent>
+        snprintf(out, (size_t)(end - out + 1), "%c.%.*sE%d", digits[0],
+                 count > 1 ? count - 1 : 1, count > 1 ? digits + 1 : "0", exponent);
+    }
+}
+
+void format_double(char* buffer, size_t size, jdouble value) {
+    format_decimal(buffer, size, value, false);
+}
+
+void format_float(char* buffer, size_t size, jfloat value) {
+    format_decimal(buffer, size, value, true);
+}
+
+// PrintStream.println(double)
+int native_system_out_println_double(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)frame;
+    (void)result;
+    char buffer[40];
+    format_double(buffer, sizeof(buffer), args[1].d);
+    fprintf(jvm->out, "%s\n", buffer);
+    fflush(jvm->out);
     return 0;
 }
 
-// System.out.println() - no arguments
-int native_system_out_println_void(JVM* jvm, jvalue* args, int arg_count) {
-    (void)jvm;
+// PrintStream.println() - no arguments
+int native_system_out_println_void(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)frame;
     (void)args;
-    (void)arg_count;
-    printf("\n");
-    fflush(stdout);
+    (void)result;
+    fprintf(jvm->out, "\n");
+    fflush(jvm->out);
     return 0;
 }
 
 // Scanner constructor
-int native_scanner_init(JVM* jvm, jvalue* args, int arg_count) {
+int native_scanner_init(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
     (void)jvm;
+    (void)frame;
     (void)args;
-    (void)arg_count;
+    (void)result;
     // Scanner initialization - nothing to do in this implementation
     return 0;
 }
 
 // Scanner.nextInt()
-int native_scanner_next_int(JVM* jvm, jvalue* args, int arg_count) {
+int native_scanner_next_int(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)frame;
     (void)args;
-    (void)arg_count;
-    return jvm_read_int(jvm);
+    // Outside Java while waiting for input
+    safepoint_leave_java(jvm);
+    result->i = jvm_read_int(jvm);
+    safepoint_enter_java(jvm);
+    return 0;
 }
 
-// Scanner.nextLine()
-int native_scanner_next_line(JVM* jvm, jvalue* args, int arg_count) {
+// Scanner.nextLine(); null at the end of input
+int native_scanner_next_line(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)frame;
     (void)args;
-    (void)arg_count;
+    // Outside Java while waiting for input, but not while making the string
+    safepoint_leave_java(jvm);
     char* line = jvm_read_line(jvm);
-    if (line) {
-        JString* jstr = jvm_create_string(jvm, line);
-        free(line);
-        return (int)(intptr_t)jstr;
+    safepoint_enter_java(jvm);
+    if (!line) {
+        result->ref = NULL;
+        return 0;
     }
-    return 0;
+    result->ref = jvm_create_string(jvm, line);
+    free(line);
+    return result->ref ? 0 : -1;
 }
 
 // Register all standard native methods
-void register_standard_native_methods(JVM* jvm) {
+void register_standard_native_methods(Runtime* runtime) {
     // System.out methods
-    jvm_register_native_method(jvm, "java/lang/System", "out.print", "(Ljava/lang/String;)V",
-                              native_system_out_print);
-    jvm_register_native_method(jvm, "java/lang/System", "out.println", "(Ljava/lang/String;)V",
-                              native_system_out_println);
-    jvm_register_native_method(jvm, "java/lang/System", "out.print", "(I)V",
-                              native_system_out_print_int);
-    jvm_register_native_method(jvm, "java/lang/System", "out.println", "(I)V",
-                              native_system_out_println_int);
-    jvm_register_native_method(jvm, "java/lang/System", "out.println", "()V",
-                              native_system_out_println_void);
+    runtime_register_native_method(runtime, "java/io/PrintStream", "print", "(Ljava/lang/String;)V",
+                                   native_system_out_print);
+    runtime_register_native_method(runtime, "java/io/PrintStream", "println", "(Ljava/lang/String;)V",
+                                   native_system_out_println);
+    runtime_register_native_method(runtime, "java/io/PrintStream", "print", "(I)V",
+                                   native_system_out_print_int);
+    runtime_register_native_method(runtime, "java/io/PrintStream", "println", "(I)V",
+                                   native_system_out_println_int);
+    runtime_register_native_method(runtime, "java/io/PrintStream", "println", "(J)V",
+                                   native_system_out_println_long);
+    runtime_register_native_method(runtime, "java/io/PrintStream", "println", "(D)V",
+                                   native_system_out_println_double);
+    runtime_register_native_method(runtime, "java/io/PrintStream", "println", "()V",
+                                   native_system_out_println_void);
 
     // Scanner methods
-    jvm_register_native_method(jvm, "java/util/Scanner", "<init>", "(Ljava/io/InputStream;)V",
-                              native_scanner_init);
-    jvm_register_native_method(jvm, "java/util/Scanner", "nextInt", "()I",
-                              native_scanner_next_int);
-    jvm_register_native_method(jvm, "java/util/Scanner", "nextLine", "()Ljava/lang/String;",
-                              native_scanner_next_line);
-}
\ No newline at end of file
+    runtime_register_native_method(runtime, "java/util/Scanner", "<init>", "(Ljava/io/InputStream;)V",
+                                   native_scanner_init);
+    runtime_register_native_method(runtime, "java/util/Scanner", "nextInt", "()I",
+                                   native_scanner_next_int);
+    runtime_register_native_method(runtime, "java/util/Scanner", "nextLine", "()Ljava/lang/String;",
+                                   native_scanner_next_line);
+
+    register_string_native_methods(runtime);
+    register_collection_native_methods(runtime);
+    register_library_native_methods(runtime);
+    register_thread_native_methods(runtime);
+    register_atomic_native_methods(runtime);
+    register_safepoint_native_methods(runtime);
+}
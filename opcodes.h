@@ -0,0 +1,432 @@
+// opcodes.h - JVM opcode table
+//
+// Every standard opcode is described once in JVM_OPCODES. The opcode enum,
+// the decoder's operand formats, the verifier's operand stack signatures,
+// the optimizer's stack effects and the interpreter's arithmetic handlers
+// are all generated from it.
+#ifndef OPCODES_H
+#define OPCODES_H
+
+#include <stdint.h>
+#include <math.h>
+
+// Operand formats of the bytecode
+enum OperandFormat {
+    FMT_NONE,               // No operands
+    FMT_BYTE,               // u1 (newarray type) or s1 (bipush)
+    FMT_SHORT,              // s2 (sipush)
+    FMT_LOCAL,              // u1 local index, u2 after wide
+    FMT_CP1,                // u1 constant pool index
+    FMT_CP2,                // u2 constant pool index
+    FMT_IINC,               // u1 local index, s1 increment
+    FMT_BRANCH,             // s2 branch offset
+    FMT_BRANCH_W,           // s4 branch offset
+    FMT_SWITCH,             // Padded tableswitch or lookupswitch
+    FMT_INVOKEINTERFACE,    // u2 index, u1 count, 0
+    FMT_INVOKEDYNAMIC,      // u2 index, 0, 0
+    FMT_MULTIANEWARRAY,     // u2 index, u1 dimensions
+    FMT_WIDE                // Modifier of the following instruction
+};
+
+// Columns:
+//   name, opcode, operand format,
+//   operand stack before and after, as verification types deepest first
+//     (I int, J long, F float, D double, A reference, "?" operand-dependent),
+//   handler kind, operand type and operation for generated handlers:
+//     SPECIAL  hand-written handler, or not supported
+//     DECODED  rewritten to another form by the decoder, never executed
+//     CONST    push constant op of type
+//     LOAD     push locals[a] of type
+//     STORE    pop into locals[a] of type
+//     UNARY    push op(value)
+//     BINARY   push op(value1, value2)
+//     DIVIDE   as BINARY, failing on a zero divisor
+//     SHIFT    push op(value, int shift)
+//     CONVERT  convert value of type to type op
+//     COMPARE  push -1, 0 or 1, or op when unordered (NaN)
+//     IF       branch to a if (value op 0)
+//     IF_CMP   branch to a if (value1 op value2)
+#define JVM_OPCODES(X) \
+    /* Constants */ \
+    X(NOP,              0x00,  FMT_NONE,             "",     "",   SPECIAL,  _,  _) \
+    X(ACONST_NULL,      0x01,  FMT_NONE,             "",     "A",  CONST,    A,  NULL) \
+    X(ICONST_M1,        0x02,  FMT_NONE,             "",     "I",  DECODED,  _,  _) \
+    X(ICONST_0,         0x03,  FMT_NONE,             "",     "I",  DECODED,  _,  _) \
+    X(ICONST_1,         0x04,  FMT_NONE,             "",     "I",  DECODED,  _,  _) \
+    X(ICONST_2,         0x05,  FMT_NONE,             "",     "I",  DECODED,  _,  _) \
+    X(ICONST_3,         0x06,  FMT_NONE,             "",     "I",  DECODED,  _,  _) \
+    X(ICONST_4,         0x07,  FMT_NONE,             "",     "I",  DECODED,  _,  _) \
+    X(ICONST_5,         0x08,  FMT_NONE,             "",     "I",  DECODED,  _,  _) \
+    X(LCONST_0,         0x09,  FMT_NONE,             "",     "J",  CONST,    J,  0) \
+    X(LCONST_1,         0x0a,  FMT_NONE,             "",     "J",  CONST,    J,  1) \
+    X(FCONST_0,         0x0b,  FMT_NONE,             "",     "F",  CONST,    F,  0.0f) \
+    X(FCONST_1,         0x0c,  FMT_NONE,             "",     "F",  CONST,    F,  1.0f) \
+    X(FCONST_2,         0x0d,  FMT_NONE,             "",     "F",  CONST,    F,  2.0f) \
+    X(DCONST_0,         0x0e,  FMT_NONE,             "",     "D",  CONST,    D,  0.0) \
+    X(DCONST_1,         0x0f,  FMT_NONE,             "",     "D",  CONST,    D,  1.0) \
+    X(BIPUSH,           0x10,  FMT_BYTE,             "",     "I",  DECODED,  _,  _) \
+    X(SIPUSH,           0x11,  FMT_SHORT,            "",     "I",  DECODED,  _,  _) \
+    X(LDC,              0x12,  FMT_CP1,              "",     "?",  SPECIAL,  _,  _) \
+    X(LDC_W,            0x13,  FMT_CP2,              "",     "?",  SPECIAL,  _,  _) \
+    X(LDC2_W,           0x14,  FMT_CP2,              "",     "?",  SPECIAL,  _,  _) \
+    /* Loads */ \
+    X(ILOAD,            0x15,  FMT_LOCAL,            "",     "I",  LOAD,     I,  _) \
+    X(LLOAD,            0x16,  FMT_LOCAL,            "",     "J",  LOAD,     J,  _) \
+    X(FLOAD,            0x17,  FMT_LOCAL,            "",     "F",  LOAD,     F,  _) \
+    X(DLOAD,            0x18,  FMT_LOCAL,            "",     "D",  LOAD,     D,  _) \
+    X(ALOAD,            0x19,  FMT_LOCAL,            "",     "A",  LOAD,     A,  _) \
+    X(ILOAD_0,          0x1a,  FMT_NONE,             "",     "I",  DECODED,  _,  _) \
+    X(ILOAD_1,          0x1b,  FMT_NONE,             "",     "I",  DECODED,  _,  _) \
+    X(ILOAD_2,          0x1c,  FMT_NONE,             "",     "I",  DECODED,  _,  _) \
+    X(ILOAD_3,          0x1d,  FMT_NONE,             "",     "I",  DECODED,  _,  _) \
+    X(LLOAD_0,          0x1e,  FMT_NONE,             "",     "J",  DECODED,  _,  _) \
+    X(LLOAD_1,          0x1f,  FMT_NONE,             "",     "J",  DECODED,  _,  _) \
+    X(LLOAD_2,          0x20,  FMT_NONE,             "",     "J",  DECODED,  _,  _) \
+    X(LLOAD_3,          0x21,  FMT_NONE,             "",     "J",  DECODED,  _,  _) \
+    X(FLOAD_0,          0x22,  FMT_NONE,             "",     "F",  DECODED,  _,  _) \
+    X(FLOAD_1,          0x23,  FMT_NONE,             "",     "F",  DECODED,  _,  _) \
+    X(FLOAD_2,          0x24,  FMT_NONE,             "",     "F",  DECODED,  _,  _) \
+    X(FLOAD_3,          0x25,  FMT_NONE,             "",     "F",  DECODED,  _,  _) \
+    X(DLOAD_0,          0x26,  FMT_NONE,             "",     "D",  DECODED,  _,  _) \
+    X(DLOAD_1,          0x27,  FMT_NONE,             "",     "D",  DECODED,  _,  _) \
+    X(DLOAD_2,          0x28,  FMT_NONE,             "",     "D",  DECODED,  _,  _) \
+    X(DLOAD_3,          0x29,  FMT_NONE,             "",     "D",  DECODED,  _,  _) \
+    X(ALOAD_0,          0x2a,  FMT_NONE,             "",     "A",  DECODED,  _,  _) \
+    X(ALOAD_1,          0x2b,  FMT_NONE,             "",     "A",  DECODED,  _,  _) \
+    X(ALOAD_2,          0x2c,  FMT_NONE,             "",     "A",  DECODED,  _,  _) \
+    X(ALOAD_3,          0x2d,  FMT_NONE,             "",     "A",  DECODED,  _,  _) \
+    X(IALOAD,           0x2e,  FMT_NONE,             "AI",   "I",  SPECIAL,  _,  _) \
+    X(LALOAD,           0x2f,  FMT_NONE,             "AI",   "J",  SPECIAL,  _,  _) \
+    X(FALOAD,           0x30,  FMT_NONE,             "AI",   "F",  SPECIAL,  _,  _) \
+    X(DALOAD,           0x31,  FMT_NONE,             "AI",   "D",  SPECIAL,  _,  _) \
+    X(AALOAD,           0x32,  FMT_NONE,             "AI",   "A",  SPECIAL,  _,  _) \
+    X(BALOAD,           0x33,  FMT_NONE,             "AI",   "I",  SPECIAL,  _,  _) \
+    X(CALOAD,           0x34,  FMT_NONE,             "AI",   "I",  SPECIAL,  _,  _) \
+    X(SALOAD,           0x35,  FMT_NONE,             "AI",   "I",  SPECIAL,  _,  _) \
+    /* Stores */ \
+    X(ISTORE,           0x36,  FMT_LOCAL,            "I",    "",   STORE,    I,  _) \
+    X(LSTORE,           0x37,  FMT_LOCAL,            "J",    "",   STORE,    J,  _) \
+    X(FSTORE,           0x38,  FMT_LOCAL,            "F",    "",   STORE,    F,  _) \
+    X(DSTORE,           0x39,  FMT_LOCAL,            "D",    "",   STORE,    D,  _) \
+    X(ASTORE,           0x3a,  FMT_LOCAL,            "A",    "",   STORE,    A,  _) \
+    X(ISTORE_0,         0x3b,  FMT_NONE,             "I",    "",   DECODED,  _,  _) \
+    X(ISTORE_1,         0x3c,  FMT_NONE,             "I",    "",   DECODED,  _,  _) \
+    X(ISTORE_2,         0x3d,  FMT_NONE,             "I",    "",   DECODED,  _,  _) \
+    X(ISTORE_3,         0x3e,  FMT_NONE,             "I",    "",   DECODED,  _,  _) \
+    X(LSTORE_0,         0x3f,  FMT_NONE,             "J",    "",   DECODED,  _,  _) \
+    X(LSTORE_1,         0x40,  FMT_NONE,             "J",    "",   DECODED,  _,  _) \
+    X(LSTORE_2,         0x41,  FMT_NONE,             "J",    "",   DECODED,  _,  _) \
+    X(LSTORE_3,         0x42,  FMT_NONE,             "J",    "",   DECODED,  _,  _) \
+    X(FSTORE_0,         0x43,  FMT_NONE,             "F",    "",   DECODED,  _,  _) \
+    X(FSTORE_1,         0x44,  FMT_NONE,             "F",    "",   DECODED,  _,  _) \
+    X(FSTORE_2,         0x45,  FMT_NONE,             "F",    "",   DECODED,  _,  _) \
+    X(FSTORE_3,         0x46,  FMT_NONE,             "F",    "",   DECODED,  _,  _) \
+    X(DSTORE_0,         0x47,  FMT_NONE,             "D",    "",   DECODED,  _,  _) \
+    X(DSTORE_1,         0x48,  FMT_NONE,             "D",    "",   DECODED,  _,  _) \
+    X(DSTORE_2,         0x49,  FMT_NONE,             "D",    "",   DECODED,  _,  _) \
+    X(DSTORE_3,         0x4a,  FMT_NONE,             "D",    "",   DECODED,  _,  _) \
+    X(ASTORE_0,         0x4b,  FMT_NONE,             "A",    "",   DECODED,  _,  _) \
+    X(ASTORE_1,         0x4c,  FMT_NONE,             "A",    "",   DECODED,  _,  _) \
+    X(ASTORE_2,         0x4d,  FMT_NONE,             "A",    "",   DECODED,  _,  _) \
+    X(ASTORE_3,         0x4e,  FMT_NONE,             "A",    "",   DECODED,  _,  _) \
+    X(IASTORE,          0x4f,  FMT_NONE,             "AII",  "",   SPECIAL,  _,  _) \
+    X(LASTORE,          0x50,  FMT_NONE,             "AIJ",  "",   SPECIAL,  _,  _) \
+    X(FASTORE,          0x51,  FMT_NONE,             "AIF",  "",   SPECIAL,  _,  _) \
+    X(DASTORE,          0x52,  FMT_NONE,             "AID",  "",   SPECIAL,  _,  _) \
+    X(AASTORE,          0x53,  FMT_NONE,             "AIA",  "",   SPECIAL,  _,  _) \
+    X(BASTORE,          0x54,  FMT_NONE,             "AII",  "",   SPECIAL,  _,  _) \
+    X(CASTORE,          0x55,  FMT_NONE,             "AII",  "",   SPECIAL,  _,  _) \
+    X(SASTORE,          0x56,  FMT_NONE,             "AII",  "",   SPECIAL,  _,  _) \
+    /* Stack management */ \
+    X(POP,              0x57,  FMT_NONE,             "?",    "?",  SPECIAL,  _,  _) \
+    X(POP2,             0x58,  FMT_NONE,             "?",    "?",  SPECIAL,  _,  _) \
+    X(DUP,              0x59,  FMT_NONE,             "?",    "?",  SPECIAL,  _,  _) \
+    X(DUP_X1,           0x5a,  FMT_NONE,             "?",    "?",  SPECIAL,  _,  _) \
+    X(DUP_X2,           0x5b,  FMT_NONE,             "?",    "?",  SPECIAL,  _,  _) \
+    X(DUP2,             0x5c,  FMT_NONE,             "?",    "?",  SPECIAL,  _,  _) \
+    X(DUP2_X1,          0x5d,  FMT_NONE,             "?",    "?",  SPECIAL,  _,  _) \
+    X(DUP2_X2,          0x5e,  FMT_NONE,             "?",    "?",  SPECIAL,  _,  _) \
+    X(SWAP,             0x5f,  FMT_NONE,             "?",    "?",  SPECIAL,  _,  _) \
+    /* Arithmetic */ \
+    X(IADD,             0x60,  FMT_NONE,             "II",   "I",  BINARY,   I,  INT_ADD) \
+    X(LADD,             0x61,  FMT_NONE,             "JJ",   "J",  BINARY,   J,  LONG_ADD) \
+    X(FADD,             0x62,  FMT_NONE,             "FF",   "F",  BINARY,   F,  FP_ADD) \
+    X(DADD,             0x63,  FMT_NONE,             "DD",   "D",  BINARY,   D,  FP_ADD) \
+    X(ISUB,             0x64,  FMT_NONE,             "II",   "I",  BINARY,   I,  INT_SUB) \
+    X(LSUB,             0x65,  FMT_NONE,             "JJ",   "J",  BINARY,   J,  LONG_SUB) \
+    X(FSUB,             0x66,  FMT_NONE,             "FF",   "F",  BINARY,   F,  FP_SUB) \
+    X(DSUB,             0x67,  FMT_NONE,             "DD",   "D",  BINARY,   D,  FP_SUB) \
+    X(IMUL,             0x68,  FMT_NONE,             "II",   "I",  BINARY,   I,  INT_MUL) \
+    X(LMUL,             0x69,  FMT_NONE,             "JJ",   "J",  BINARY,   J,  LONG_MUL) \
+    X(FMUL,             0x6a,  FMT_NONE,             "FF",   "F",  BINARY,   F,  FP_MUL) \
+    X(DMUL,             0x6b,  FMT_NONE,             "DD",   "D",  BINARY,   D,  FP_MUL) \
+    X(IDIV,             0x6c,  FMT_NONE,             "II",   "I",  DIVIDE,   I,  INT_DIV) \
+    X(LDIV,             0x6d,  FMT_NONE,             "JJ",   "J",  DIVIDE,   J,  LONG_DIV) \
+    X(FDIV,             0x6e,  FMT_NONE,             "FF",   "F",  BINARY,   F,  FP_DIV) \
+    X(DDIV,             0x6f,  FMT_NONE,             "DD",   "D",  BINARY,   D,  FP_DIV) \
+    X(IREM,             0x70,  FMT_NONE,             "II",   "I",  DIVIDE,   I,  INT_REM) \
+    X(LREM,             0x71,  FMT_NONE,             "JJ",   "J",  DIVIDE,   J,  LONG_REM) \
+    X(FREM,             0x72,  FMT_NONE,             "FF",   "F",  BINARY,   F,  FLOAT_REM) \
+    X(DREM,             0x73,  FMT_NONE,             "DD",   "D",  BINARY,   D,  DOUBLE_REM) \
+    X(INEG,             0x74,  FMT_NONE,             "I",    "I",  UNARY,    I,  INT_NEG) \
+    X(LNEG,             0x75,  FMT_NONE,             "J",    "J",  UNARY,    J,  LONG_NEG) \
+    X(FNEG,             0x76,  FMT_NONE,             "F",    "F",  UNARY,    F,  FP_NEG) \
+    X(DNEG,             0x77,  FMT_NONE,             "D",    "D",  UNARY,    D,  FP_NEG) \
+    /* Shifts and bitwise operations */ \
+    X(ISHL,             0x78,  FMT_NONE,             "II",   "I",  SHIFT,    I,  INT_SHL) \
+    X(LSHL,             0x79,  FMT_NONE,             "JI",   "J",  SHIFT,    J,  LONG_SHL) \
+    X(ISHR,             0x7a,  FMT_NONE,             "II",   "I",  SHIFT,    I,  INT_SHR) \
+    X(LSHR,             0x7b,  FMT_NONE,             "JI",   "J",  SHIFT,    J,  LONG_SHR) \
+    X(IUSHR,            0x7c,  FMT_NONE,             "II",   "I",  SHIFT,    I,  INT_USHR) \
+    X(LUSHR,            0x7d,  FMT_NONE,             "JI",   "J",  SHIFT,    J,  LONG_USHR) \
+    X(IAND,             0x7e,  FMT_NONE,             "II",   "I",  BINARY,   I,  BIT_AND) \
+    X(LAND,             0x7f,  FMT_NONE,             "JJ",   "J",  BINARY,   J,  BIT_AND) \
+    X(IOR,              0x80,  FMT_NONE,             "II",   "I",  BINARY,   I,  BIT_OR) \
+    X(LOR,              0x81,  FMT_NONE,             "JJ",   "J",  BINARY,   J,  BIT_OR) \
+    X(IXOR,             0x82,  FMT_NONE,             "II",   "I",  BINARY,   I,  BIT_XOR) \
+    X(LXOR,             0x83,  FMT_NONE,             "JJ",   "J",  BINARY,   J,  BIT_XOR) \
+    X(IINC,             0x84,  FMT_IINC,             "",     "",   SPECIAL,  _,  _) \
+    /* Conversions */ \
+    X(I2L,              0x85,  FMT_NONE,             "I",    "J",  CONVERT,  I,  J) \
+    X(I2F,              0x86,  FMT_NONE,             "I",    "F",  CONVERT,  I,  F) \
+    X(I2D,              0x87,  FMT_NONE,             "I",    "D",  CONVERT,  I,  D) \
+    X(L2I,              0x88,  FMT_NONE,             "J",    "I",  CONVERT,  J,  I) \
+    X(L2F,              0x89,  FMT_NONE,             "J",    "F",  CONVERT,  J,  F) \
+    X(L2D,              0x8a,  FMT_NONE,             "J",    "D",  CONVERT,  J,  D) \
+    X(F2I,              0x8b,  FMT_NONE,             "F",    "I",  CONVERT,  F,  I) \
+    X(F2L,              0x8c,  FMT_NONE,             "F",    "J",  CONVERT,  F,  J) \
+    X(F2D,              0x8d,  FMT_NONE,             "F",    "D",  CONVERT,  F,  D) \
+    X(D2I,              0x8e,  FMT_NONE,             "D",    "I",  CONVERT,  D,  I) \
+    X(D2L,              0x8f,  FMT_NONE,             "D",    "J",  CONVERT,  D,  J) \
+    X(D2F,              0x90,  FMT_NONE,             "D",    "F",  CONVERT,  D,  F) \
+    X(I2B,              0x91,  FMT_NONE,             "I",    "I",  UNARY,    I,  INT_TO_BYTE) \
+    X(I2C,              0x92,  FMT_NONE,             "I",    "I",  UNARY,    I,  INT_TO_CHAR) \
+    X(I2S,              0x93,  FMT_NONE,             "I",    "I",  UNARY,    I,  INT_TO_SHORT) \
+    /* Comparisons */ \
+    X(LCMP,             0x94,  FMT_NONE,             "JJ",   "I",  COMPARE,  J,  0) \
+    X(FCMPL,            0x95,  FMT_NONE,             "FF",   "I",  COMPARE,  F,  -1) \
+    X(FCMPG,            0x96,  FMT_NONE,             "FF",   "I",  COMPARE,  F,  1) \
+    X(DCMPL,            0x97,  FMT_NONE,             "DD",   "I",  COMPARE,  D,  -1) \
+    X(DCMPG,            0x98,  FMT_NONE,             "DD",   "I",  COMPARE,  D,  1) \
+    /* Branches */ \
+    X(IFEQ,             0x99,  FMT_BRANCH,           "I",    "",   IF,       I,  ==) \
+    X(IFNE,             0x9a,  FMT_BRANCH,           "I",    "",   IF,       I,  !=) \
+    X(IFLT,             0x9b,  FMT_BRANCH,           "I",    "",   IF,       I,  <) \
+    X(IFGE,             0x9c,  FMT_BRANCH,           "I",    "",   IF,       I,  >=) \
+    X(IFGT,             0x9d,  FMT_BRANCH,           "I",    "",   IF,       I,  >) \
+    X(IFLE,             0x9e,  FMT_BRANCH,           "I",    "",   IF,       I,  <=) \
+    X(IF_ICMPEQ,        0x9f,  FMT_BRANCH,           "II",   "",   IF_CMP,   I,  ==) \
+    X(IF_ICMPNE,        0xa0,  FMT_BRANCH,           "II",   "",   IF_CMP,   I,  !=) \
+    X(IF_ICMPLT,        0xa1,  FMT_BRANCH,           "II",   "",   IF_CMP,   I,  <) \
+    X(IF_ICMPGE,        0xa2,  FMT_BRANCH,           "II",   "",   IF_CMP,   I,  >=) \
+    X(IF_ICMPGT,        0xa3,  FMT_BRANCH,           "II",   "",   IF_CMP,   I,  >) \
+    X(IF_ICMPLE,        0xa4,  FMT_BRANCH,           "II",   "",   IF_CMP,   I,  <=) \
+    X(IF_ACMPEQ,        0xa5,  FMT_BRANCH,           "AA",   "",   IF_CMP,   A,  ==) \
+    X(IF_ACMPNE,        0xa6,  FMT_BRANCH,           "AA",   "",   IF_CMP,   A,  !=) \
+    X(GOTO,             0xa7,  FMT_BRANCH,           "",     "",   SPECIAL,  _,  _) \
+    X(JSR,              0xa8,  FMT_BRANCH,           "",     "?",  SPECIAL,  _,  _) \
+    X(RET,              0xa9,  FMT_LOCAL,            "",     "",   SPECIAL,  _,  _) \
+    X(TABLESWITCH,      0xaa,  FMT_SWITCH,           "I",    "",   SPECIAL,  _,  _) \
+    X(LOOKUPSWITCH,     0xab,  FMT_SWITCH,           "I",    "",   SPECIAL,  _,  _) \
+    /* Returns */ \
+    X(IRETURN,          0xac,  FMT_NONE,             "I",    "",   SPECIAL,  _,  _) \
+    X(LRETURN,          0xad,  FMT_NONE,             "J",    "",   SPECIAL,  _,  _) \
+    X(FRETURN,          0xae,  FMT_NONE,             "F",    "",   SPECIAL,  _,  _) \
+    X(DRETURN,          0xaf,  FMT_NONE,             "D",    "",   SPECIAL,  _,  _) \
+    X(ARETURN,          0xb0,  FMT_NONE,             "A",    "",   SPECIAL,  _,  _) \
+    X(RETURN,           0xb1,  FMT_NONE,             "",     "",   SPECIAL,  _,  _) \
+    /* Fields and methods */ \
+    X(GETSTATIC,        0xb2,  FMT_CP2,              "?",    "?",  SPECIAL,  _,  _) \
+    X(PUTSTATIC,        0xb3,  FMT_CP2,              "?",    "?",  SPECIAL,  _,  _) \
+    X(GETFIELD,         0xb4,  FMT_CP2,              "?",    "?",  SPECIAL,  _,  _) \
+    X(PUTFIELD,         0xb5,  FMT_CP2,              "?",    "?",  SPECIAL,  _,  _) \
+    X(INVOKEVIRTUAL,    0xb6,  FMT_CP2,              "?",    "?",  SPECIAL,  _,  _) \
+    X(INVOKESPECIAL,    0xb7,  FMT_CP2,              "?",    "?",  SPECIAL,  _,  _) \
+    X(INVOKESTATIC,     0xb8,  FMT_CP2,              "?",    "?",  SPECIAL,  _,  _) \
+    X(INVOKEINTERFACE,  0xb9,  FMT_INVOKEINTERFACE,  "?",    "?",  SPECIAL,  _,  _) \
+    X(INVOKEDYNAMIC,    0xba,  FMT_INVOKEDYNAMIC,    "?",    "?",  SPECIAL,  _,  _) \
+    /* Objects and arrays */ \
+    X(NEW,              0xbb,  FMT_CP2,              "",     "A",  SPECIAL,  _,  _) \
+    X(NEWARRAY,         0xbc,  FMT_BYTE,             "I",    "A",  SPECIAL,  _,  _) \
+    X(ANEWARRAY,        0xbd,  FMT_CP2,              "I",    "A",  SPECIAL,  _,  _) \
+    X(ARRAYLENGTH,      0xbe,  FMT_NONE,             "A",    "I",  SPECIAL,  _,  _) \
+    X(ATHROW,           0xbf,  FMT_NONE,             "A",    "",   SPECIAL,  _,  _) \
+    X(CHECKCAST,        0xc0,  FMT_CP2,              "A",    "A",  SPECIAL,  _,  _) \
+    X(INSTANCEOF,       0xc1,  FMT_CP2,              "A",    "I",  SPECIAL,  _,  _) \
+    X(MONITORENTER,     0xc2,  FMT_NONE,             "A",    "",   SPECIAL,  _,  _) \
+    X(MONITOREXIT,      0xc3,  FMT_NONE,             "A",    "",   SPECIAL,  _,  _) \
+    X(WIDE,             0xc4,  FMT_WIDE,             "",     "",   DECODED,  _,  _) \
+    X(MULTIANEWARRAY,   0xc5,  FMT_MULTIANEWARRAY,   "?",    "A",  SPECIAL,  _,  _) \
+    X(IFNULL,           0xc6,  FMT_BRANCH,           "A",    "",   IF,       A,  ==) \
+    X(IFNONNULL,        0xc7,  FMT_BRANCH,           "A",    "",   IF,       A,  !=) \
+    X(GOTO_W,           0xc8,  FMT_BRANCH_W,         "",     "",   SPECIAL,  _,  _) \
+    X(JSR_W,            0xc9,  FMT_BRANCH_W,         "",     "?",  SPECIAL,  _,  _)
+
+
+// Java semantics of the operations named in the table: int and long
+// arithmetic wraps, shifts mask their distance, and division of the most
+// negative value by -1 overflows instead of trapping
+#define INT_ADD(a, b) ((jint)((uint32_t)(a) + (uint32_t)(b)))
+#define INT_SUB(a, b) ((jint)((uint32_t)(a) - (uint32_t)(b)))
+#define INT_MUL(a, b) ((jint)((uint32_t)(a) * (uint32_t)(b)))
+#define INT_DIV(a, b) ((b) == -1 ? INT_NEG(a) : (a) / (b))
+#define INT_REM(a, b) ((b) == -1 ? 0 : (a) % (b))
+#define INT_NEG(a) ((jint)(0u - (uint32_t)(a)))
+#define INT_SHL(a, s) ((jint)((uint32_t)(a) << ((s) & 31)))
+#define INT_SHR(a, s) ((jint)((a) >> ((s) & 31)))
+#define INT_USHR(a, s) ((jint)((uint32_t)(a) >> ((s) & 31)))
+#define INT_TO_BYTE(a) ((jint)(jbyte)(a))
+#define INT_TO_CHAR(a) ((jint)(jchar)(a))
+#define INT_TO_SHORT(a) ((jint)(jshort)(a))
+
+#define LONG_ADD(a, b) ((jlong)((uint64_t)(a) + (uint64_t)(b)))
+#define LONG_SUB(a, b) ((jlong)((uint64_t)(a) - (uint64_t)(b)))
+#define LONG_MUL(a, b) ((jlong)((uint64_t)(a) * (uint64_t)(b)))
+#define LONG_DIV(a, b) ((b) == -1 ? LONG_NEG(a) : (a) / (b))
+#define LONG_REM(a, b) ((b) == -1 ? 0 : (a) % (b))
+#define LONG_NEG(a) ((jlong)((uint64_t)0 - (uint64_t)(a)))
+#define LONG_SHL(a, s) ((jlong)((uint64_t)(a) << ((s) & 63)))
+#define LONG_SHR(a, s) ((jlong)((a) >> ((s) & 63)))
+#define LONG_USHR(a, s) ((jlong)((uint64_t)(a) >> ((s) & 63)))
+
+#define FP_ADD(a, b) ((a) + (b))
+#define FP_SUB(a, b) ((a) - (b))
+#define FP_MUL(a, b) ((a) * (b))
+#define FP_DIV(a, b) ((a) / (b))
+#define FP_NEG(a) (-(a))
+#define FLOAT_REM(a, b) fmodf((a), (b))
+#define DOUBLE_REM(a, b) fmod((a), (b))
+
+#define BIT_AND(a, b) ((a) & (b))
+#define BIT_OR(a, b) ((a) | (b))
+#define BIT_XOR(a, b) ((a) ^ (b))
+
+// Floating-point to integer conversions saturate, and NaN converts to 0
+#define FP_TO_INTEGRAL(value, type, min, max) \
+    ((value) != (value) ? (type)0 : (value) <= (min) ? (type)(min) : \
+     (value) >= (max) ? (type)(max) : (type)(value))
+
+#define CONVERT_I_TO_J(v) ((jlong)(v))
+#define CONVERT_I_TO_F(v) ((jfloat)(v))
+#define CONVERT_I_TO_D(v) ((jdouble)(v))
+#define CONVERT_J_TO_I(v) ((jint)(uint32_t)(uint64_t)(v))
+#define CONVERT_J_TO_F(v) ((jfloat)(v))
+#define CONVERT_J_TO_D(v) ((jdouble)(v))
+#define CONVERT_F_TO_I(v) FP_TO_INTEGRAL(v, jint, INT32_MIN, INT32_MAX)
+#define CONVERT_F_TO_J(v) FP_TO_INTEGRAL(v, jlong, INT64_MIN, INT64_MAX)
+#define CONVERT_F_TO_D(v) ((jdouble)(v))
+#define CONVERT_D_TO_I(v) FP_TO_INTEGRAL(v, jint, INT32_MIN, INT32_MAX)
+#define CONVERT_D_TO_J(v) FP_TO_INTEGRAL(v, jlong, INT64_MIN, INT64_MAX)
+#define CONVERT_D_TO_F(v) ((jfloat)(v))
+
+// Math intrinsics with Java semantics: abs of the most negative int or
+// long is itself, floating-point min and max propagate NaN and order -0.0
+// below 0.0, and the bit counts are defined for zero. The builtins compile
+// to popcnt, lzcnt and tzcnt when the target CPU has them.
+#define INT_ABS(a) ((a) < 0 ? INT_NEG(a) : (a))
+#define LONG_ABS(a) ((a) < 0 ? LONG_NEG(a) : (a))
+#define INTEGRAL_MIN(a, b) ((a) <= (b) ? (a) : (b))
+#define INTEGRAL_MAX(a, b) ((a) >= (b) ? (a) : (b))
+#define FP_MIN(a, b) ((a) != (a) ? (a) : (b) != (b) ? (b) : \
+                      (a) == (b) ? (signbit(a) ? (a) : (b)) : (a) < (b) ? (a) : (b))
+#define FP_MAX(a, b) ((a) != (a) ? (a) : (b) != (b) ? (b) : \
+                      (a) == (b) ? (signbit(a) ? (b) : (a)) : (a) > (b) ? (a) : (b))
+#define INT_POPCOUNT(a) ((jint)__builtin_popcount((uint32_t)(a)))
+#define INT_CLZ(a) ((a) == 0 ? 32 : (jint)__builtin_clz((uint32_t)(a)))
+#define INT_CTZ(a) ((a) == 0 ? 32 : (jint)__builtin_ctz((uint32_t)(a)))
+#define LONG_POPCOUNT(a) ((jint)__builtin_popcountll((uint64_t)(a)))
+#define LONG_CLZ(a) ((a) == 0 ? 64 : (jint)__builtin_clzll((uint64_t)(a)))
+#define LONG_CTZ(a) ((a) == 0 ? 64 : (jint)__builtin_ctzll((uint64_t)(a)))
+
+// Static methods the optimizer binds to internal opcodes that run as a
+// single operation instead of a call.
+// Columns:
+//   name, class, method, descriptor,
+//   operand stack before and after, as in JVM_OPCODES,
+//   handler kind (UNARY, BINARY or TERNARY), argument type, result type
+//   and operation
+#define MATH_INTRINSICS(X) \
+    X(MATH_SQRT,        "java/lang/Math",    "sqrt",  "(D)D",    "D",   "D",  UNARY,    D,  D,  sqrt) \
+    X(MATH_ABS_I,       "java/lang/Math",    "abs",   "(I)I",    "I",   "I",  UNARY,    I,  I,  INT_ABS) \
+    X(MATH_ABS_J,       "java/lang/Math",    "abs",   "(J)J",    "J",   "J",  UNARY,    J,  J,  LONG_ABS) \
+    X(MATH_ABS_F,       "java/lang/Math",    "abs",   "(F)F",    "F",   "F",  UNARY,    F,  F,  fabsf) \
+    X(MATH_ABS_D,       "java/lang/Math",    "abs",   "(D)D",    "D",   "D",  UNARY,    D,  D,  fabs) \
+    X(MATH_MIN_I,       "java/lang/Math",    "min",   "(II)I",   "II",  "I",  BINARY,   I,  I,  INTEGRAL_MIN) \
+    X(MATH_MIN_J,       "java/lang/Math",    "min",   "(JJ)J",   "JJ",  "J",  BINARY,   J,  J,  INTEGRAL_MIN) \
+    X(MATH_MIN_F,       "java/lang/Math",    "min",   "(FF)F",   "FF",  "F",  BINARY,   F,  F,  FP_MIN) \
+    X(MATH_MIN_D,       "java/lang/Math",    "min",   "(DD)D",   "DD",  "D",  BINARY,   D,  D,  FP_MIN) \
+    X(MATH_MAX_I,       "java/lang/Math",    "max",   "(II)I",   "II",  "I",  BINARY,   I,  I,  INTEGRAL_MAX) \
+    X(MATH_MAX_J,       "java/lang/Math",    "max",   "(JJ)J",   "JJ",  "J",  BINARY,   J,  J,  INTEGRAL_MAX) \
+    X(MATH_MAX_F,       "java/lang/Math",    "max",   "(FF)F",   "FF",  "F",  BINARY,   F,  F,  FP_MAX) \
+    X(MATH_MAX_D,       "java/lang/Math",    "max",   "(DD)D",   "DD",  "D",  BINARY,   D,  D,  FP_MAX) \
+    X(MATH_FLOOR,       "java/lang/Math",    "floor", "(D)D",    "D",   "D",  UNARY,    D,  D,  floor) \
+    X(MATH_CEIL,        "java/lang/Math",    "ceil",  "(D)D",    "D",   "D",  UNARY,    D,  D,  ceil) \
+    X(MATH_FMA_F,       "java/lang/Math",    "fma",   "(FFF)F",  "FFF", "F",  TERNARY,  F,  F,  fmaf) \
+    X(MATH_FMA_D,       "java/lang/Math",    "fma",   "(DDD)D",  "DDD", "D",  TERNARY,  D,  D,  fma) \
+    X(INTEGER_BIT_COUNT,      "java/lang/Integer", "bitCount",              "(I)I", "I", "I", UNARY, I, I, INT_POPCOUNT) \
+    X(INTEGER_LEADING_ZEROS,  "java/lang/Integer", "numberOfLeadingZeros",  "(I)I", "I", "I", UNARY, I, I, INT_CLZ) \
+    X(INTEGER_TRAILING_ZEROS, "java/lang/Integer", "numberOfTrailingZeros", "(I)I", "I", "I", UNARY, I, I, INT_CTZ) \
+    X(LONG_BIT_COUNT,         "java/lang/Long",    "bitCount",              "(J)I", "J", "I", UNARY, J, I, LONG_POPCOUNT) \
+    X(LONG_LEADING_ZEROS,     "java/lang/Long",    "numberOfLeadingZeros",  "(J)I", "J", "I", UNARY, J, I, LONG_CLZ) \
+    X(LONG_TRAILING_ZEROS,    "java/lang/Long",    "numberOfTrailingZeros", "(J)I", "J", "I", UNARY, J, I, LONG_CTZ)
+
+// Classes with atomic intrinsics
+#define ATOMIC_INTEGER "java/util/concurrent/atomic/AtomicInteger"
+#define ATOMIC_LONG "java/util/concurrent/atomic/AtomicLong"
+#define ATOMIC_REFERENCE "java/util/concurrent/atomic/AtomicReference"
+
+// Methods of the java.util.concurrent.atomic classes the optimizer binds
+// to internal opcodes running a single atomic operation on the value of a
+// JAtomic. Plain get and set are volatile accesses, sequentially
+// consistent; the weaker access modes map to the matching orderings.
+// Columns:
+//   name, class, method, descriptor,
+//   operand stack before and after, as in JVM_OPCODES,
+//   handler kind (GET, SET, CAS, SWAP, GET_AND_ADD or ADD_AND_GET), value
+//   type, and memory order, or the added value (ARGUMENT, ONE or MINUS_ONE)
+#define ATOMIC_INTRINSICS(X) \
+    X(ATOMIC_INT_GET,                ATOMIC_INTEGER,   "get",             "()I",                                     "A",   "I", GET,         I, __ATOMIC_SEQ_CST) \
+    X(ATOMIC_INT_INT_VALUE,          ATOMIC_INTEGER,   "intValue",        "()I",                                     "A",   "I", GET,         I, __ATOMIC_SEQ_CST) \
+    X(ATOMIC_INT_GET_ACQUIRE,        ATOMIC_INTEGER,   "getAcquire",      "()I",                                     "A",   "I", GET,         I, __ATOMIC_ACQUIRE) \
+    X(ATOMIC_INT_SET,                ATOMIC_INTEGER,   "set",             "(I)V",                                    "AI",  "",  SET,         I, __ATOMIC_SEQ_CST) \
+    X(ATOMIC_INT_LAZY_SET,           ATOMIC_INTEGER,   "lazySet",         "(I)V",                                    "AI",  "",  SET,         I, __ATOMIC_RELEASE) \
+    X(ATOMIC_INT_SET_RELEASE,        ATOMIC_INTEGER,   "setRelease",      "(I)V",                                    "AI",  "",  SET,         I, __ATOMIC_RELEASE) \
+    X(ATOMIC_INT_COMPARE_AND_SET,    ATOMIC_INTEGER,   "compareAndSet",   "(II)Z",                                   "AII", "I", CAS,         I, __ATOMIC_SEQ_CST) \
+    X(ATOMIC_INT_GET_AND_SET,        ATOMIC_INTEGER,   "getAndSet",       "(I)I",                                    "AI",  "I", SWAP,        I, __ATOMIC_SEQ_CST) \
+    X(ATOMIC_INT_GET_AND_ADD,        ATOMIC_INTEGER,   "getAndAdd",       "(I)I",                                    "AI",  "I", GET_AND_ADD, I, ARGUMENT) \
+    X(ATOMIC_INT_ADD_AND_GET,        ATOMIC_INTEGER,   "addAndGet",       "(I)I",                                    "AI",  "I", ADD_AND_GET, I, ARGUMENT) \
+    X(ATOMIC_INT_GET_AND_INCREMENT,  ATOMIC_INTEGER,   "getAndIncrement", "()I",                                     "A",   "I", GET_AND_ADD, I, ONE) \
+    X(ATOMIC_INT_GET_AND_DECREMENT,  ATOMIC_INTEGER,   "getAndDecrement", "()I",                                     "A",   "I", GET_AND_ADD, I, MINUS_ONE) \
+    X(ATOMIC_INT_INCREMENT_AND_GET,  ATOMIC_INTEGER,   "incrementAndGet", "()I",                                     "A",   "I", ADD_AND_GET, I, ONE) \
+    X(ATOMIC_INT_DECREMENT_AND_GET,  ATOMIC_INTEGER,   "decrementAndGet", "()I",                                     "A",   "I", ADD_AND_GET, I, MINUS_ONE) \
+    X(ATOMIC_LONG_GET,               ATOMIC_LONG,      "get",             "()J",                                     "A",   "J", GET,         J, __ATOMIC_SEQ_CST) \
+    X(ATOMIC_LONG_LONG_VALUE,        ATOMIC_LONG,      "longValue",       "()J",                                     "A",   "J", GET,         J, __ATOMIC_SEQ_CST) \
+    X(ATOMIC_LONG_GET_ACQUIRE,       ATOMIC_LONG,      "getAcquire",      "()J",                                     "A",   "J", GET,         J, __ATOMIC_ACQUIRE) \
+    X(ATOMIC_LONG_SET,               ATOMIC_LONG,      "set",             "(J)V",                                    "AJ",  "",  SET,         J, __ATOMIC_SEQ_CST) \
+    X(ATOMIC_LONG_LAZY_SET,          ATOMIC_LONG,      "lazySet",         "(J)V",                                    "AJ",  "",  SET,         J, __ATOMIC_RELEASE) \
+    X(ATOMIC_LONG_SET_RELEASE,       ATOMIC_LONG,      "setRelease",      "(J)V",                                    "AJ",  "",  SET,         J, __ATOMIC_RELEASE) \
+    X(ATOMIC_LONG_COMPARE_AND_SET,   ATOMIC_LONG,      "compareAndSet",   "(JJ)Z",                                   "AJJ", "I", CAS,         J, __ATOMIC_SEQ_CST) \
+    X(ATOMIC_LONG_GET_AND_SET,       ATOMIC_LONG,      "getAndSet",       "(J)J",                                    "AJ",  "J", SWAP,        J, __ATOMIC_SEQ_CST) \
+    X(ATOMIC_LONG_GET_AND_ADD,       ATOMIC_LONG,      "getAndAdd",       "(J)J",                                    "AJ",  "J", GET_AND_ADD, J, ARGUMENT) \
+    X(ATOMIC_LONG_ADD_AND_GET,       ATOMIC_LONG,      "addAndGet",       "(J)J",                                    "AJ",  "J", ADD_AND_GET, J, ARGUMENT) \
+    X(ATOMIC_LONG_GET_AND_INCREMENT, ATOMIC_LONG,      "getAndIncrement", "()J",                                     "A",   "J", GET_AND_ADD, J, ONE) \
+    X(ATOMIC_LONG_GET_AND_DECREMENT, ATOMIC_LONG,      "getAndDecrement", "()J",                                     "A",   "J", GET_AND_ADD, J, MINUS_ONE) \
+    X(ATOMIC_LONG_INCREMENT_AND_GET, ATOMIC_LONG,      "incrementAndGet", "()J",                                     "A",   "J", ADD_AND_GET, J, ONE) \
+    X(ATOMIC_LONG_DECREMENT_AND_GET, ATOMIC_LONG,      "decrementAndGet", "()J",                                     "A",   "J", ADD_AND_GET, J, MINUS_ONE) \
+    X(ATOMIC_REF_GET,                ATOMIC_REFERENCE, "get",             "()Ljava/lang/Object;",                    "A",   "A", GET,         A, __ATOMIC_SEQ_CST) \
+    X(ATOMIC_REF_GET_ACQUIRE,        ATOMIC_REFERENCE, "getAcquire",      "()Ljava/lang/Object;",                    "A",   "A", GET,         A, __ATOMIC_ACQUIRE) \
+    X(ATOMIC_REF_SET,                ATOMIC_REFERENCE, "set",             "(Ljava/lang/Object;)V",                   "AA",  "",  SET,         A, __ATOMIC_SEQ_CST) \
+    X(ATOMIC_REF_LAZY_SET,           ATOMIC_REFERENCE, "lazySet",         "(Ljava/lang/Object;)V",                   "AA",  "",  SET,         A, __ATOMIC_RELEASE) \
+    X(ATOMIC_REF_SET_RELEASE,        ATOMIC_REFERENCE, "setRelease",      "(Ljava/lang/Object;)V",                   "AA",  "",  SET,         A, __ATOMIC_RELEASE) \
+    X(ATOMIC_REF_COMPARE_AND_SET,    ATOMIC_REFERENCE, "compareAndSet",   "(Ljava/lang/Object;Ljava/lang/Object;)Z", "AAA", "I", CAS,         A, __ATOMIC_SEQ_CST) \
+    X(ATOMIC_REF_GET_AND_SET,        ATOMIC_REFERENCE, "getAndSet",       "(Ljava/lang/Object;)Ljava/lang/Object;",  "AA",  "A", SWAP,        A, __ATOMIC_SEQ_CST)
+
+// Static description of an opcode, indexed by opcode
+typedef struct {
+    const char* name;       // NULL for undefined opcodes
+    uint8_t format;         // OperandFormat
+    const char* pops;       // Operand stack types consumed
+    const char* pushes;     // Operand stack types produced
+} OpcodeInfo;
+
+#endif // OPCODES_H
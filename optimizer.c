@@ -0,0 +1,917 @@
+#include "optimizer.h"
+#include "bytecode.h"
+#include "class_loader.h"
+#include "boxes.h"
+#include "atomics.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Maximum number of arguments of an inlined method
+#define INLINE_MAX_ARGS 32
+
+// Optimization pass over a method; removed instructions are turned into NOPs
+typedef bool (*OptimizerPass)(MethodInfo* method, const uint8_t* leaders);
+
+// Mark instructions that are branch targets and so start a basic block
+static uint8_t* find_leaders(MethodInfo* method) {
+    uint8_t* leaders = calloc(method->instructions_count + 1, 1);
+    if (!leaders) {
+        return NULL;
+    }
+
+    leaders[0] = 1;
+    for (uint32_t i = 0; i < method->instructions_count; i++) {
+        int32_t* target = instruction_branch_target(&method->instructions[i]);
+        if (target) {
+            leaders[*target] = 1;
+        }
+    }
+    for (uint32_t i = 0; i < method->switch_tables_count; i++) {
+        SwitchTable* table = &method->switch_tables[i];
+        leaders[table->default_target] = 1;
+        for (uint32_t j = 0; j < table->count; j++) {
+            leaders[table->targets[j]] = 1;
+        }
+    }
+    // Handler ranges must keep their boundaries on instruction boundaries
+    for (uint32_t i = 0; i < method->exception_handlers_count; i++) {
+        ExceptionHandler* handler = &method->exception_handlers[i];
+        leaders[handler->start] = 1;
+        leaders[handler->end] = 1;
+        leaders[handler->handler] = 1;
+    }
+    return leaders;
+}
+
+// Fold the instruction after insn into insn, leaving a NOP behind
+static void absorb(Instruction* insn, Instruction* next) {
+    insn->length += next->length;
+    next->opcode = NOP;
+}
+
+// Remove NOPs and remap branch targets to the surviving instructions
+static void compact(MethodInfo* method) {
+    uint32_t count = method->instructions_count;
+    uint32_t* new_index = malloc((count + 1) * sizeof(uint32_t));
+    if (!new_index) {
+        return;
+    }
+
+    // A removed instruction maps to the next surviving one
+    uint32_t live = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        new_index[i] = live;
+        if (method->instructions[i].opcode != NOP) {
+            live++;
+        }
+    }
+    new_index[count] = live;
+
+    uint32_t out = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        Instruction insn = method->instructions[i];
+        if (insn.opcode == NOP) {
+            continue;
+        }
+        int32_t* target = instruction_branch_target(&insn);
+        if (target) {
+            *target = (int32_t)new_index[*target];
+        }
+        method->instructions[out++] = insn;
+    }
+    method->instructions_count = out;
+    for (uint32_t i = 0; i < method->switch_tables_count; i++) {
+        SwitchTable* table = &method->switch_tables[i];
+        table->default_target = (int32_t)new_index[table->default_target];
+        for (uint32_t j = 0; j < table->count; j++) {
+            table->targets[j] = (int32_t)new_index[table->targets[j]];
+        }
+    }
+    for (uint32_t i = 0; i < method->exception_handlers_count; i++) {
+        ExceptionHandler* handler = &method->exception_handlers[i];
+        handler->start = (int32_t)new_index[handler->start];
+        handler->end = (int32_t)new_index[handler->end];
+        handler->handler = (int32_t)new_index[handler->handler];
+    }
+    free(new_index);
+}
+
+// Evaluate a binary int operation at link time, if it cannot trap
+static bool fold_binary(uint16_t opcode, jint value1, jint value2, jint* result) {
+    switch (opcode) {
+        case IADD: *result = INT_ADD(value1, value2); return true;
+        case ISUB: *result = INT_SUB(value1, value2); return true;
+        case IMUL: *result = INT_MUL(value1, value2); return true;
+        case IAND: *result = BIT_AND(value1, value2); return true;
+        case IOR:  *result = BIT_OR(value1, value2); return true;
+        case IXOR: *result = BIT_XOR(value1, value2); return true;
+        case ISHL: *result = INT_SHL(value1, value2); return true;
+        case ISHR: *result = INT_SHR(value1, value2); return true;
+        case IUSHR: *result = INT_USHR(value1, value2); return true;
+        case MATH_MIN_I: *result = INTEGRAL_MIN(value1, value2); return true;
+        case MATH_MAX_I: *result = INTEGRAL_MAX(value1, value2); return true;
+        case IDIV:
+        case IREM:
+            // Division by zero must still raise at run time
+            if (value2 == 0) {
+                return false;
+            }
+            *result = opcode == IDIV ? INT_DIV(value1, value2) : INT_REM(value1, value2);
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Resolve ldc against the constant table: ints become iconst so they can
+// be folded, floats and interned strings skip the tag dispatch
+static void resolve_constants(const ClassInfo* class_info, MethodInfo* method) {
+    if (!class_info->constants) {
+        return;
+    }
+    for (uint32_t i = 0; i < method->instructions_count; i++) {
+        Instruction* insn = &method->instructions[i];
+        if (insn->opcode != LDC && insn->opcode != LDC_W) {
+            continue;
+        }
+        uint8_t tag = class_info->constant_pool[insn->a].tag;
+        if (tag == CONST_INTEGER) {
+            insn->a = class_info->constants[insn->a].i;
+            insn->opcode = ICONST;
+        } else if (tag == CONST_FLOAT || tag == CONST_STRING) {
+            insn->opcode = LDC_CONST;
+        }
+    }
+}
+
+// Bind the wrapper methods javac calls for autoboxing to intrinsics:
+// Integer.valueOf(int) becomes box I, and Integer.intValue() unbox I
+static void bind_box_intrinsics(const ClassInfo* class_info, MethodInfo* method) {
+    for (uint32_t i = 0; i < method->instructions_count; i++) {
+        Instruction* insn = &method->instructions[i];
+        if (insn->opcode != INVOKESTATIC && insn->opcode != INVOKEVIRTUAL) {
+            continue;
+        }
+        const char* class_name;
+        const char* name;
+        const char* descriptor;
+        if (constant_pool_member_ref(class_info, (uint16_t)insn->a, &class_name, &name, &descriptor) != 0) {
+            continue;
+        }
+        char type = insn->opcode == INVOKESTATIC ? box_method_type(class_name, name, descriptor)
+                                                 : unbox_method_type(class_name, name, descriptor);
+        if (type) {
+            insn->opcode = insn->opcode == INVOKESTATIC ? BOX : UNBOX;
+            insn->a = type;
+        }
+    }
+}
+
+// Link-time description of a math intrinsic, generated from its table
+typedef struct {
+    uint16_t opcode;
+    const char* class_name;
+    const char* name;
+    const char* descriptor;
+    const char* pops;
+    const char* pushes;
+} MathIntrinsic;
+
+static const MathIntrinsic math_intrinsics[] = {
+#define INTRINSIC_INFO(name, class_name, method, descriptor, pops, pushes, kind, type, result, op) \
+    { name, class_name, method, descriptor, pops, pushes },
+    MATH_INTRINSICS(INTRINSIC_INFO)
+#undef INTRINSIC_INFO
+};
+
+#define MATH_INTRINSICS_COUNT (sizeof(math_intrinsics) / sizeof(math_intrinsics[0]))
+
+static const MathIntrinsic* find_math_intrinsic(uint16_t opcode) {
+    for (size_t i = 0; i < MATH_INTRINSICS_COUNT; i++) {
+        if (math_intrinsics[i].opcode == opcode) {
+            return &math_intrinsics[i];
+        }
+    }
+    return NULL;
+}
+
+// Bind calls of Math, Integer and Long methods with a single-operation
+// implementation to their intrinsic opcodes
+static void bind_math_intrinsics(const ClassInfo* class_info, MethodInfo* method) {
+    for (uint32_t i = 0; i < method->instructions_count; i++) {
+        Instruction* insn = &method->instructions[i];
+        if (insn->opcode != INVOKESTATIC) {
+            continue;
+        }
+        const char* class_name;
+        const char* name;
+        const char* descriptor;
+        if (constant_pool_member_ref(class_info, (uint16_t)insn->a, &class_name, &name, &descriptor) != 0) {
+            continue;
+        }
+        for (size_t j = 0; j < MATH_INTRINSICS_COUNT; j++) {
+            const MathIntrinsic* intrinsic = &math_intrinsics[j];
+            if (strcmp(intrinsic->name, name) == 0 && strcmp(intrinsic->descriptor, descriptor) == 0 &&
+                strcmp(intrinsic->class_name, class_name) == 0) {
+                insn->opcode = intrinsic->opcode;
+                break;
+            }
+        }
+    }
+}
+
+// Bind calls of atomic class methods to their intrinsic opcodes, so that
+// they run as a single atomic instruction
+static void bind_atomic_intrinsics(const ClassInfo* class_info, MethodInfo* method) {
+    for (uint32_t i = 0; i < method->instructions_count; i++) {
+        Instruction* insn = &method->instructions[i];
+        if (insn->opcode != INVOKEVIRTUAL) {
+            continue;
+        }
+        const char* class_name;
+        const char* name;
+        const char* descriptor;
+        if (constant_pool_member_ref(class_info, (uint16_t)insn->a, &class_name, &name, &descriptor) != 0) {
+            continue;
+        }
+        uint16_t opcode = atomic_method_opcode(class_name, name, descriptor);
+        if (opcode) {
+            insn->opcode = opcode;
+        }
+    }
+}
+
+// Evaluate a unary int operation at link time
+static bool fold_unary(uint16_t opcode, jint value, jint* result) {
+    switch (opcode) {
+        case INEG: *result = INT_NEG(value); return true;
+        case MATH_ABS_I: *result = INT_ABS(value); return true;
+        case INTEGER_BIT_COUNT: *result = INT_POPCOUNT(value); return true;
+        case INTEGER_LEADING_ZEROS: *result = INT_CLZ(value); return true;
+        case INTEGER_TRAILING_ZEROS: *result = INT_CTZ(value); return true;
+        default: return false;
+    }
+}
+
+// Constant folding: iconst a; op -> iconst (op a), and
+// iconst a; iconst b; op -> iconst (a op b)
+static bool fold_constants(MethodInfo* method, const uint8_t* leaders) {
+    Instruction* code = method->instructions;
+    uint32_t count = method->instructions_count;
+    bool changed = false;
+
+    for (uint32_t i = 0; i + 1 < count; i++) {
+        if (code[i].opcode != ICONST || leaders[i + 1]) {
+            continue;
+        }
+
+        jint result;
+        if (fold_unary(code[i + 1].opcode, code[i].a, &result)) {
+            code[i].a = result;
+            absorb(&code[i], &code[i + 1]);
+            changed = true;
+            i++;
+            continue;
+        }
+
+        if (i + 2 < count && code[i + 1].opcode == ICONST && !leaders[i + 2] &&
+            fold_binary(code[i + 2].opcode, code[i].a, code[i + 1].a, &result)) {
+            code[i].a = result;
+            absorb(&code[i], &code[i + 1]);
+            absorb(&code[i], &code[i + 2]);
+            changed = true;
+            i += 2;
+        }
+    }
+    return changed;
+}
+
+// Record the locals read by an instruction; false if it cannot be determined
+static bool collect_local_reads(const Instruction* insn, bool* read, uint16_t max_locals) {
+    int32_t slots[2];
+    int n = 0;
+
+    switch (insn->opcode) {
+        case ILOAD:
+        case FLOAD:
+        case ALOAD:
+        case ILOAD_ICONST_IF_ICMPEQ: case ILOAD_ICONST_IF_ICMPNE:
+        case ILOAD_ICONST_IF_ICMPLT: case ILOAD_ICONST_IF_ICMPGE:
+        case ILOAD_ICONST_IF_ICMPGT: case ILOAD_ICONST_IF_ICMPLE:
+        case IINC:
+        case RET:
+            slots[n++] = insn->a;
+            break;
+        case LLOAD:
+        case DLOAD:
+            slots[n++] = insn->a;
+            slots[n++] = insn->a + 1;
+            break;
+        case ILOAD_ILOAD_IADD_ISTORE:
+        case ILOAD_ILOAD_ISUB_ISTORE:
+        case ILOAD_ILOAD_IMUL_ISTORE:
+            slots[n++] = insn->a;
+            slots[n++] = insn->b;
+            break;
+        default:
+            return true;
+    }
+
+    for (int i = 0; i < n; i++) {
+        if (slots[i] < 0 || slots[i] >= max_locals) {
+            return false;
+        }
+        read[slots[i]] = true;
+    }
+    return true;
+}
+
+// Dead store removal: stores to locals that are never read become pops,
+// and "load x; store x" pairs disappear entirely
+static bool remove_dead_stores(MethodInfo* method, const uint8_t* leaders) {
+    Instruction* code = method->instructions;
+    uint32_t count = method->instructions_count;
+    bool changed = false;
+
+    if (method->max_locals == 0) {
+        return false;
+    }
+
+    bool* read = calloc(method->max_locals, sizeof(bool));
+    if (!read) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (!collect_local_reads(&code[i], read, method->max_locals)) {
+            free(read);
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint16_t op = code[i].opcode;
+        bool wide = op == LSTORE || op == DSTORE;
+        if (op != ISTORE && op != FSTORE && op != ASTORE && !wide) {
+            continue;
+        }
+        if (code[i].a < 0 || code[i].a >= method->max_locals) {
+            continue;
+        }
+
+        if (!read[code[i].a]) {
+            code[i].opcode = wide ? POP2 : POP;
+            changed = true;
+        } else if (i > 0 && !leaders[i] && code[i - 1].a == code[i].a &&
+                   ((op == ISTORE && code[i - 1].opcode == ILOAD) ||
+                    (op == LSTORE && code[i - 1].opcode == LLOAD) ||
+                    (op == FSTORE && code[i - 1].opcode == FLOAD) ||
+                    (op == DSTORE && code[i - 1].opcode == DLOAD) ||
+                    (op == ASTORE && code[i - 1].opcode == ALOAD))) {
+            code[i - 1].opcode = NOP;
+            code[i].opcode = NOP;
+            changed = true;
+        }
+    }
+
+    free(read);
+    return changed;
+}
+
+// Remove values that are pushed and immediately popped
+static bool remove_unused_values(MethodInfo* method, const uint8_t* leaders) {
+    Instruction* code = method->instructions;
+    uint32_t count = method->instructions_count;
+    bool changed = false;
+
+    for (uint32_t i = 0; i + 1 < count; i++) {
+        if ((code[i + 1].opcode != POP && code[i + 1].opcode != POP2) || leaders[i + 1]) {
+            continue;
+        }
+        bool unused;
+        switch (code[i].opcode) {
+            case ICONST:
+            case ACONST_NULL:
+            case FCONST_0: case FCONST_1: case FCONST_2:
+            case LDC_CONST:
+            case ILOAD:
+            case FLOAD:
+            case ALOAD:
+            case DUP:
+                unused = code[i + 1].opcode == POP;
+                break;
+            case LCONST_0: case LCONST_1:
+            case DCONST_0: case DCONST_1:
+            case LDC2_W:
+            case LLOAD:
+            case DLOAD:
+            case DUP2:
+                unused = code[i + 1].opcode == POP2;
+                break;
+            default:
+                unused = false;
+                break;
+        }
+        if (unused) {
+            code[i].opcode = NOP;
+            code[i + 1].opcode = NOP;
+            changed = true;
+            i++;
+        }
+    }
+    return changed;
+}
+
+// Remove a value boxed only to be unboxed again: box T; unbox T. The box
+// is never null, so the pair cannot throw.
+static bool cancel_box_unbox(MethodInfo* method, const uint8_t* leaders) {
+    Instruction* code = method->instructions;
+    uint32_t count = method->instructions_count;
+    bool changed = false;
+
+    for (uint32_t i = 0; i + 1 < count; i++) {
+        if (code[i].opcode == BOX && code[i + 1].opcode == UNBOX &&
+            code[i].a == code[i + 1].a && !leaders[i + 1]) {
+            code[i].opcode = NOP;
+            code[i + 1].opcode = NOP;
+            changed = true;
+            i++;
+        }
+    }
+    return changed;
+}
+
+// Superinstructions for the most common sequences emitted by javac
+static bool fuse_superinstructions(MethodInfo* method, const uint8_t* leaders) {
+    Instruction* code = method->instructions;
+    uint32_t count = method->instructions_count;
+    bool changed = false;
+
+    for (uint32_t i = 0; i + 1 < count; i++) {
+        Instruction* insn = &code[i];
+
+        // iload a; iload b; iadd|isub|imul; istore c
+        if (insn->opcode == ILOAD && i + 3 < count &&
+            code[i + 1].opcode == ILOAD && code[i + 3].opcode == ISTORE &&
+            !leaders[i + 1] && !leaders[i + 2] && !leaders[i + 3]) {
+            uint16_t fused = 0;
+            switch (code[i + 2].opcode) {
+                case IADD: fused = ILOAD_ILOAD_IADD_ISTORE; break;
+                case ISUB: fused = ILOAD_ILOAD_ISUB_ISTORE; break;
+                case IMUL: fused = ILOAD_ILOAD_IMUL_ISTORE; break;
+                default: break;
+            }
+            if (fused) {
+                insn->b = code[i + 1].a;
+                insn->c = code[i + 3].a;
+                insn->opcode = fused;
+                absorb(insn, &code[i + 1]);
+                absorb(insn, &code[i + 2]);
+                absorb(insn, &code[i + 3]);
+                changed = true;
+                i += 3;
+                continue;
+            }
+        }
+
+        // iload a; iconst b; if_icmp<cond> c
+        if (insn->opcode == ILOAD && i + 2 < count &&
+            code[i + 1].opcode == ICONST &&
+            code[i + 2].opcode >= IF_ICMPEQ && code[i + 2].opcode <= IF_ICMPLE &&
+            !leaders[i + 1] && !leaders[i + 2]) {
+            insn->b = code[i + 1].a;
+            insn->c = code[i + 2].a;
+            insn->opcode = ILOAD_ICONST_IF_ICMPEQ + (code[i + 2].opcode - IF_ICMPEQ);
+            absorb(insn, &code[i + 1]);
+            absorb(insn, &code[i + 2]);
+            changed = true;
+            i += 2;
+        }
+    }
+    return changed;
+}
+
+// Resolve a methodref to a method of the class being optimized
+static MethodInfo* resolve_local_method(ClassInfo* class_info, uint16_t index) {
+    const char* class_name;
+    const char* name;
+    const char* descriptor;
+    if (constant_pool_member_ref(class_info, index, &class_name, &name, &descriptor) != 0 ||
+        class_info->constant_pool[index].tag != CONST_METHODREF ||
+        !class_info->name || strcmp(class_name, class_info->name) != 0) {
+        return NULL;
+    }
+
+    for (uint16_t i = 0; i < class_info->methods_count; i++) {
+        MethodInfo* method = &class_info->methods[i];
+        if (method->name && method->descriptor &&
+            strcmp(method->name, name) == 0 && strcmp(method->descriptor, descriptor) == 0) {
+            return method;
+        }
+    }
+    return NULL;
+}
+
+// Operand stack effect, in values rather than slots, of an instruction the
+// inliner knows how to move
+static bool stack_effect(const Instruction* insn, int* pops, int* pushes) {
+    *pops = 0;
+    *pushes = 0;
+
+    switch (insn->opcode) {
+        case ILOAD_ILOAD_IADD_ISTORE:
+        case ILOAD_ILOAD_ISUB_ISTORE:
+        case ILOAD_ILOAD_IMUL_ISTORE:
+        case ILOAD_ICONST_IF_ICMPEQ: case ILOAD_ICONST_IF_ICMPNE:
+        case ILOAD_ICONST_IF_ICMPLT: case ILOAD_ICONST_IF_ICMPGE:
+        case ILOAD_ICONST_IF_ICMPGT: case ILOAD_ICONST_IF_ICMPLE:
+        case SWAP:
+            return true;
+
+        case ICONST:
+        case LDC: case LDC_W: case LDC2_W: case LDC_CONST:
+        case DUP:
+            *pushes = 1;
+            return true;
+
+        case POP:
+            *pops = 1;
+            return true;
+
+        case BOX:
+        case UNBOX:
+            *pops = 1;
+            *pushes = 1;
+            return true;
+
+        // Control flow the inliner cannot rewrite
+        case TABLESWITCH: case LOOKUPSWITCH:
+        case JSR: case RET:
+        case ATHROW:
+            return false;
+
+        default:
+            break;
+    }
+
+    // Everything else from its stack signature in the opcode table
+    if (insn->opcode > 0xff) {
+        const MathIntrinsic* intrinsic = find_math_intrinsic(insn->opcode);
+        if (!intrinsic) {
+            return atomic_stack_effect(insn->opcode, pops, pushes);
+        }
+        *pops = (int)strlen(intrinsic->pops);
+        *pushes = (int)strlen(intrinsic->pushes);
+        return true;
+    }
+    const OpcodeInfo* info = &opcode_info[insn->opcode];
+    if (!info->name || strchr(info->pops, '?') || strchr(info->pushes, '?')) {
+        return false;
+    }
+    *pops = (int)strlen(info->pops);
+    *pushes = (int)strlen(info->pushes);
+    return true;
+}
+
+static bool is_return(uint16_t opcode) {
+    return opcode >= IRETURN && opcode <= RETURN;
+}
+
+// Check that a callee can be inlined: only instructions with known stack
+// effects, and an operand stack holding just the result at every return
+static bool is_inlinable_body(const MethodInfo* callee) {
+    uint32_t count = callee->instructions_count;
+    int* depth = malloc(count * sizeof(int));
+    uint32_t* worklist = malloc(count * sizeof(uint32_t));
+    if (!depth || !worklist) {
+        free(depth);
+        free(worklist);
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        depth[i] = -1;
+    }
+
+    bool ok = true;
+    uint32_t pending = 0;
+    depth[0] = 0;
+    worklist[pending++] = 0;
+
+    while (ok && pending > 0) {
+        uint32_t i = worklist[--pending];
+        Instruction insn = callee->instructions[i];
+        int pops, pushes;
+        if (!stack_effect(&insn, &pops, &pushes) || depth[i] < pops) {
+            ok = false;
+            break;
+        }
+        if (is_return(insn.opcode)) {
+            ok = depth[i] == (insn.opcode == RETURN ? 0 : 1);
+            continue;
+        }
+
+        int next_depth = depth[i] - pops + pushes;
+        uint32_t successors[2];
+        int successor_count = 0;
+        int32_t* target = instruction_branch_target(&insn);
+        if (target) {
+            successors[successor_count++] = (uint32_t)*target;
+        }
+        if (insn.opcode != GOTO) {
+            successors[successor_count++] = i + 1;
+        }
+
+        for (int s = 0; s < successor_count; s++) {
+            uint32_t next = successors[s];
+            if (next >= count) {
+                // Falling off the end of the method
+                ok = false;
+            } else if (depth[next] < 0) {
+                depth[next] = next_depth;
+                worklist[pending++] = next;
+            } else if (depth[next] != next_depth) {
+                ok = false;
+            }
+        }
+    }
+
+    free(depth);
+    free(worklist);
+    return ok;
+}
+
+// Rename the locals of an inlined instruction above the caller's locals
+static void rename_locals(Instruction* insn, int32_t base) {
+    switch (insn->opcode) {
+        case ILOAD: case LLOAD: case FLOAD: case DLOAD: case ALOAD:
+        case ISTORE: case LSTORE: case FSTORE: case DSTORE: case ASTORE:
+        case ILOAD_ICONST_IF_ICMPEQ: case ILOAD_ICONST_IF_ICMPNE:
+        case ILOAD_ICONST_IF_ICMPLT: case ILOAD_ICONST_IF_ICMPGE:
+        case ILOAD_ICONST_IF_ICMPGT: case ILOAD_ICONST_IF_ICMPLE:
+        case IINC:
+        case RET:
+            insn->a += base;
+            break;
+        case ILOAD_ILOAD_IADD_ISTORE:
+        case ILOAD_ILOAD_ISUB_ISTORE:
+        case ILOAD_ILOAD_IMUL_ISTORE:
+            insn->a += base;
+            insn->b += base;
+            insn->c += base;
+            break;
+        default:
+            break;
+    }
+}
+
+// Store opcode that moves an argument of the given type into a local
+static uint16_t store_for_type(char type) {
+    switch (type) {
+        case 'J': return LSTORE;
+        case 'F': return FSTORE;
+        case 'D': return DSTORE;
+        case 'L': return ASTORE;
+        default: return ISTORE;
+    }
+}
+
+// Whether a call site lies inside a loop, i.e. a later branch jumps back over it
+static bool is_in_loop(const MethodInfo* method, uint32_t site) {
+    for (uint32_t i = site; i < method->instructions_count; i++) {
+        Instruction insn = method->instructions[i];
+        int32_t* target = instruction_branch_target(&insn);
+        if (target && (uint32_t)*target <= site) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Find the callee of an invoke that can be inlined at this site, if any
+static MethodInfo* inline_candidate(ClassInfo* class_info, MethodInfo* caller, uint32_t site) {
+    Instruction* insn = &caller->instructions[site];
+    MethodInfo* callee = resolve_local_method(class_info, (uint16_t)insn->a);
+    if (!callee || callee == caller || !callee->instructions ||
+        (callee->access_flags & (ACC_SYNCHRONIZED | ACC_NATIVE | ACC_ABSTRACT))) {
+        return NULL;
+    }
+
+    // Only call sites whose target is known at link time
+    switch (insn->opcode) {
+        case INVOKESTATIC:
+            if (!(callee->access_flags & ACC_STATIC)) {
+                return NULL;
+            }
+            break;
+        case INVOKESPECIAL:
+            if (!(callee->access_flags & ACC_PRIVATE) || strcmp(callee->name, "<init>") == 0) {
+                return NULL;
+            }
+            break;
+        case INVOKEVIRTUAL:
+            // Devirtualized: private and final methods cannot be overridden
+            if ((callee->access_flags & ACC_STATIC) ||
+                !(callee->access_flags & (ACC_PRIVATE | ACC_FINAL))) {
+                return NULL;
+            }
+            break;
+        default:
+            return NULL;
+    }
+
+    // Callee handlers would have to be merged into the caller's table
+    if (callee->exception_handlers_count > 0) {
+        return NULL;
+    }
+
+    // Size heuristic, with a larger budget for hot call sites in loops
+    uint32_t limit = is_in_loop(caller, site) ? INLINE_HOT_MAX_SIZE : INLINE_MAX_SIZE;
+    if (callee->code_length > limit ||
+        caller->instructions_count + callee->instructions_count > INLINE_MAX_CALLER_SIZE ||
+        caller->max_locals + callee->max_locals > INLINE_MAX_LOCALS) {
+        return NULL;
+    }
+
+    if (!is_inlinable_body(callee)) {
+        return NULL;
+    }
+    return callee;
+}
+
+// Replace the invoke at site with argument stores and the callee's body,
+// with callee locals renamed from base up; returns the number of
+// instructions inserted (0 on failure)
+static uint32_t inline_call(MethodInfo* caller, uint32_t site, MethodInfo* callee, int32_t base) {
+    char types[INLINE_MAX_ARGS + 1];
+    int arg_count = parse_method_descriptor(callee->descriptor, types + 1, INLINE_MAX_ARGS);
+    if (arg_count < 0) {
+        return 0;
+    }
+
+    // The receiver of an instance method is its first argument
+    char* arg_types = types + 1;
+    if (!(callee->access_flags & ACC_STATIC)) {
+        types[0] = 'L';
+        arg_types = types;
+        arg_count++;
+    }
+
+    uint32_t body_count = callee->instructions_count;
+    uint32_t insert_count = (uint32_t)arg_count + body_count;
+    uint32_t old_count = caller->instructions_count;
+    uint32_t new_count = old_count - 1 + insert_count;
+
+    Instruction* code = malloc(new_count * sizeof(Instruction));
+    if (!code) {
+        return 0;
+    }
+
+    // Caller code around the call site, with branch targets shifted
+    for (uint32_t i = 0; i < old_count; i++) {
+        if (i == site) {
+            continue;
+        }
+        Instruction insn = caller->instructions[i];
+        int32_t* target = instruction_branch_target(&insn);
+        if (target && (uint32_t)*target > site) {
+            *target += (int32_t)insert_count - 1;
+        }
+        code[i < site ? i : i - 1 + insert_count] = insn;
+    }
+    for (uint32_t i = 0; i < caller->switch_tables_count; i++) {
+        SwitchTable* table = &caller->switch_tables[i];
+        if ((uint32_t)table->default_target > site) {
+            table->default_target += (int32_t)insert_count - 1;
+        }
+        for (uint32_t j = 0; j < table->count; j++) {
+            if ((uint32_t)table->targets[j] > site) {
+                table->targets[j] += (int32_t)insert_count - 1;
+            }
+        }
+    }
+    // Handler ranges around the call site now cover the inlined body
+    for (uint32_t i = 0; i < caller->exception_handlers_count; i++) {
+        ExceptionHandler* handler = &caller->exception_handlers[i];
+        if ((uint32_t)handler->start > site) {
+            handler->start += (int32_t)insert_count - 1;
+        }
+        if ((uint32_t)handler->end > site) {
+            handler->end += (int32_t)insert_count - 1;
+        }
+        if ((uint32_t)handler->handler > site) {
+            handler->handler += (int32_t)insert_count - 1;
+        }
+    }
+
+    // Pop arguments into the renamed callee locals, last argument first
+    Instruction call = caller->instructions[site];
+    int32_t slots[INLINE_MAX_ARGS + 1];
+    int32_t slot = base;
+    for (int i = 0; i < arg_count; i++) {
+        slots[i] = slot;
+        slot += (arg_types[i] == 'J' || arg_types[i] == 'D') ? 2 : 1;
+    }
+    for (int i = 0; i < arg_count; i++) {
+        Instruction* store = &code[site + (uint32_t)i];
+        memset(store, 0, sizeof(Instruction));
+        store->opcode = store_for_type(arg_types[arg_count - 1 - i]);
+        store->a = slots[arg_count - 1 - i];
+        store->offset = call.offset;
+        store->length = i == 0 ? call.length : 0;
+    }
+
+    // Callee body; returns leave the result on the stack and jump past the body
+    uint32_t body_start = site + (uint32_t)arg_count;
+    uint32_t body_end = body_start + body_count;
+    for (uint32_t i = 0; i < body_count; i++) {
+        Instruction insn = callee->instructions[i];
+        insn.offset = call.offset;
+        insn.length = 0;
+        int32_t* target = instruction_branch_target(&insn);
+        if (target) {
+            *target += (int32_t)body_start;
+        }
+        rename_locals(&insn, base);
+        if (is_return(insn.opcode)) {
+            memset(&insn, 0, sizeof(Instruction));
+            insn.offset = call.offset;
+            insn.opcode = i + 1 == body_count ? NOP : GOTO;
+            insn.a = (int32_t)body_end;
+        }
+        code[body_start + i] = insn;
+    }
+
+    free(caller->instructions);
+    caller->instructions = code;
+    caller->instructions_count = new_count;
+    if (base + callee->max_locals > caller->max_locals) {
+        caller->max_locals = (uint16_t)(base + callee->max_locals);
+    }
+    caller->max_stack = (uint16_t)(caller->max_stack + callee->max_stack);
+    return insert_count;
+}
+
+// Inline small static, private and final methods of the same class
+static bool inline_calls(ClassInfo* class_info, MethodInfo* method) {
+    bool changed = false;
+
+    // Inlined bodies never overlap in time, so they share the locals above the caller's
+    int32_t base = method->max_locals;
+
+    for (uint32_t i = 0; i < method->instructions_count; i++) {
+        MethodInfo* callee = inline_candidate(class_info, method, i);
+        uint32_t inserted = callee ? inline_call(method, i, callee, base) : 0;
+        if (inserted > 0) {
+            changed = true;
+            // Continue after the inlined body
+            i += inserted - 1;
+        }
+    }
+    return changed;
+}
+
+// Run a single pass and compact the code if it changed anything
+static bool run_pass(MethodInfo* method, OptimizerPass pass) {
+    uint8_t* leaders = find_leaders(method);
+    if (!leaders) {
+        return false;
+    }
+
+    bool changed = pass(method, leaders);
+    free(leaders);
+    if (changed) {
+        compact(method);
+    }
+    return changed;
+}
+
+// Optimize pre-decoded method code in place
+void optimize_method(ClassInfo* class_info, MethodInfo* method) {
+    if (!method || !method->instructions || method->instructions_count == 0) {
+        return;
+    }
+
+    if (class_info) {
+        resolve_constants(class_info, method);
+        bind_box_intrinsics(class_info, method);
+        bind_math_intrinsics(class_info, method);
+        bind_atomic_intrinsics(class_info, method);
+    }
+
+    // Inline first so the callee bodies are optimized in their new context
+    if (class_info && inline_calls(class_info, method)) {
+        compact(method);
+    }
+
+    // Simplifications feed each other, so iterate until nothing changes
+    bool changed;
+    do {
+        changed = false;
+        changed |= run_pass(method, fold_constants);
+        changed |= run_pass(method, remove_dead_stores);
+        changed |= run_pass(method, remove_unused_values);
+        changed |= run_pass(method, cancel_box_unbox);
+    } while (changed);
+
+    run_pass(method, fuse_superinstructions);
+}
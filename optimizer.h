@@ -0,0 +1,20 @@
+// optimizer.h - Link-time optimization of pre-decoded method code
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "jvm.h"
+
+// Inlining limits, in bytes of callee bytecode
+#define INLINE_MAX_SIZE 35
+#define INLINE_HOT_MAX_SIZE 100
+
+// Largest caller, in instructions, that inlining may grow
+#define INLINE_MAX_CALLER_SIZE 2000
+
+// Callee locals are renamed above the caller's, within one frame's locals
+#define INLINE_MAX_LOCALS 256
+
+// Public API functions
+void optimize_method(ClassInfo* class_info, MethodInfo* method);
+
+#endif // OPTIMIZER_H
@@ -0,0 +1,155 @@
+#define _POSIX_C_SOURCE 200809L
+#include "safepoints.h"
+#include <time.h>
+
+// Threads of all instances, which share the scheduler's workers: a
+// safepoint stops them all
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t stopped;     // A thread left Java while a safepoint is pending
+    pthread_cond_t resumed;     // The world resumed
+    JVM* threads;               // Attached threads, linked through safepoint_next
+    SafepointStatistics statistics;
+} Safepoint;
+
+int safepoint_pending;
+
+static Safepoint safepoint = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .stopped = PTHREAD_COND_INITIALIZER,
+    .resumed = PTHREAD_COND_INITIALIZER,
+};
+
+static uint64_t monotonic_nanos(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+// Start running Java code on jvm's thread, first waiting for a pending
+// safepoint. The state is published before the flag is read, and a
+// requester sets the flag before reading states, so one of them sees the
+// other.
+void safepoint_enter_java(JVM* jvm) {
+    for (;;) {
+        __atomic_store_n(&jvm->safepoint_state, SAFEPOINT_IN_JAVA, __ATOMIC_SEQ_CST);
+        if (!__atomic_load_n(&safepoint_pending, __ATOMIC_SEQ_CST)) {
+            return;
+        }
+        safepoint_leave_java(jvm);
+        pthread_mutex_lock(&safepoint.lock);
+        while (__atomic_load_n(&safepoint_pending, __ATOMIC_RELAXED)) {
+            pthread_cond_wait(&safepoint.resumed, &safepoint.lock);
+        }
+        pthread_mutex_unlock(&safepoint.lock);
+    }
+}
+
+// Stop running Java code, for a native or a blocking wait, waking a
+// requester waiting for the thread
+void safepoint_leave_java(JVM* jvm) {
+    __atomic_store_n(&jvm->safepoint_state, SAFEPOINT_OUTSIDE_JAVA, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&safepoint_pending, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&safepoint.lock);
+        pthread_cond_broadcast(&safepoint.stopped);
+        pthread_mutex_unlock(&safepoint.lock);
+    }
+}
+
+// Slow path of a poll: stopped until the world resumes
+void safepoint_block(JVM* jvm) {
+    safepoint_leave_java(jvm);
+    safepoint_enter_java(jvm);
+}
+
+// Make jvm's thread one a safepoint waits for, and start it running Java
+void safepoint_attach(JVM* jvm) {
+    jvm->safepoint_state = SAFEPOINT_OUTSIDE_JAVA;
+    pthread_mutex_lock(&safepoint.lock);
+    jvm->safepoint_prev = NULL;
+    jvm->safepoint_next = safepoint.threads;
+    if (safepoint.threads) {
+        safepoint.threads->safepoint_prev = jvm;
+    }
+    safepoint.threads = jvm;
+    pthread_mutex_unlock(&safepoint.lock);
+    safepoint_enter_java(jvm);
+}
+
+// Stop running Java for good
+void safepoint_detach(JVM* jvm) {
+    safepoint_leave_java(jvm);
+    pthread_mutex_lock(&safepoint.lock);
+    if (jvm->safepoint_prev) {
+        jvm->safepoint_prev->safepoint_next = jvm->safepoint_next;
+    } else {
+        safepoint.threads = jvm->safepoint_next;
+    }
+    if (jvm->safepoint_next) {
+        jvm->safepoint_next->safepoint_prev = jvm->safepoint_prev;
+    }
+    pthread_cond_broadcast(&safepoint.stopped);
+    pthread_mutex_unlock(&safepoint.lock);
+}
+
+static bool all_threads_stopped(void) {
+    for (JVM* thread = safepoint.threads; thread; thread = thread->safepoint_next) {
+        if (__atomic_load_n(&thread->safepoint_state, __ATOMIC_SEQ_CST) == SAFEPOINT_IN_JAVA) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Bring every thread running Java to a poll and keep it there until
+// safepoint_resume_the_world. The caller must be outside Java, as in a
+// native; one safepoint is requested at a time.
+void safepoint_stop_the_world(void) {
+    pthread_mutex_lock(&safepoint.lock);
+    while (__atomic_load_n(&safepoint_pending, __ATOMIC_RELAXED)) {
+        pthread_cond_wait(&safepoint.resumed, &safepoint.lock);
+    }
+    uint64_t start = monotonic_nanos();
+    __atomic_store_n(&safepoint_pending, 1, __ATOMIC_SEQ_CST);
+    while (!all_threads_stopped()) {
+        pthread_cond_wait(&safepoint.stopped, &safepoint.lock);
+    }
+
+    uint64_t time_to_safepoint = monotonic_nanos() - start;
+    safepoint.statistics.count++;
+    safepoint.statistics.total_nanos += time_to_safepoint;
+    if (time_to_safepoint > safepoint.statistics.max_nanos) {
+        safepoint.statistics.max_nanos = time_to_safepoint;
+    }
+    pthread_mutex_unlock(&safepoint.lock);
+}
+
+void safepoint_resume_the_world(void) {
+    pthread_mutex_lock(&safepoint.lock);
+    __atomic_store_n(&safepoint_pending, 0, __ATOMIC_SEQ_CST);
+    pthread_cond_broadcast(&safepoint.resumed);
+    pthread_mutex_unlock(&safepoint.lock);
+}
+
+void safepoint_get_statistics(SafepointStatistics* statistics) {
+    pthread_mutex_lock(&safepoint.lock);
+    *statistics = safepoint.statistics;
+    pthread_mutex_unlock(&safepoint.lock);
+}
+
+// System.gc(): objects live until their instance is destroyed, so there is
+// nothing to collect, but the threads stop at a safepoint as for a
+// stop-the-world collection
+static int native_system_gc(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)jvm;
+    (void)frame;
+    (void)args;
+    (void)result;
+    safepoint_stop_the_world();
+    safepoint_resume_the_world();
+    return 0;
+}
+
+void register_safepoint_native_methods(Runtime* runtime) {
+    runtime_register_blocking_native_method(runtime, "java/lang/System", "gc", "()V", native_system_gc);
+}
@@ -0,0 +1,47 @@
+// safepoints.h - Stopping every Java thread at a known point
+#ifndef SAFEPOINTS_H
+#define SAFEPOINTS_H
+
+#include "jvm.h"
+
+// States of a thread that a safepoint waits for: running Java code, which
+// only stops at a poll, or outside it, blocked or in a library native,
+// where it counts as stopped. Natives of the VM that work on objects run
+// in Java.
+#define SAFEPOINT_OUTSIDE_JAVA 0
+#define SAFEPOINT_IN_JAVA 1
+
+// Time threads took to reach the safepoints requested so far
+typedef struct {
+    uint64_t count;
+    uint64_t total_nanos;       // Summed from each request until every thread stopped
+    uint64_t max_nanos;
+} SafepointStatistics;
+
+// Set while a thread stops the world; the interpreter polls it at backward
+// branches and method returns
+extern int safepoint_pending;
+
+// Public API functions
+void safepoint_attach(JVM* jvm);
+void safepoint_detach(JVM* jvm);
+void safepoint_enter_java(JVM* jvm);
+void safepoint_leave_java(JVM* jvm);
+void safepoint_block(JVM* jvm);
+void safepoint_stop_the_world(void);
+void safepoint_resume_the_world(void);
+void safepoint_get_statistics(SafepointStatistics* statistics);
+void register_safepoint_native_methods(Runtime* runtime);
+
+static inline bool safepoint_requested(void) {
+    return __atomic_load_n(&safepoint_pending, __ATOMIC_RELAXED) != 0;
+}
+
+// Stop at a pending safepoint until the world resumes
+static inline void safepoint_poll(JVM* jvm) {
+    if (safepoint_requested()) {
+        safepoint_block(jvm);
+    }
+}
+
+#endif // SAFEPOINTS_H
@@ -0,0 +1,224 @@
+#include "string_kernels.h"
+#include <string.h>
+
+// 31^8 mod 2^32: eight steps of the String.hashCode recurrence at once
+#define HASH_MULTIPLIER_8 0x94446f01u
+
+// Scalar kernels, used on every CPU for short tails and as the fallback
+
+static inline uint16_t load_utf16(const uint8_t* s, size_t index) {
+    uint16_t c;
+    memcpy(&c, s + 2 * index, sizeof(c));
+    return c;
+}
+
+static size_t scalar_mismatch(const uint8_t* a, const uint8_t* b, size_t size) {
+    size_t i = 0;
+    while (i < size && a[i] == b[i]) {
+        i++;
+    }
+    return i;
+}
+
+static size_t scalar_find_latin1(const uint8_t* s, size_t length, uint8_t c) {
+    const uint8_t* match = memchr(s, c, length);
+    return match ? (size_t)(match - s) : length;
+}
+
+static size_t scalar_find_utf16(const uint8_t* s, size_t length, uint16_t c) {
+    size_t i = 0;
+    while (i < length && load_utf16(s, i) != c) {
+        i++;
+    }
+    return i;
+}
+
+static uint32_t scalar_hash_latin1(const uint8_t* s, size_t length) {
+    uint32_t hash = 0;
+    for (size_t i = 0; i < length; i++) {
+        hash = 31 * hash + s[i];
+    }
+    return hash;
+}
+
+static uint32_t scalar_hash_utf16(const uint8_t* s, size_t length) {
+    uint32_t hash = 0;
+    for (size_t i = 0; i < length; i++) {
+        hash = 31 * hash + load_utf16(s, i);
+    }
+    return hash;
+}
+
+static const StringKernels scalar_kernels = {
+    "scalar",
+    scalar_mismatch,
+    scalar_find_latin1,
+    scalar_find_utf16,
+    scalar_hash_latin1,
+    scalar_hash_utf16,
+};
+
+const StringKernels* string_kernels = &scalar_kernels;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+
+#define SSE2 __attribute__((target("sse2")))
+#define AVX2 __attribute__((target("avx2")))
+
+// SSE2: 16 bytes per step. The hash stays scalar since SSE2 has no 32-bit
+// multiply.
+
+SSE2 static size_t sse2_mismatch(const uint8_t* a, const uint8_t* b, size_t size) {
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i*)(b + i));
+        unsigned differ = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) ^ 0xFFFFu;
+        if (differ) {
+            return i + (size_t)__builtin_ctz(differ);
+        }
+    }
+    return i + scalar_mismatch(a + i, b + i, size - i);
+}
+
+SSE2 static size_t sse2_find_latin1(const uint8_t* s, size_t length, uint8_t c) {
+    __m128i needle = _mm_set1_epi8((char)c);
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(s + i));
+        unsigned found = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(x, needle));
+        if (found) {
+            return i + (size_t)__builtin_ctz(found);
+        }
+    }
+    return i + scalar_find_latin1(s + i, length - i, c);
+}
+
+SSE2 static size_t sse2_find_utf16(const uint8_t* s, size_t length, uint16_t c) {
+    __m128i needle = _mm_set1_epi16((short)c);
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(s + 2 * i));
+        unsigned found = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi16(x, needle));
+        if (found) {
+            return i + (size_t)__builtin_ctz(found) / 2;
+        }
+    }
+    return i + scalar_find_utf16(s + 2 * i, length - i, c);
+}
+
+static const StringKernels sse2_kernels = {
+    "sse2",
+    sse2_mismatch,
+    sse2_find_latin1,
+    sse2_find_utf16,
+    scalar_hash_latin1,
+    scalar_hash_utf16,
+};
+
+// AVX2: 32 bytes per step
+
+AVX2 static size_t avx2_mismatch(const uint8_t* a, const uint8_t* b, size_t size) {
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+        unsigned differ = ~(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y));
+        if (differ) {
+            return i + (size_t)__builtin_ctz(differ);
+        }
+    }
+    return i + sse2_mismatch(a + i, b + i, size - i);
+}
+
+AVX2 static size_t avx2_find_latin1(const uint8_t* s, size_t length, uint8_t c) {
+    __m256i needle = _mm256_set1_epi8((char)c);
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(s + i));
+        unsigned found = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, needle));
+        if (found) {
+            return i + (size_t)__builtin_ctz(found);
+        }
+    }
+    return i + sse2_find_latin1(s + i, length - i, c);
+}
+
+AVX2 static size_t avx2_find_utf16(const uint8_t* s, size_t length, uint16_t c) {
+    __m256i needle = _mm256_set1_epi16((short)c);
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(s + 2 * i));
+        unsigned found = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi16(x, needle));
+        if (found) {
+            return i + (size_t)__builtin_ctz(found) / 2;
+        }
+    }
+    return i + sse2_find_utf16(s + 2 * i, length - i, c);
+}
+
+// Eight interleaved hash recurrences, lane j taking characters j, j + 8,
+// ..., each stepping by 31^8; weighting lane j by 31^(7 - j) at the end
+// gives the hash of all the whole blocks
+AVX2 static uint32_t avx2_hash_lanes(__m256i lanes) {
+    uint32_t lane[8];
+    _mm256_storeu_si256((__m256i*)lane, lanes);
+    uint32_t hash = 0;
+    for (int j = 0; j < 8; j++) {
+        hash = 31 * hash + lane[j];
+    }
+    return hash;
+}
+
+AVX2 static uint32_t avx2_hash_latin1(const uint8_t* s, size_t length) {
+    __m256i multiplier = _mm256_set1_epi32((int)HASH_MULTIPLIER_8);
+    __m256i lanes = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        __m256i chars = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(s + i)));
+        lanes = _mm256_add_epi32(_mm256_mullo_epi32(lanes, multiplier), chars);
+    }
+    uint32_t hash = avx2_hash_lanes(lanes);
+    for (; i < length; i++) {
+        hash = 31 * hash + s[i];
+    }
+    return hash;
+}
+
+AVX2 static uint32_t avx2_hash_utf16(const uint8_t* s, size_t length) {
+    __m256i multiplier = _mm256_set1_epi32((int)HASH_MULTIPLIER_8);
+    __m256i lanes = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        __m256i chars = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(s + 2 * i)));
+        lanes = _mm256_add_epi32(_mm256_mullo_epi32(lanes, multiplier), chars);
+    }
+    uint32_t hash = avx2_hash_lanes(lanes);
+    for (; i < length; i++) {
+        hash = 31 * hash + load_utf16(s, i);
+    }
+    return hash;
+}
+
+static const StringKernels avx2_kernels = {
+    "avx2",
+    avx2_mismatch,
+    avx2_find_latin1,
+    avx2_find_utf16,
+    avx2_hash_latin1,
+    avx2_hash_utf16,
+};
+#endif
+
+// Pick the widest kernels the CPU supports
+void string_kernels_init(void) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        string_kernels = &avx2_kernels;
+    } else if (__builtin_cpu_supports("sse2")) {
+        string_kernels = &sse2_kernels;
+    }
+#endif
+}
@@ -0,0 +1,26 @@
+// string_kernels.h - Vectorised kernels behind the String intrinsics
+#ifndef STRING_KERNELS_H
+#define STRING_KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Kernels over raw string storage. UTF-16 data is addressed as bytes since
+// string contents are not necessarily 2-byte aligned. Searches return the
+// index of the first match, or the length searched when there is none.
+typedef struct {
+    const char* name;
+    size_t (*mismatch)(const uint8_t* a, const uint8_t* b, size_t size);
+    size_t (*find_latin1)(const uint8_t* s, size_t length, uint8_t c);
+    size_t (*find_utf16)(const uint8_t* s, size_t length, uint16_t c);
+    uint32_t (*hash_latin1)(const uint8_t* s, size_t length);
+    uint32_t (*hash_utf16)(const uint8_t* s, size_t length);
+} StringKernels;
+
+// Kernels for this CPU; scalar until string_kernels_init has run
+extern const StringKernels* string_kernels;
+
+// Public API functions
+void string_kernels_init(void);
+
+#endif // STRING_KERNELS_H
@@ -0,0 +1,481 @@
+#define _DEFAULT_SOURCE
+#include "threads.h"
+#include "exceptions.h"
+#include "monitors.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+// A started Java thread: its execution context and the C stack its
+// interpreter frames run on
+typedef struct GreenThread {
+    JVM jvm;
+    JThread* thread;
+    ucontext_t context;
+    void* stack;
+    struct Worker* worker;      // Worker running the thread
+    struct GreenThread* prev;   // Neighbours in a run queue
+    struct GreenThread* next;
+    struct GreenThread* next_joiner;  // Next thread joining the same thread
+    pthread_mutex_t* park_lock; // Released by the worker once the thread parked
+    bool parked;                // Waiting rather than runnable
+    bool finished;
+} GreenThread;
+
+// Deque of runnable threads, linked through the threads: the owner takes
+// the newest from the back, thieves the oldest from the front
+typedef struct {
+    pthread_mutex_t lock;
+    GreenThread* front;
+    GreenThread* back;
+} RunQueue;
+
+typedef struct Worker {
+    pthread_t thread;
+    ucontext_t context;         // Scheduling loop, resumed when a green thread stops
+    RunQueue queue;
+    Scheduler* scheduler;
+    unsigned index;
+} Worker;
+
+struct Scheduler {
+    pthread_mutex_t lock;
+    pthread_cond_t work_available;  // Idle workers wait here
+    Worker* workers;
+    unsigned workers_count;     // 0 until the first thread starts
+    unsigned workers_started;
+    unsigned idle_workers;
+    unsigned next_worker;       // Queue of the next thread started outside a worker
+    bool stopping;
+};
+
+static void run_queue_push(RunQueue* queue, GreenThread* green, bool front) {
+    pthread_mutex_lock(&queue->lock);
+    if (front) {
+        green->prev = NULL;
+        green->next = queue->front;
+        if (queue->front) {
+            queue->front->prev = green;
+        } else {
+            queue->back = green;
+        }
+        queue->front = green;
+    } else {
+        green->next = NULL;
+        green->prev = queue->back;
+        if (queue->back) {
+            queue->back->next = green;
+        } else {
+            queue->front = green;
+        }
+        queue->back = green;
+    }
+    pthread_mutex_unlock(&queue->lock);
+}
+
+static GreenThread* run_queue_take(RunQueue* queue, bool front) {
+    pthread_mutex_lock(&queue->lock);
+    GreenThread* green = front ? queue->front : queue->back;
+    if (green && front) {
+        queue->front = green->next;
+        if (queue->front) {
+            queue->front->prev = NULL;
+        } else {
+            queue->back = NULL;
+        }
+    } else if (green) {
+        queue->back = green->prev;
+        if (queue->back) {
+            queue->back->next = NULL;
+        } else {
+            queue->front = NULL;
+        }
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return green;
+}
+
+// Make a thread runnable on a worker's queue and wake an idle worker,
+// which may steal it. Yielded threads go to the front so the others run
+// first.
+static void schedule(Scheduler* scheduler, Worker* worker, GreenThread* green, bool front) {
+    run_queue_push(&worker->queue, green, front);
+    pthread_mutex_lock(&scheduler->lock);
+    if (scheduler->idle_workers > 0) {
+        pthread_cond_signal(&scheduler->work_available);
+    }
+    pthread_mutex_unlock(&scheduler->lock);
+}
+
+// Oldest thread of the first other worker that has one, trying the
+// thief's own queue last
+static GreenThread* steal(Scheduler* scheduler, const Worker* thief) {
+    for (unsigned i = 1; i <= scheduler->workers_count; i++) {
+        Worker* victim = &scheduler->workers[(thief->index + i) % scheduler->workers_count];
+        GreenThread* green = run_queue_take(&victim->queue, true);
+        if (green) {
+            return green;
+        }
+    }
+    return NULL;
+}
+
+// Next thread for a worker to run, waiting while there is none; NULL once
+// the scheduler stops
+static GreenThread* next_thread(Worker* worker) {
+    Scheduler* scheduler = worker->scheduler;
+    for (;;) {
+        GreenThread* green = run_queue_take(&worker->queue, false);
+        if (!green) {
+            green = steal(scheduler, worker);
+        }
+        if (green) {
+            return green;
+        }
+
+        // Look again once counted as idle, so that a thread scheduled
+        // after this look signals the worker
+        pthread_mutex_lock(&scheduler->lock);
+        scheduler->idle_workers++;
+        green = steal(scheduler, worker);
+        if (!green && !scheduler->stopping) {
+            pthread_cond_wait(&scheduler->work_available, &scheduler->lock);
+        }
+        scheduler->idle_workers--;
+        bool stopping = scheduler->stopping;
+        pthread_mutex_unlock(&scheduler->lock);
+        if (green) {
+            return green;
+        }
+        if (stopping) {
+            return NULL;
+        }
+    }
+}
+
+static void free_green_thread(GreenThread* green) {
+    if (green->stack) {
+        munmap(green->stack, GREEN_STACK_SIZE);
+    }
+    free(green->jvm.stack_memory);
+    free(green->jvm.locals_memory);
+    free(green);
+}
+
+// Run green threads until the scheduler stops. A thread runs until it
+// yields, parks in join or ends, then the worker picks the next one.
+static void* worker_main(void* arg) {
+    Worker* worker = (Worker*)arg;
+    GreenThread* green;
+    while ((green = next_thread(worker)) != NULL) {
+        green->worker = worker;
+        swapcontext(&worker->context, &green->context);
+        if (green->finished) {
+            free_green_thread(green);
+        } else if (green->parked) {
+            // Released only once the thread has stopped, so the thread it
+            // waits for cannot wake it while it still runs
+            pthread_mutex_unlock(green->park_lock);
+        } else {
+            schedule(worker->scheduler, worker, green, true);
+        }
+    }
+    return NULL;
+}
+
+Scheduler* scheduler_new(void) {
+    Scheduler* scheduler = calloc(1, sizeof(Scheduler));
+    if (!scheduler) {
+        return NULL;
+    }
+    pthread_mutex_init(&scheduler->lock, NULL);
+    pthread_cond_init(&scheduler->work_available, NULL);
+    return scheduler;
+}
+
+// Start one worker per online core, on the first thread start
+static int scheduler_start(Scheduler* scheduler) {
+    pthread_mutex_lock(&scheduler->lock);
+    if (scheduler->workers_count == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        unsigned count = cores > 0 ? (unsigned)cores : 1;
+        scheduler->workers = calloc(count, sizeof(Worker));
+        if (scheduler->workers) {
+            for (unsigned i = 0; i < count; i++) {
+                pthread_mutex_init(&scheduler->workers[i].queue.lock, NULL);
+                scheduler->workers[i].scheduler = scheduler;
+                scheduler->workers[i].index = i;
+            }
+            scheduler->workers_count = count;
+            while (scheduler->workers_started < count &&
+                   pthread_create(&scheduler->workers[scheduler->workers_started].thread, NULL,
+                                  worker_main, &scheduler->workers[scheduler->workers_started]) == 0) {
+                scheduler->workers_started++;
+            }
+        }
+    }
+    int status = scheduler->workers_started > 0 ? 0 : -1;
+    pthread_mutex_unlock(&scheduler->lock);
+    return status;
+}
+
+// Stop the workers; every instance must have waited for its threads
+void scheduler_destroy(Scheduler* scheduler) {
+    if (!scheduler) {
+        return;
+    }
+    pthread_mutex_lock(&scheduler->lock);
+    scheduler->stopping = true;
+    pthread_cond_broadcast(&scheduler->work_available);
+    pthread_mutex_unlock(&scheduler->lock);
+
+    for (unsigned i = 0; i < scheduler->workers_started; i++) {
+        pthread_join(scheduler->workers[i].thread, NULL);
+    }
+    for (unsigned i = 0; i < scheduler->workers_count; i++) {
+        pthread_mutex_destroy(&scheduler->workers[i].queue.lock);
+    }
+    free(scheduler->workers);
+    pthread_cond_destroy(&scheduler->work_available);
+    pthread_mutex_destroy(&scheduler->lock);
+    free(scheduler);
+}
+
+JThread* thread_new(JVM* jvm) {
+    JThread* thread = (JThread*)jvm_alloc_object(jvm, "java/lang/Thread", sizeof(JThread));
+    if (!thread) {
+        return NULL;
+    }
+    thread->header.kind = OBJECT_THREAD;
+    pthread_mutex_lock(&jvm->main->lock);
+    thread->id = jvm->main->threads_created++;
+    pthread_mutex_unlock(&jvm->main->lock);
+    return thread;
+}
+
+// End a thread: its objects join the instance's, and its joiners become
+// runnable
+static void finish_thread(GreenThread* green) {
+    JVM* jvm = &green->jvm;
+    JVM* main = jvm->main;
+    pthread_mutex_lock(&main->lock);
+    if (jvm->objects) {
+        JObject* last = jvm->objects;
+        while (last->next) {
+            last = last->next;
+        }
+        last->next = main->objects;
+        main->objects = jvm->objects;
+        jvm->objects = NULL;
+    }
+    green->thread->state = THREAD_TERMINATED;
+    for (GreenThread* joiner = green->thread->joiners; joiner;) {
+        GreenThread* next = joiner->next_joiner;
+        thread_unpark(jvm, joiner);
+        joiner = next;
+    }
+    green->thread->joiners = NULL;
+    main->threads_running--;
+    pthread_cond_broadcast(&main->thread_ended);
+    pthread_mutex_unlock(&main->lock);
+}
+
+// Entry of a green thread's context, with its address split in two ints
+// as makecontext passes them
+static void green_thread_main(unsigned int high, unsigned int low) {
+    GreenThread* green = (GreenThread*)(uintptr_t)(((uint64_t)high << 32) | low);
+    jvm_run_thread(&green->jvm, green->thread);
+    finish_thread(green);
+    green->finished = true;
+    setcontext(&green->worker->context);
+}
+
+// Make the thread's context enter green_thread_main on its own stack
+static int init_context(GreenThread* green) {
+    ucontext_t* context = &green->context;
+    if (getcontext(context) != 0) {
+        return -1;
+    }
+    context->uc_stack.ss_sp = green->stack;
+    context->uc_stack.ss_size = GREEN_STACK_SIZE;
+    context->uc_link = NULL;
+    uint64_t address = (uintptr_t)green;
+    makecontext(context, (void (*)(void))green_thread_main, 2,
+                (unsigned int)(address >> 32), (unsigned int)address);
+    return 0;
+}
+
+// Context and stacks of a thread started by jvm's thread. The C stack has
+// a guard page at its end, so an overflow faults instead of corrupting
+// another thread.
+static GreenThread* green_thread_new(JVM* jvm, JThread* thread) {
+    GreenThread* green = calloc(1, sizeof(GreenThread));
+    if (!green) {
+        return NULL;
+    }
+    JVM* context = &green->jvm;
+    context->runtime = jvm->runtime;
+    context->main = jvm->main;
+    context->green = green;
+    context->backedge_budget = BACKEDGES_PER_YIELD;
+    context->lock_owner = lock_owner_new();
+    memcpy(context->box_caches, jvm->box_caches, sizeof(context->box_caches));
+    context->out = jvm->out;
+    context->in = jvm->in;
+    context->err = jvm->err;
+    context->stack_memory = calloc(MAX_STACK_SIZE, sizeof(jvalue));
+    context->locals_memory = calloc(MAX_LOCALS_SIZE, sizeof(jvalue));
+    green->thread = thread;
+
+    green->stack = mmap(NULL, GREEN_STACK_SIZE, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (green->stack == MAP_FAILED) {
+        green->stack = NULL;
+    }
+    if (!context->stack_memory || !context->locals_memory || !green->stack ||
+        mprotect(green->stack, (size_t)sysconf(_SC_PAGESIZE), PROT_NONE) != 0 ||
+        init_context(green) != 0) {
+        free_green_thread(green);
+        return NULL;
+    }
+    return green;
+}
+
+// Worker to queue a thread made runnable by jvm's thread on: its own
+// worker, or the workers in turn for threads outside the scheduler
+static Worker* waking_worker(JVM* jvm) {
+    if (jvm->green) {
+        return jvm->green->worker;
+    }
+    Scheduler* scheduler = jvm->runtime->scheduler;
+    pthread_mutex_lock(&scheduler->lock);
+    Worker* worker = &scheduler->workers[scheduler->next_worker++ % scheduler->workers_started];
+    pthread_mutex_unlock(&scheduler->lock);
+    return worker;
+}
+
+// Thread.start: queue the thread on the starting thread's worker
+int thread_start(JVM* jvm, Frame* frame, JThread* thread) {
+    JVM* main = jvm->main;
+    pthread_mutex_lock(&main->lock);
+    bool started = thread->state != THREAD_NEW;
+    if (!started) {
+        thread->state = THREAD_RUNNABLE;
+        main->threads_running++;
+    }
+    pthread_mutex_unlock(&main->lock);
+    if (started) {
+        return jvm_throw_new(jvm, frame, "java/lang/IllegalThreadStateException", NULL);
+    }
+
+    Scheduler* scheduler = jvm->runtime->scheduler;
+    GreenThread* green = scheduler_start(scheduler) == 0 ? green_thread_new(jvm, thread) : NULL;
+    if (!green) {
+        pthread_mutex_lock(&main->lock);
+        thread->state = THREAD_TERMINATED;
+        main->threads_running--;
+        pthread_cond_broadcast(&main->thread_ended);
+        pthread_mutex_unlock(&main->lock);
+        return jvm_throw_new(jvm, frame, "java/lang/OutOfMemoryError", "unable to create new native thread");
+    }
+
+    schedule(scheduler, waking_worker(jvm), green, false);
+    return 0;
+}
+
+// Stop the green thread running jvm until another thread unparks it.
+// The caller holds lock, which guards the condition it waits for; the
+// worker releases it once the thread stopped, and the thread resumes
+// without it.
+void thread_park(JVM* jvm, pthread_mutex_t* lock) {
+    GreenThread* green = jvm->green;
+    green->park_lock = lock;
+    green->parked = true;
+    swapcontext(&green->context, &green->worker->context);
+}
+
+// Make a parked thread runnable again
+void thread_unpark(JVM* jvm, GreenThread* green) {
+    green->parked = false;
+    schedule(jvm->runtime->scheduler, waking_worker(jvm), green, false);
+}
+
+// Thread.join: a green thread parks and gives up its worker until the
+// thread ends; other threads block
+void thread_join(JVM* jvm, JThread* thread) {
+    JVM* main = jvm->main;
+    pthread_mutex_lock(&main->lock);
+    GreenThread* green = jvm->green;
+    if (green && thread->state == THREAD_RUNNABLE) {
+        green->next_joiner = thread->joiners;
+        thread->joiners = green;
+        thread_park(jvm, &main->lock);
+        return;
+    }
+    while (thread->state == THREAD_RUNNABLE) {
+        pthread_cond_wait(&main->thread_ended, &main->lock);
+    }
+    pthread_mutex_unlock(&main->lock);
+}
+
+// Give up the worker to the other runnable threads, and start a new time
+// slice
+void thread_yield(JVM* jvm) {
+    jvm->backedge_budget = BACKEDGES_PER_YIELD;
+    GreenThread* green = jvm->green;
+    if (green) {
+        swapcontext(&green->context, &green->worker->context);
+    }
+}
+
+// Wait until every thread the instance started has ended
+void jvm_wait_for_threads(JVM* jvm) {
+    JVM* main = jvm->main;
+    pthread_mutex_lock(&main->lock);
+    while (main->threads_running > 0) {
+        pthread_cond_wait(&main->thread_ended, &main->lock);
+    }
+    pthread_mutex_unlock(&main->lock);
+}
+
+// Thread(Runnable)
+static int native_thread_init(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)jvm;
+    (void)frame;
+    (void)result;
+    ((JThread*)args[0].ref)->target = (JObject*)args[1].ref;
+    return 0;
+}
+
+// Thread.start()
+static int native_thread_start(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)result;
+    return thread_start(jvm, frame, (JThread*)args[0].ref);
+}
+
+// Thread.join()
+static int native_thread_join(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)frame;
+    (void)result;
+    thread_join(jvm, (JThread*)args[0].ref);
+    return 0;
+}
+
+// Thread.yield()
+static int native_thread_yield(JVM* jvm, Frame* frame, jvalue* args, jvalue* result) {
+    (void)frame;
+    (void)args;
+    (void)result;
+    thread_yield(jvm);
+    return 0;
+}
+
+void register_thread_native_methods(Runtime* runtime) {
+    runtime_register_native_method(runtime, "java/lang/Thread", "<init>", "(Ljava/lang/Runnable;)V",
+                                   native_thread_init);
+    runtime_register_native_method(runtime, "java/lang/Thread", "start", "()V", native_thread_start);
+    runtime_register_blocking_native_method(runtime, "java/lang/Thread", "join", "()V", native_thread_join);
+    runtime_register_blocking_native_method(runtime, "java/lang/Thread", "yield", "()V", native_thread_yield);
+}
@@ -0,0 +1,32 @@
+// threads.h - java.lang.Thread as green threads on a work-stealing scheduler
+#ifndef THREADS_H
+#define THREADS_H
+
+#include "jvm.h"
+
+// Backward branches a green thread takes before yielding its worker
+#define BACKEDGES_PER_YIELD 10000
+
+// C stack of a green thread, reserved but only committed as it is used
+#define GREEN_STACK_SIZE (1024 * 1024)
+
+// Scheduler of the green threads: one OS worker per core, each with a
+// deque of runnable threads that idle workers steal from
+typedef struct Scheduler Scheduler;
+
+// Java thread started on the scheduler
+typedef struct GreenThread GreenThread;
+
+// Public API functions
+Scheduler* scheduler_new(void);
+void scheduler_destroy(Scheduler* scheduler);
+JThread* thread_new(JVM* jvm);
+int thread_start(JVM* jvm, Frame* frame, JThread* thread);
+void thread_join(JVM* jvm, JThread* thread);
+void thread_yield(JVM* jvm);
+void thread_park(JVM* jvm, pthread_mutex_t* lock);
+void thread_unpark(JVM* jvm, GreenThread* green);
+void jvm_wait_for_threads(JVM* jvm);
+void register_thread_native_methods(Runtime* runtime);
+
+#endif // THREADS_H
@@ -0,0 +1,950 @@
+#include "verifier.h"
+#include "class_loader.h"
+#include "bytecode.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Maximum number of arguments in a method descriptor
+#define VERIFY_MAX_ARGS 255
+
+// Verification types of locals and operand stack slots
+enum VerificationType {
+    TYPE_TOP = 0,       // Unusable, or the second slot of a long or double
+    TYPE_INT,
+    TYPE_FLOAT,
+    TYPE_LONG,
+    TYPE_DOUBLE,
+    TYPE_REF
+};
+
+// Types of locals and operand stack before an instruction
+typedef struct {
+    uint8_t* locals;
+    uint8_t* stack;
+    uint16_t stack_size;
+    bool present;       // Inference: state reached; type checking: stack map frame
+} TypeState;
+
+// Verification context for a method
+typedef struct {
+    const ClassInfo* class_info;
+    const MethodInfo* method;
+    uint16_t max_locals;
+    uint16_t max_stack;
+    int32_t* index_of;          // Bytecode offset -> instruction index
+    uint32_t* successors;
+    uint32_t successors_capacity;
+    uint32_t successors_count;
+    uint32_t error_offset;
+    const char* error;
+} Verifier;
+
+static bool fail(Verifier* v, const char* message) {
+    if (!v->error) {
+        v->error = message;
+    }
+    return false;
+}
+
+static bool is_wide_type(uint8_t type) {
+    return type == TYPE_LONG || type == TYPE_DOUBLE;
+}
+
+// Verification type of a field or argument descriptor character
+static uint8_t descriptor_type(char c) {
+    switch (c) {
+        case 'B': case 'C': case 'I': case 'S': case 'Z':
+            return TYPE_INT;
+        case 'F':
+            return TYPE_FLOAT;
+        case 'J':
+            return TYPE_LONG;
+        case 'D':
+            return TYPE_DOUBLE;
+        case 'L': case '[':
+            return TYPE_REF;
+        default:
+            return TYPE_TOP;
+    }
+}
+
+static void copy_state(const Verifier* v, TypeState* dst, const TypeState* src) {
+    memcpy(dst->locals, src->locals, v->max_locals);
+    memcpy(dst->stack, src->stack, v->max_stack);
+    dst->stack_size = src->stack_size;
+}
+
+// Operand stack operations
+static bool push(Verifier* v, TypeState* s, uint8_t type) {
+    int size = is_wide_type(type) ? 2 : 1;
+    if (s->stack_size + size > v->max_stack) {
+        return fail(v, "operand stack overflow");
+    }
+    s->stack[s->stack_size++] = type;
+    if (size == 2) {
+        s->stack[s->stack_size++] = TYPE_TOP;
+    }
+    return true;
+}
+
+static bool pop(Verifier* v, TypeState* s, uint8_t type) {
+    if (is_wide_type(type)) {
+        if (s->stack_size < 2 || s->stack[s->stack_size - 1] != TYPE_TOP ||
+            s->stack[s->stack_size - 2] != type) {
+            return fail(v, "bad type on operand stack");
+        }
+        s->stack_size -= 2;
+        return true;
+    }
+    if (s->stack_size < 1) {
+        return fail(v, "operand stack underflow");
+    }
+    if (s->stack[s->stack_size - 1] != type) {
+        return fail(v, "bad type on operand stack");
+    }
+    s->stack_size--;
+    return true;
+}
+
+// Slot-level stack operations must not split a long or double
+static bool is_value_boundary(const TypeState* s, int depth) {
+    return s->stack[s->stack_size - depth] != TYPE_TOP;
+}
+
+static bool pop_slots(Verifier* v, TypeState* s, int count) {
+    if (s->stack_size < count) {
+        return fail(v, "operand stack underflow");
+    }
+    if (!is_value_boundary(s, count)) {
+        return fail(v, "splitting a long or double");
+    }
+    s->stack_size -= count;
+    return true;
+}
+
+// Duplicate the top count slots and insert them below the next depth slots
+static bool dup_slots(Verifier* v, TypeState* s, int count, int depth) {
+    if (s->stack_size < count + depth) {
+        return fail(v, "operand stack underflow");
+    }
+    if (!is_value_boundary(s, count) || (depth > 0 && !is_value_boundary(s, count + depth))) {
+        return fail(v, "splitting a long or double");
+    }
+    if (s->stack_size + count > v->max_stack) {
+        return fail(v, "operand stack overflow");
+    }
+
+    uint8_t top[2];
+    memcpy(top, &s->stack[s->stack_size - count], count);
+    uint8_t* insert = &s->stack[s->stack_size - count - depth];
+    memmove(insert + count, insert, count + depth);
+    memcpy(insert, top, count);
+    s->stack_size += count;
+    return true;
+}
+
+// Local variable operations
+static bool load(Verifier* v, TypeState* s, uint8_t type, int32_t index) {
+    int size = is_wide_type(type) ? 2 : 1;
+    if (index < 0 || index + size > v->max_locals) {
+        return fail(v, "local variable index out of range");
+    }
+    if (s->locals[index] != type) {
+        return fail(v, "bad type in local variable");
+    }
+    return push(v, s, type);
+}
+
+static bool store(Verifier* v, TypeState* s, uint8_t type, int32_t index) {
+    int size = is_wide_type(type) ? 2 : 1;
+    if (index < 0 || index + size > v->max_locals) {
+        return fail(v, "local variable index out of range");
+    }
+    if (!pop(v, s, type)) {
+        return false;
+    }
+    // Overwriting the second slot of a long or double invalidates it
+    if (index > 0 && is_wide_type(s->locals[index - 1])) {
+        s->locals[index - 1] = TYPE_TOP;
+    }
+    s->locals[index] = type;
+    if (size == 2) {
+        s->locals[index + 1] = TYPE_TOP;
+    }
+    return true;
+}
+
+// Pop the arguments of a method descriptor, last argument first
+static bool pop_arguments(Verifier* v, TypeState* s, const char* descriptor) {
+    char types[VERIFY_MAX_ARGS];
+    int count = parse_method_descriptor(descriptor, types, VERIFY_MAX_ARGS);
+    if (count < 0) {
+        return fail(v, "malformed method descriptor");
+    }
+    for (int i = count - 1; i >= 0; i--) {
+        if (!pop(v, s, descriptor_type(types[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool push_return_value(Verifier* v, TypeState* s, const char* descriptor) {
+    char type = descriptor_return_type(descriptor);
+    if (type == 'V') {
+        return true;
+    }
+    uint8_t vtype = descriptor_type(type);
+    if (vtype == TYPE_TOP) {
+        return fail(v, "malformed method descriptor");
+    }
+    return push(v, s, vtype);
+}
+
+static bool verify_return(Verifier* v, TypeState* s, char expected) {
+    char type = descriptor_return_type(v->method->descriptor);
+    if (expected == 'V') {
+        return type == 'V' ? true : fail(v, "return type mismatch");
+    }
+    if (descriptor_type(type) != descriptor_type(expected)) {
+        return fail(v, "return type mismatch");
+    }
+    return pop(v, s, descriptor_type(expected));
+}
+
+// Type of a loadable constant pool entry
+static bool verify_ldc(Verifier* v, TypeState* s, uint16_t index, bool wide) {
+    if (index == 0 || index >= v->class_info->constant_pool_count) {
+        return fail(v, "constant pool index out of range");
+    }
+    uint8_t tag = v->class_info->constant_pool[index].tag;
+    if (wide) {
+        if (tag == CONST_LONG) {
+            return push(v, s, TYPE_LONG);
+        }
+        if (tag == CONST_DOUBLE) {
+            return push(v, s, TYPE_DOUBLE);
+        }
+        return fail(v, "ldc2_w of a category 1 constant");
+    }
+    switch (tag) {
+        case CONST_INTEGER:
+            return push(v, s, TYPE_INT);
+        case CONST_FLOAT:
+            return push(v, s, TYPE_FLOAT);
+        case CONST_STRING:
+        case CONST_CLASS:
+            return push(v, s, TYPE_REF);
+        default:
+            return fail(v, "ldc of an unloadable constant");
+    }
+}
+
+static bool verify_field(Verifier* v, TypeState* s, const Instruction* insn) {
+    const char* class_name;
+    const char* name;
+    const char* descriptor;
+    if (constant_pool_member_ref(v->class_info, (uint16_t)insn->a,
+                                 &class_name, &name, &descriptor) != 0 ||
+        v->class_info->constant_pool[insn->a].tag != CONST_FIELDREF) {
+        return fail(v, "bad field reference");
+    }
+    uint8_t type = descriptor_type(descriptor[0]);
+    if (type == TYPE_TOP) {
+        return fail(v, "malformed field descriptor");
+    }
+
+    switch (insn->opcode) {
+        case GETSTATIC:
+            return push(v, s, type);
+        case PUTSTATIC:
+            return pop(v, s, type);
+        case GETFIELD:
+            return pop(v, s, TYPE_REF) && push(v, s, type);
+        default:
+            return pop(v, s, type) && pop(v, s, TYPE_REF);
+    }
+}
+
+static bool verify_invoke(Verifier* v, TypeState* s, const Instruction* insn) {
+    const char* class_name;
+    const char* name;
+    const char* descriptor;
+    if (constant_pool_member_ref(v->class_info, (uint16_t)insn->a,
+                                 &class_name, &name, &descriptor) != 0 ||
+        v->class_info->constant_pool[insn->a].tag == CONST_FIELDREF) {
+        return fail(v, "bad method reference");
+    }
+    if (!pop_arguments(v, s, descriptor)) {
+        return false;
+    }
+    if (insn->opcode != INVOKESTATIC && !pop(v, s, TYPE_REF)) {
+        return false;
+    }
+    return push_return_value(v, s, descriptor);
+}
+
+// invokedynamic pops the arguments of its call site descriptor and pushes
+// the result; the bootstrap method is resolved when the class is linked
+static bool verify_invokedynamic(Verifier* v, TypeState* s, const Instruction* insn) {
+    const ConstantPoolEntry* pool = v->class_info->constant_pool;
+    const char* name;
+    const char* descriptor;
+    if (insn->a == 0 || insn->a >= v->class_info->constant_pool_count ||
+        pool[insn->a].tag != CONST_INVOKE_DYNAMIC ||
+        constant_pool_name_and_type(v->class_info, pool[insn->a].dynamic_info.name_and_type_index,
+                                    &name, &descriptor) != 0 ||
+        descriptor[0] != '(') {
+        return fail(v, "bad invokedynamic constant");
+    }
+    if (!pop_arguments(v, s, descriptor)) {
+        return false;
+    }
+    return push_return_value(v, s, descriptor);
+}
+
+// Verification type of a stack signature character of the opcode table
+static uint8_t signature_type(char c) {
+    return c == 'A' ? TYPE_REF : descriptor_type(c);
+}
+
+// Apply the operand stack signature of an opcode from the opcode table
+static bool verify_signature(Verifier* v, TypeState* s, const OpcodeInfo* info) {
+    if (strchr(info->pops, '?') || strchr(info->pushes, '?')) {
+        return fail(v, "unsupported opcode");
+    }
+    for (size_t i = strlen(info->pops); i > 0; i--) {
+        if (!pop(v, s, signature_type(info->pops[i - 1]))) {
+            return false;
+        }
+    }
+    for (const char* p = info->pushes; *p; p++) {
+        if (!push(v, s, signature_type(*p))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Apply the effect of one instruction to the type state. Instructions whose
+// effect depends on their operands are handled here, the rest through the
+// stack signature in the opcode table
+static bool verify_instruction(Verifier* v, const Instruction* insn, TypeState* s) {
+    uint16_t op = insn->opcode;
+
+    switch (op) {
+        case ICONST:
+            return push(v, s, TYPE_INT);
+        case LDC:
+        case LDC_W:
+            return verify_ldc(v, s, (uint16_t)insn->a, false);
+        case LDC2_W:
+            return verify_ldc(v, s, (uint16_t)insn->a, true);
+
+        // Locals
+        case ILOAD: return load(v, s, TYPE_INT, insn->a);
+        case LLOAD: return load(v, s, TYPE_LONG, insn->a);
+        case FLOAD: return load(v, s, TYPE_FLOAT, insn->a);
+        case DLOAD: return load(v, s, TYPE_DOUBLE, insn->a);
+        case ALOAD: return load(v, s, TYPE_REF, insn->a);
+        case ISTORE: return store(v, s, TYPE_INT, insn->a);
+        case LSTORE: return store(v, s, TYPE_LONG, insn->a);
+        case FSTORE: return store(v, s, TYPE_FLOAT, insn->a);
+        case DSTORE: return store(v, s, TYPE_DOUBLE, insn->a);
+        case ASTORE: return store(v, s, TYPE_REF, insn->a);
+        case IINC:
+            if (insn->a < 0 || insn->a >= v->max_locals) {
+                return fail(v, "local variable index out of range");
+            }
+            return s->locals[insn->a] == TYPE_INT ? true : fail(v, "bad type in local variable");
+
+        case MULTIANEWARRAY:
+            if (insn->b == 0) {
+                return fail(v, "multianewarray with no dimensions");
+            }
+            for (int32_t i = 0; i < insn->b; i++) {
+                if (!pop(v, s, TYPE_INT)) {
+                    return false;
+                }
+            }
+            return push(v, s, TYPE_REF);
+
+        // Stack management works on slots of any type
+        case POP: return pop_slots(v, s, 1);
+        case POP2: return pop_slots(v, s, 2);
+        case DUP: return dup_slots(v, s, 1, 0);
+        case DUP_X1: return dup_slots(v, s, 1, 1);
+        case DUP_X2: return dup_slots(v, s, 1, 2);
+        case DUP2: return dup_slots(v, s, 2, 0);
+        case DUP2_X1: return dup_slots(v, s, 2, 1);
+        case DUP2_X2: return dup_slots(v, s, 2, 2);
+        case SWAP: {
+            if (s->stack_size < 2) {
+                return fail(v, "operand stack underflow");
+            }
+            if (!is_value_boundary(s, 1) || !is_value_boundary(s, 2)) {
+                return fail(v, "splitting a long or double");
+            }
+            uint8_t top = s->stack[s->stack_size - 1];
+            s->stack[s->stack_size - 1] = s->stack[s->stack_size - 2];
+            s->stack[s->stack_size - 2] = top;
+            return true;
+        }
+
+        case JSR: case RET:
+            return fail(v, "jsr/ret subroutines are not supported");
+
+        // Returns
+        case IRETURN: return verify_return(v, s, 'I');
+        case LRETURN: return verify_return(v, s, 'J');
+        case FRETURN: return verify_return(v, s, 'F');
+        case DRETURN: return verify_return(v, s, 'D');
+        case ARETURN: return verify_return(v, s, 'L');
+        case RETURN: return verify_return(v, s, 'V');
+
+        // Fields and methods
+        case GETSTATIC: case PUTSTATIC: case GETFIELD: case PUTFIELD:
+            return verify_field(v, s, insn);
+        case INVOKEVIRTUAL: case INVOKESPECIAL: case INVOKESTATIC: case INVOKEINTERFACE:
+            return verify_invoke(v, s, insn);
+        case INVOKEDYNAMIC:
+            return verify_invokedynamic(v, s, insn);
+
+        default:
+            break;
+    }
+
+    if (op > 0xff || !opcode_info[op].name) {
+        return fail(v, "unknown opcode");
+    }
+    return verify_signature(v, s, &opcode_info[op]);
+}
+
+// Record a successor instruction index
+static bool add_successor(Verifier* v, uint32_t index) {
+    if (v->successors_count == v->successors_capacity) {
+        uint32_t capacity = v->successors_capacity ? v->successors_capacity * 2 : 16;
+        uint32_t* successors = realloc(v->successors, capacity * sizeof(uint32_t));
+        if (!successors) {
+            return fail(v, "out of memory");
+        }
+        v->successors = successors;
+        v->successors_capacity = capacity;
+    }
+    v->successors[v->successors_count++] = index;
+    return true;
+}
+
+// Collect the jump targets of an instruction; sets falls_through when
+// execution can continue with the next instruction
+static bool collect_successors(Verifier* v, uint32_t index, bool* falls_through) {
+    Instruction insn = v->method->instructions[index];
+    v->successors_count = 0;
+    *falls_through = true;
+
+    switch (insn.opcode) {
+        case GOTO:
+        case IRETURN: case LRETURN: case FRETURN: case DRETURN: case ARETURN: case RETURN:
+        case ATHROW:
+            *falls_through = false;
+            break;
+        case TABLESWITCH:
+        case LOOKUPSWITCH: {
+            const SwitchTable* table = &v->method->switch_tables[insn.a];
+            *falls_through = false;
+            if (!add_successor(v, (uint32_t)table->default_target)) {
+                return false;
+            }
+            for (uint32_t i = 0; i < table->count; i++) {
+                if (!add_successor(v, (uint32_t)table->targets[i])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        default:
+            break;
+    }
+
+    int32_t* target = instruction_branch_target(&insn);
+    if (target && !add_successor(v, (uint32_t)*target)) {
+        return false;
+    }
+    return true;
+}
+
+// Locals on method entry: the receiver followed by the arguments
+static bool initial_locals(Verifier* v, uint8_t* declared, int* declared_count) {
+    char types[VERIFY_MAX_ARGS];
+    int count = parse_method_descriptor(v->method->descriptor, types, VERIFY_MAX_ARGS);
+    if (count < 0) {
+        return fail(v, "malformed method descriptor");
+    }
+
+    int n = 0;
+    if (!(v->method->access_flags & ACC_STATIC)) {
+        declared[n++] = TYPE_REF;
+    }
+    for (int i = 0; i < count; i++) {
+        declared[n++] = descriptor_type(types[i]);
+    }
+    *declared_count = n;
+    return true;
+}
+
+// Expand declared types, where a long or double is one entry, into slots
+static bool expand_types(Verifier* v, const uint8_t* declared, int count,
+                         uint8_t* slots, uint16_t max_slots, uint16_t* used) {
+    uint16_t n = 0;
+    for (int i = 0; i < count; i++) {
+        int size = is_wide_type(declared[i]) ? 2 : 1;
+        if (n + size > max_slots) {
+            return fail(v, "frame exceeds max_locals or max_stack");
+        }
+        slots[n++] = declared[i];
+        if (size == 2) {
+            slots[n++] = TYPE_TOP;
+        }
+    }
+    *used = n;
+    return true;
+}
+
+static bool is_assignable(const Verifier* v, const TypeState* from, const TypeState* to) {
+    if (from->stack_size != to->stack_size) {
+        return false;
+    }
+    for (uint16_t i = 0; i < from->stack_size; i++) {
+        if (from->stack[i] != to->stack[i]) {
+            return false;
+        }
+    }
+    for (uint16_t i = 0; i < v->max_locals; i++) {
+        if (to->locals[i] != TYPE_TOP && from->locals[i] != to->locals[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Merge an incoming state into a successor's state; returns true if it changed
+static bool merge_state(Verifier* v, TypeState* into, const TypeState* from, bool* changed) {
+    *changed = false;
+    if (!into->present) {
+        copy_state(v, into, from);
+        into->present = true;
+        *changed = true;
+        return true;
+    }
+    if (into->stack_size != from->stack_size) {
+        return fail(v, "inconsistent stack height");
+    }
+    for (uint16_t i = 0; i < from->stack_size; i++) {
+        if (into->stack[i] != from->stack[i]) {
+            return fail(v, "inconsistent stack types");
+        }
+    }
+    for (uint16_t i = 0; i < v->max_locals; i++) {
+        if (into->locals[i] != TYPE_TOP && into->locals[i] != from->locals[i]) {
+            into->locals[i] = TYPE_TOP;
+            *changed = true;
+        }
+    }
+    return true;
+}
+
+// State on entry to an exception handler: the locals before the throwing
+// instruction and the exception alone on the operand stack
+static bool handler_state(Verifier* v, TypeState* dst, const TypeState* before) {
+    if (v->max_stack < 1) {
+        return fail(v, "operand stack overflow");
+    }
+    memcpy(dst->locals, before->locals, v->max_locals);
+    dst->stack[0] = TYPE_REF;
+    dst->stack_size = 1;
+    return true;
+}
+
+// Verification by type inference (class files before version 50)
+static bool verify_by_inference(Verifier* v, TypeState* states, TypeState* current) {
+    uint32_t count = v->method->instructions_count;
+    uint32_t* worklist = malloc(count * sizeof(uint32_t));
+    bool* queued = calloc(count, sizeof(bool));
+    if (!worklist || !queued) {
+        free(worklist);
+        free(queued);
+        return fail(v, "out of memory");
+    }
+
+    uint32_t pending = 0;
+    worklist[pending++] = 0;
+    queued[0] = true;
+
+    bool ok = true;
+    while (ok && pending > 0) {
+        uint32_t i = worklist[--pending];
+        queued[i] = false;
+        v->error_offset = v->method->instructions[i].offset;
+
+        // Handlers covering the instruction see the state before it
+        for (uint16_t h = 0; ok && h < v->method->exception_handlers_count; h++) {
+            const ExceptionHandler* handler = &v->method->exception_handlers[h];
+            if ((int32_t)i < handler->start || (int32_t)i >= handler->end) {
+                continue;
+            }
+            bool changed;
+            ok = handler_state(v, current, &states[i]) &&
+                 merge_state(v, &states[handler->handler], current, &changed);
+            if (ok && changed && !queued[handler->handler]) {
+                queued[handler->handler] = true;
+                worklist[pending++] = (uint32_t)handler->handler;
+            }
+        }
+        if (!ok) {
+            break;
+        }
+
+        copy_state(v, current, &states[i]);
+        bool falls_through;
+        if (!verify_instruction(v, &v->method->instructions[i], current) ||
+            !collect_successors(v, i, &falls_through)) {
+            ok = false;
+            break;
+        }
+        if (falls_through) {
+            if (i + 1 >= count) {
+                ok = fail(v, "falling off the end of the code");
+                break;
+            }
+            if (!add_successor(v, i + 1)) {
+                ok = false;
+                break;
+            }
+        }
+
+        for (uint32_t s = 0; s < v->successors_count; s++) {
+            uint32_t next = v->successors[s];
+            bool changed;
+            if (!merge_state(v, &states[next], current, &changed)) {
+                ok = false;
+                break;
+            }
+            if (changed && !queued[next]) {
+                queued[next] = true;
+                worklist[pending++] = next;
+            }
+        }
+    }
+
+    free(worklist);
+    free(queued);
+    return ok;
+}
+
+// Read a verification_type_info entry of the StackMapTable
+static bool read_frame_type(Verifier* v, const uint8_t* data, uint32_t length,
+                            uint32_t* pos, uint8_t* type) {
+    if (*pos >= length) {
+        return fail(v, "truncated StackMapTable");
+    }
+    uint8_t tag = data[(*pos)++];
+    switch (tag) {
+        case 0: *type = TYPE_TOP; break;
+        case 1: *type = TYPE_INT; break;
+        case 2: *type = TYPE_FLOAT; break;
+        case 3: *type = TYPE_DOUBLE; break;
+        case 4: *type = TYPE_LONG; break;
+        case 5: // null
+        case 6: // uninitializedThis
+            *type = TYPE_REF;
+            break;
+        case 7: // object
+        case 8: // uninitialized
+            if (*pos + 2 > length) {
+                return fail(v, "truncated StackMapTable");
+            }
+            *pos += 2;
+            *type = TYPE_REF;
+            break;
+        default:
+            return fail(v, "bad StackMapTable type");
+    }
+    return true;
+}
+
+static uint16_t read_frame_u2(const uint8_t* data, uint32_t pos) {
+    return (uint16_t)((data[pos] << 8) | data[pos + 1]);
+}
+
+// Decode the StackMapTable into frames attached to instructions
+static bool load_stack_map(Verifier* v, TypeState* states, uint8_t* declared, int declared_count) {
+    const uint8_t* data = v->method->stack_map_table;
+    uint32_t length = v->method->stack_map_table_length;
+    if (!data || length < 2) {
+        return true;
+    }
+
+    uint8_t* stack = malloc(v->max_stack + 1);
+    if (!stack) {
+        return fail(v, "out of memory");
+    }
+
+    uint16_t entries = read_frame_u2(data, 0);
+    uint32_t pos = 2;
+    int64_t offset = -1;
+    bool ok = true;
+
+    for (uint16_t e = 0; ok && e < entries; e++) {
+        if (pos >= length) {
+            ok = fail(v, "truncated StackMapTable");
+            break;
+        }
+        uint8_t frame_type = data[pos++];
+        uint32_t delta;
+        int stack_count = 0;
+
+        if (frame_type <= 63) {
+            delta = frame_type;
+        } else if (frame_type <= 127) {
+            delta = frame_type - 64;
+            ok = read_frame_type(v, data, length, &pos, &stack[0]);
+            stack_count = 1;
+        } else if (frame_type < 247) {
+            ok = fail(v, "reserved StackMapTable frame type");
+            break;
+        } else {
+            if (pos + 2 > length) {
+                ok = fail(v, "truncated StackMapTable");
+                break;
+            }
+            delta = read_frame_u2(data, pos);
+            pos += 2;
+            if (frame_type == 247) {
+                ok = read_frame_type(v, data, length, &pos, &stack[0]);
+                stack_count = 1;
+            } else if (frame_type <= 250) {
+                int chop = 251 - frame_type;
+                if (chop > declared_count) {
+                    ok = fail(v, "StackMapTable chops too many locals");
+                    break;
+                }
+                declared_count -= chop;
+            } else if (frame_type >= 252 && frame_type <= 254) {
+                for (int k = 0; ok && k < frame_type - 251; k++) {
+                    if (declared_count >= v->max_locals) {
+                        ok = fail(v, "frame exceeds max_locals or max_stack");
+                        break;
+                    }
+                    ok = read_frame_type(v, data, length, &pos, &declared[declared_count++]);
+                }
+            } else if (frame_type == 255) {
+                if (pos + 2 > length) {
+                    ok = fail(v, "truncated StackMapTable");
+                    break;
+                }
+                uint16_t locals_count = read_frame_u2(data, pos);
+                pos += 2;
+                if (locals_count > v->max_locals) {
+                    ok = fail(v, "frame exceeds max_locals or max_stack");
+                    break;
+                }
+                declared_count = 0;
+                for (uint16_t k = 0; ok && k < locals_count; k++) {
+                    ok = read_frame_type(v, data, length, &pos, &declared[declared_count++]);
+                }
+                if (!ok || pos + 2 > length) {
+                    ok = ok ? fail(v, "truncated StackMapTable") : false;
+                    break;
+                }
+                stack_count = read_frame_u2(data, pos);
+                pos += 2;
+                if (stack_count > v->max_stack) {
+                    ok = fail(v, "frame exceeds max_locals or max_stack");
+                    break;
+                }
+                for (int k = 0; ok && k < stack_count; k++) {
+                    ok = read_frame_type(v, data, length, &pos, &stack[k]);
+                }
+            }
+        }
+        if (!ok) {
+            break;
+        }
+
+        offset += (int64_t)delta + 1;
+        if (offset >= v->method->code_length || v->index_of[offset] < 0) {
+            ok = fail(v, "StackMapTable frame is not at an instruction");
+            break;
+        }
+
+        TypeState* frame = &states[v->index_of[offset]];
+        uint16_t used;
+        memset(frame->locals, TYPE_TOP, v->max_locals);
+        ok = expand_types(v, declared, declared_count, frame->locals, v->max_locals, &used) &&
+             expand_types(v, stack, stack_count, frame->stack, v->max_stack, &frame->stack_size);
+        frame->present = true;
+    }
+
+    free(stack);
+    return ok;
+}
+
+// Verification by type checking against the StackMapTable (version 50+)
+static bool verify_by_type_checking(Verifier* v, TypeState* states, TypeState* current,
+                                    TypeState* scratch, uint8_t* declared, int declared_count) {
+    // A frame at offset 0 replaces the entry state from the descriptor, so
+    // it must be assignable from it; on failure the entry state is restored
+    // for inference
+    TypeState* entry = scratch;
+    copy_state(v, entry, &states[0]);
+    if (!load_stack_map(v, states, declared, declared_count)) {
+        copy_state(v, &states[0], entry);
+        return false;
+    }
+    if (!is_assignable(v, entry, &states[0])) {
+        copy_state(v, &states[0], entry);
+        return fail(v, "bad initial frame");
+    }
+
+    uint32_t count = v->method->instructions_count;
+    bool reachable = true;
+    copy_state(v, current, &states[0]);
+
+    for (uint32_t i = 0; i < count; i++) {
+        v->error_offset = v->method->instructions[i].offset;
+        if (i > 0 && states[i].present) {
+            if (reachable && !is_assignable(v, current, &states[i])) {
+                return fail(v, "state does not match stack map frame");
+            }
+            copy_state(v, current, &states[i]);
+        } else if (!reachable) {
+            return fail(v, "missing stack map frame after unconditional branch");
+        }
+
+        for (uint16_t h = 0; h < v->method->exception_handlers_count; h++) {
+            const ExceptionHandler* handler = &v->method->exception_handlers[h];
+            if ((int32_t)i < handler->start || (int32_t)i >= handler->end) {
+                continue;
+            }
+            if (!states[handler->handler].present) {
+                return fail(v, "exception handler has no stack map frame");
+            }
+            if (!handler_state(v, scratch, current) ||
+                !is_assignable(v, scratch, &states[handler->handler])) {
+                return fail(v, "state does not match exception handler frame");
+            }
+        }
+
+        bool falls_through;
+        if (!verify_instruction(v, &v->method->instructions[i], current) ||
+            !collect_successors(v, i, &falls_through)) {
+            return false;
+        }
+        for (uint32_t s = 0; s < v->successors_count; s++) {
+            TypeState* target = &states[v->successors[s]];
+            if (!target->present) {
+                return fail(v, "branch target has no stack map frame");
+            }
+            if (!is_assignable(v, current, target)) {
+                return fail(v, "state does not match stack map frame");
+            }
+        }
+        reachable = falls_through;
+    }
+
+    if (reachable) {
+        return fail(v, "falling off the end of the code");
+    }
+    return true;
+}
+
+// Verify a pre-decoded method: operand stack depth stays within
+// [0, max_stack], locals are within max_locals, and every instruction sees
+// operands of the right type. Run before the optimizer rewrites the code.
+int verify_method(const ClassInfo* class_info, const MethodInfo* method) {
+    if (!class_info || !method || !method->instructions) {
+        return 0;
+    }
+
+    Verifier v;
+    memset(&v, 0, sizeof(Verifier));
+    v.class_info = class_info;
+    v.method = method;
+    v.max_locals = method->max_locals;
+    v.max_stack = method->max_stack;
+
+    uint32_t count = method->instructions_count;
+    size_t state_size = (size_t)v.max_locals + v.max_stack;
+    TypeState* states = calloc(count + 2, sizeof(TypeState));
+    uint8_t* memory = calloc(count + 2, state_size + 1);
+    uint8_t* declared = malloc((size_t)v.max_locals + VERIFY_MAX_ARGS + 1);
+    v.index_of = malloc(method->code_length * sizeof(int32_t));
+    if (!states || !memory || !declared || !v.index_of) {
+        free(states);
+        free(memory);
+        free(declared);
+        free(v.index_of);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i <= count + 1; i++) {
+        states[i].locals = memory + i * (state_size + 1);
+        states[i].stack = states[i].locals + v.max_locals;
+    }
+    for (uint32_t i = 0; i < method->code_length; i++) {
+        v.index_of[i] = -1;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        v.index_of[method->instructions[i].offset] = (int32_t)i;
+    }
+
+    // Entry state from the method descriptor; the last two states are
+    // scratch space
+    TypeState* current = &states[count];
+    TypeState* scratch = &states[count + 1];
+    int declared_count = 0;
+    bool ok = initial_locals(&v, declared, &declared_count);
+    for (uint16_t h = 0; ok && h < method->exception_handlers_count; h++) {
+        uint16_t catch_type = method->exception_handlers[h].catch_type;
+        if (catch_type && !constant_pool_class_name(class_info, catch_type)) {
+            ok = fail(&v, "bad catch type");
+        }
+    }
+    uint16_t used;
+    if (ok) {
+        memset(states[0].locals, TYPE_TOP, v.max_locals);
+        ok = expand_types(&v, declared, declared_count, states[0].locals, v.max_locals, &used);
+        states[0].present = true;
+    }
+
+    if (ok) {
+        if (class_info->major_version >= 50) {
+            // Version 50 may fall back to inference when type checking fails
+            ok = verify_by_type_checking(&v, states, current, scratch, declared, declared_count);
+            if (!ok && class_info->major_version == 50) {
+                for (uint32_t i = 1; i < count; i++) {
+                    states[i].present = false;
+                }
+                v.error = NULL;
+                ok = verify_by_inference(&v, states, current);
+            }
+        } else {
+            ok = verify_by_inference(&v, states, current);
+        }
+    }
+
+    if (!ok) {
+        fprintf(stderr, "VerifyError: %s.%s%s at offset %u: %s\n",
+                class_info->name, method->name, method->descriptor,
+                v.error_offset, v.error ? v.error : "verification failed");
+    }
+
+    free(states);
+    free(memory);
+    free(declared);
+    free(v.index_of);
+    free(v.successors);
+    return ok ? 0 : -1;
+}
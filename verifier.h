@@ -0,0 +1,10 @@
+// verifier.h - Load-time bytecode verifier
+#ifndef VERIFIER_H
+#define VERIFIER_H
+
+#include "jvm.h"
+
+// Public API functions
+int verify_method(const ClassInfo* class_info, const MethodInfo* method);
+
+#endif // VERIFIER_H